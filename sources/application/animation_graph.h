@@ -10,6 +10,12 @@ enum class AnimationState
   Movement
 };
 
+enum class TransitionMode
+{
+  CrossFade,      // from, edge and to controllers are sampled and blended
+  Inertialization // only the target is sampled, the pose offset decays over transitionDuration
+};
+
 struct AnimationGraphNode;
 
 struct AnimationGraphEdge
@@ -19,7 +25,7 @@ struct AnimationGraphEdge
   std::shared_ptr<IAnimationController> animation;
   float transitionDuration = 0;
   float transitionProgress = 0;
-
+  TransitionMode transitionMode = TransitionMode::CrossFade;
 };
 
 struct AnimationGraphNode
@@ -48,6 +54,10 @@ struct AnimationGraph final : IAnimationController
   AnimationGraphEdge *currentEdge = nullptr;
 
   AnimationState goalState = AnimationState::Idle;
+  // duration of the inertialized transition started by the last set_state, 0 if there is none
+  float pendingInertialization = 0;
+  TransitionMode transitionMode = TransitionMode::CrossFade; // of all edges, set_transition_mode
+
 
   void set_state(AnimationState state)
   {
@@ -60,14 +70,43 @@ struct AnimationGraph final : IAnimationController
       {
         if (edge.to->state == state)
         {
-          currentEdge = &edge;
-          currentEdge->transitionProgress = 0;
+          if (edge.transitionMode == TransitionMode::Inertialization)
+          {
+            currentNode = edge.to;
+            currentEdge = nullptr;
+            pendingInertialization = edge.transitionDuration;
+          }
+          else
+          {
+            currentEdge = &edge;
+            currentEdge->transitionProgress = 0;
+          }
           break;
         }
       }
     }
   }
 
+  // returns true once after an inertialized transition started
+  bool consume_inertialization(float &transition_duration)
+  {
+    if (pendingInertialization <= 0)
+      return false;
+    transition_duration = pendingInertialization;
+    pendingInertialization = 0;
+    return true;
+  }
+
+  TransitionMode get_transition_mode() const { return transitionMode; }
+
+  void set_transition_mode(TransitionMode mode)
+  {
+    transitionMode = mode;
+    for (AnimationGraphNode &node : nodes)
+      for (AnimationGraphEdge &edge : node.edges)
+        edge.transitionMode = mode;
+  }
+
   float duration() const override
   {
     // if (currentEdge)
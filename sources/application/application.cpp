@@ -1,12 +1,18 @@
 
 #include "scene.h"
+#include "engine/replay.h"
+#include "engine/profiler.h"
 
 void application_init(Scene &scene);
 void application_update(Scene &scene);
-void application_render(Scene &scene);
-void application_imgui_render(Scene &scene);
+uint64_t pose_checksum(const Scene &scene);
+void application_render(const Scene &scene, const FrameSnapshot &snapshot);
+void application_imgui_render(Scene &scene, const SceneUiState &state);
 
 static std::unique_ptr<Scene> scene;
+static FrameSnapshot serialSnapshot;
+static const FrameSnapshot *renderSnapshot = nullptr;
+static uint64_t frameInputTime = 0;
 
 // entry points for engine/main.cpp
 void game_init()
@@ -17,17 +23,64 @@ void game_init()
 
 void game_update()
 {
+  frameInputTime = engine::get_profiler_time_ns();
+  // recording and replay compare poses frame by frame, so ticks have to run on the main thread
+  const bool replay = engine::get_replay_mode() != engine::ReplayMode::None;
+  const FrameMode frameMode = replay ? FrameMode::Serial : scene->frameMode;
+  if (frameMode != FrameMode::Pipelined)
+    scene->framePipeline.flush();
+  if (frameMode == FrameMode::SimulationThread)
+    scene->simulationThread.start(*scene);
+  else
+    scene->simulationThread.stop();
+
+  if (frameMode == FrameMode::Pipelined)
+  {
+    // touches only the camera, the scene belongs to the update jobs, which also dispatch PostPhysics events
+    application_update(*scene);
+    renderSnapshot = &scene->framePipeline.begin_frame(*scene, engine::get_delta_time());
+    return;
+  }
+  renderSnapshot = nullptr;
+
+  std::unique_lock lock(scene->simulationMutex);
+  // ui edits of the last pipelined frame
+  scene->framePipeline.apply_commands(*scene);
   application_update(*scene);
+  if (frameMode == FrameMode::Serial)
+  {
+    const mat4 projectionView = scene->userCamera.projection * inverse(scene->userCamera.transform);
+    advance_simulation(*scene, engine::get_delta_time(), projectionView);
+    engine::replay_checksum(pose_checksum(*scene));
+  }
+  // physics runs inside simulation ticks, its events are delivered here on the main thread
+  engine::dispatch_events(engine::EventPhase::PostPhysics);
 }
 
 void game_render()
 {
-  application_render(*scene);
+  if (!renderSnapshot)
+  {
+    interpolate_poses(*scene);
+    build_frame_snapshot(*scene, scene->userCamera.transform, scene->userCamera.projection, frameInputTime, serialSnapshot);
+    renderSnapshot = &serialSnapshot;
+  }
+  engine::profile_counter("input latency ms", (engine::get_profiler_time_ns() - renderSnapshot->inputTime) * 1e-6f);
+  application_render(*scene, *renderSnapshot);
 }
 
 void game_imgui_render()
 {
-  application_imgui_render(*scene);
+  // the ui reads the state captured by the update of the rendered frame and posts its edits
+  if (scene->framePipeline.is_active())
+  {
+    application_imgui_render(*scene, renderSnapshot->ui);
+    return;
+  }
+  static SceneUiState uiState;
+  std::unique_lock lock(scene->simulationMutex);
+  capture_ui_state(*scene, uiState);
+  application_imgui_render(*scene, uiState);
 }
 
 void game_terminate()
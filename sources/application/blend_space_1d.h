@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include "engine/3dmath.h"
 #include "engine/import/model.h"
 #include "animation_controller.h"
@@ -25,27 +26,27 @@ struct BlendSpace1D final : IAnimationController
   {
     if (animations.empty())
       return;
-    weights.assign(animations.size(), 0.f);
+    std::fill(weights.begin(), weights.end(), 0.f);
 
-    if (parameter < animations[0].parameter)
+    // animations are sorted by parameter
+    auto next = std::upper_bound(animations.begin(), animations.end(), parameter,
+      [](float p, const AnimationNode1D &node) { return p < node.parameter; });
+    if (next == animations.begin())
     {
       weights[0] = 1.f;
       return;
     }
-    for (size_t i = 0; i < animations.size() - 1; i++)
+    if (next == animations.end())
     {
-      const AnimationNode1D &curNode = animations[i];
-      const AnimationNode1D &nextNode = animations[i + 1];
-      if (curNode.parameter <= parameter && parameter <= nextNode.parameter)
-      {
-        float t = (parameter - curNode.parameter) / (nextNode.parameter - curNode.parameter);
-        weights[i] = 1.f - t;
-        weights[i + 1] = t;
-        break;
-      }
-    }
-    if (parameter > animations.back().parameter)
       weights.back() = 1.f;
+      return;
+    }
+    size_t i = next - animations.begin() - 1;
+    const AnimationNode1D &curNode = animations[i];
+    const AnimationNode1D &nextNode = animations[i + 1];
+    float t = (parameter - curNode.parameter) / (nextNode.parameter - curNode.parameter);
+    weights[i] = 1.f - t;
+    weights[i + 1] = t;
   }
 
   float duration() const override
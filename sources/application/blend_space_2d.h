@@ -0,0 +1,322 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <glm/gtx/norm.hpp>
+#include "engine/3dmath.h"
+#include "engine/import/model.h"
+#include "animation_controller.h"
+
+
+struct AnimationNode2D
+{
+  const ozz::animation::Animation *animation = nullptr;
+  vec2 parameter = vec2(0.f);
+};
+
+// Samples are triangulated once (Delaunay) in the constructor and a uniform grid is laid
+// over their bounding box. Every cell keeps the few triangles that overlap it, so
+// set_parameter is a constant time lookup that produces at most three non zero weights.
+struct BlendSpace2D final : IAnimationController
+{
+  static constexpr int MAX_ACTIVE = 3;
+
+  std::vector<AnimationNode2D> animations;
+  std::vector<uvec3> triangles;
+
+  vec2 gridMin = vec2(0.f);
+  vec2 gridCellSize = vec2(1.f);
+  int gridWidth = 0;
+  int gridHeight = 0;
+  std::vector<uint32_t> cellOffsets;   // gridWidth * gridHeight + 1 offsets into cellTriangles
+  std::vector<uint32_t> cellTriangles; // triangles overlapping a cell, or the closest one for cells outside the hull
+
+  int activeIndices[MAX_ACTIVE] = {0, 0, 0};
+  float activeWeights[MAX_ACTIVE] = {1.f, 0.f, 0.f};
+  int activeCount = 0;
+  float progress = 0; // in [0, 1]
+
+  BlendSpace2D(std::vector<AnimationNode2D> &&_animations) : animations(std::move(_animations))
+  {
+    triangulate();
+    build_grid();
+    set_parameter(vec2(0.f));
+  }
+
+  void set_parameter(vec2 parameter)
+  {
+    activeCount = 0;
+    if (animations.empty())
+      return;
+    if (triangles.empty())
+    {
+      // less than 3 samples or all of them are collinear, fallback to the nearest sample
+      int nearest = 0;
+      for (int i = 1; i < (int)animations.size(); i++)
+        if (distance2(animations[i].parameter, parameter) < distance2(animations[nearest].parameter, parameter))
+          nearest = i;
+      activeIndices[0] = nearest;
+      activeWeights[0] = 1.f;
+      activeCount = 1;
+      return;
+    }
+
+    ivec2 cell = clamp(ivec2(floor((parameter - gridMin) / gridCellSize)), ivec2(0), ivec2(gridWidth - 1, gridHeight - 1));
+    int cellIdx = cell.y * gridWidth + cell.x;
+
+    vec3 bestBarycentric = vec3(1.f, 0.f, 0.f);
+    uint32_t bestTriangle = cellTriangles[cellOffsets[cellIdx]];
+    float bestDistance = FLT_MAX;
+    for (uint32_t i = cellOffsets[cellIdx]; i < cellOffsets[cellIdx + 1]; i++)
+    {
+      const uvec3 &t = triangles[cellTriangles[i]];
+      vec3 barycentric = closest_point_barycentric(parameter, animations[t.x].parameter, animations[t.y].parameter, animations[t.z].parameter);
+      vec2 closest = barycentric.x * animations[t.x].parameter + barycentric.y * animations[t.y].parameter + barycentric.z * animations[t.z].parameter;
+      float dist = distance2(closest, parameter);
+      if (dist < bestDistance)
+      {
+        bestDistance = dist;
+        bestBarycentric = barycentric;
+        bestTriangle = cellTriangles[i];
+        if (dist == 0.f)
+          break;
+      }
+    }
+
+    const uvec3 &t = triangles[bestTriangle];
+    for (int k = 0; k < 3; k++)
+    {
+      if (bestBarycentric[k] <= 0.f)
+        continue;
+      activeIndices[activeCount] = t[k];
+      activeWeights[activeCount] = bestBarycentric[k];
+      activeCount++;
+    }
+  }
+
+  float duration() const override
+  {
+    float weightedDuration = 0.f;
+    for (int i = 0; i < activeCount; i++)
+      weightedDuration += animations[activeIndices[i]].animation->duration() * activeWeights[i];
+    return weightedDuration;
+  }
+
+  void update(float dt) override
+  {
+    float weightedDuration = duration();
+    assert(weightedDuration > 0);
+    progress += dt / weightedDuration;
+    if (progress > 1.f || progress < 0.f)
+      progress -= floorf(progress);
+  }
+
+  void collect_animations(std::vector<WeightedAnimation> &out, float weight) override
+  {
+    for (int i = 0; i < activeCount; i++)
+    {
+      if (activeWeights[i] * weight < 0.001f)
+        continue;
+      out.push_back({animations[activeIndices[i]].animation, activeWeights[i] * weight, progress});
+    }
+  }
+
+private:
+  static float cross2(vec2 a, vec2 b)
+  {
+    return a.x * b.y - a.y * b.x;
+  }
+
+  // barycentric coordinates of the point of triangle abc closest to p (Ericson, Real-Time Collision Detection 5.1.5)
+  static vec3 closest_point_barycentric(vec2 p, vec2 a, vec2 b, vec2 c)
+  {
+    vec2 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if (d1 <= 0.f && d2 <= 0.f)
+      return vec3(1.f, 0.f, 0.f);
+    vec2 bp = p - b;
+    float d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if (d3 >= 0.f && d4 <= d3)
+      return vec3(0.f, 1.f, 0.f);
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+    {
+      float v = d1 / (d1 - d3);
+      return vec3(1.f - v, v, 0.f);
+    }
+    vec2 cp = p - c;
+    float d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if (d6 >= 0.f && d5 <= d6)
+      return vec3(0.f, 0.f, 1.f);
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+    {
+      float w = d2 / (d2 - d6);
+      return vec3(1.f - w, 0.f, w);
+    }
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f)
+    {
+      float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+      return vec3(0.f, 1.f - w, w);
+    }
+    float denom = 1.f / (va + vb + vc);
+    float v = vb * denom, w = vc * denom;
+    return vec3(1.f - v - w, v, w);
+  }
+
+  // Bowyer-Watson, blend spaces have a handful of samples so O(n^2) is fine
+  void triangulate()
+  {
+    triangles.clear();
+    const int n = animations.size();
+    if (n < 3)
+      return;
+
+    std::vector<vec2> points(n);
+    vec2 minP(FLT_MAX), maxP(-FLT_MAX);
+    for (int i = 0; i < n; i++)
+    {
+      points[i] = animations[i].parameter;
+      minP = min(minP, points[i]);
+      maxP = max(maxP, points[i]);
+    }
+    const float size = std::max(std::max(maxP.x - minP.x, maxP.y - minP.y), 1e-3f);
+    const vec2 center = (minP + maxP) * 0.5f;
+    points.push_back(center + vec2(-20.f, -10.f) * size);
+    points.push_back(center + vec2(20.f, -10.f) * size);
+    points.push_back(center + vec2(0.f, 20.f) * size);
+
+    struct Triangle
+    {
+      uvec3 v;
+      vec2 circumcenter;
+      float radius2;
+    };
+    auto make_triangle = [&](uint32_t a, uint32_t b, uint32_t c) -> Triangle
+    {
+      // keep counter-clockwise winding
+      if (cross2(points[b] - points[a], points[c] - points[a]) < 0.f)
+        std::swap(b, c);
+      vec2 pa = points[a], pb = points[b] - pa, pc = points[c] - pa;
+      float d = 2.f * cross2(pb, pc);
+      vec2 center = pa + vec2(pc.y * dot(pb, pb) - pb.y * dot(pc, pc), pb.x * dot(pc, pc) - pc.x * dot(pb, pb)) / d;
+      return {uvec3(a, b, c), center, distance2(center, pa)};
+    };
+
+    std::vector<Triangle> current = {make_triangle(n, n + 1, n + 2)};
+    std::vector<uvec2> polygon;
+    for (int i = 0; i < n; i++)
+    {
+      polygon.clear();
+      for (size_t j = 0; j < current.size();)
+      {
+        if (distance2(points[i], current[j].circumcenter) < current[j].radius2)
+        {
+          const uvec3 &v = current[j].v;
+          for (uvec2 edge : {uvec2(v.x, v.y), uvec2(v.y, v.z), uvec2(v.z, v.x)})
+          {
+            // edges shared by two removed triangles are not on the polygon boundary
+            auto it = std::find(polygon.begin(), polygon.end(), uvec2(edge.y, edge.x));
+            if (it != polygon.end())
+              polygon.erase(it);
+            else
+              polygon.push_back(edge);
+          }
+          current[j] = current.back();
+          current.pop_back();
+        }
+        else
+          j++;
+      }
+      for (uvec2 edge : polygon)
+        if (fabsf(cross2(points[edge.y] - points[edge.x], points[i] - points[edge.x])) > 1e-6f * size * size)
+          current.push_back(make_triangle(edge.x, edge.y, i));
+    }
+
+    for (const Triangle &t : current)
+      if (t.v.x < (uint32_t)n && t.v.y < (uint32_t)n && t.v.z < (uint32_t)n)
+        triangles.push_back(t.v);
+  }
+
+  void build_grid()
+  {
+    cellOffsets.clear();
+    cellTriangles.clear();
+    if (triangles.empty())
+      return;
+
+    vec2 minP(FLT_MAX), maxP(-FLT_MAX);
+    for (const AnimationNode2D &node : animations)
+    {
+      minP = min(minP, node.parameter);
+      maxP = max(maxP, node.parameter);
+    }
+    // ~4 cells per triangle keeps the candidate lists short
+    const int resolution = glm::clamp((int)ceilf(sqrtf(triangles.size() * 4.f)), 2, 64);
+    gridWidth = gridHeight = resolution;
+    gridMin = minP;
+    gridCellSize = max((maxP - minP) / float(resolution), vec2(1e-4f));
+
+    cellOffsets.resize(gridWidth * gridHeight + 1);
+    for (int y = 0; y < gridHeight; y++)
+      for (int x = 0; x < gridWidth; x++)
+      {
+        const int cellIdx = y * gridWidth + x;
+        cellOffsets[cellIdx] = cellTriangles.size();
+        const vec2 cellMin = gridMin + vec2(x, y) * gridCellSize;
+        const vec2 cellMax = cellMin + gridCellSize;
+        for (uint32_t t = 0; t < triangles.size(); t++)
+          if (triangle_overlaps_box(triangles[t], cellMin, cellMax))
+            cellTriangles.push_back(t);
+
+        if (cellOffsets[cellIdx] == cellTriangles.size())
+        {
+          // cell is outside the hull, parameters there are projected onto the closest triangle
+          const vec2 cellCenter = (cellMin + cellMax) * 0.5f;
+          uint32_t closest = 0;
+          float closestDistance = FLT_MAX;
+          for (uint32_t t = 0; t < triangles.size(); t++)
+          {
+            const uvec3 &v = triangles[t];
+            vec2 a = animations[v.x].parameter, b = animations[v.y].parameter, c = animations[v.z].parameter;
+            vec3 bc = closest_point_barycentric(cellCenter, a, b, c);
+            float dist = distance2(bc.x * a + bc.y * b + bc.z * c, cellCenter);
+            if (dist < closestDistance)
+            {
+              closestDistance = dist;
+              closest = t;
+            }
+          }
+          cellTriangles.push_back(closest);
+        }
+      }
+    cellOffsets.back() = cellTriangles.size();
+  }
+
+  // separating axis test of a triangle against an axis aligned box
+  bool triangle_overlaps_box(const uvec3 &t, vec2 boxMin, vec2 boxMax) const
+  {
+    const vec2 p[3] = {animations[t.x].parameter, animations[t.y].parameter, animations[t.z].parameter};
+    vec2 triMin = min(min(p[0], p[1]), p[2]);
+    vec2 triMax = max(max(p[0], p[1]), p[2]);
+    if (triMax.x < boxMin.x || triMin.x > boxMax.x || triMax.y < boxMin.y || triMin.y > boxMax.y)
+      return false;
+    const vec2 corners[4] = {boxMin, vec2(boxMax.x, boxMin.y), boxMax, vec2(boxMin.x, boxMax.y)};
+    for (int e = 0; e < 3; e++)
+    {
+      vec2 a = p[e], b = p[(e + 1) % 3], c = p[(e + 2) % 3];
+      float side = cross2(b - a, c - a);
+      bool allOutside = true;
+      for (const vec2 &corner : corners)
+        if (cross2(b - a, corner - a) * side >= 0.f)
+        {
+          allOutside = false;
+          break;
+        }
+      if (allOutside)
+        return false;
+    }
+    return true;
+  }
+};
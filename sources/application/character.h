@@ -5,12 +5,19 @@
 #include <ozz/animation/runtime/sampling_job.h>
 #include <ozz/base/maths/soa_transform.h>
 #include <ozz/animation/runtime/local_to_model_job.h>
+#include <ozz/base/containers/vector.h>
 #include <Jolt/Jolt.h>
 #include <Jolt/Physics/Ragdoll/Ragdoll.h>
 #include "animation_controller.h"
 #include "single_animation.h"
 #include "blend_space_1d.h"
+#include "blend_space_2d.h"
 #include "animation_graph.h"
+#include "inertialization.h"
+#include "engine/memory.h"
+#include "ragdoll_manager.h"
+#include "ground_queries.h"
+#include "culling.h"
 struct SkeletonInfo
 {
   std::vector<std::string> names;
@@ -29,7 +36,7 @@ struct SkeletonInfo
 
 struct AnimationLayer
 {
-  std::vector<ozz::math::SoaTransform> localLayerTransforms;
+  ozz::vector<ozz::math::SoaTransform> localLayerTransforms;
   const ozz::animation::Animation *currentAnimation = nullptr;
   std::unique_ptr<ozz::animation::SamplingJob::Context> samplingCache;
   float currentProgress = 0;
@@ -40,16 +47,20 @@ struct AnimationLayer
 
 struct AnimationContext
 {
-  std::vector<ozz::math::SoaTransform> localTransforms;
-  std::vector<ozz::math::Float4x4> worldTransforms;
+  // pose buffers go through ozz::memory, so they are accounted as SamplingContexts
+  ozz::vector<ozz::math::SoaTransform> localTransforms;
+  ozz::vector<ozz::math::Float4x4> worldTransforms;
   const ozz::animation::Skeleton *skeleton = nullptr;
-  std::vector<AnimationLayer> layers;
+  ozz::vector<AnimationLayer> layers;
+  PoseInertializer inertializer;
 
   void setup(const ozz::animation::Skeleton *_skeleton)
   {
+    engine::MemoryTagScope memoryTag(engine::MemoryTag::SamplingContexts);
     skeleton = _skeleton;
     worldTransforms.resize(skeleton->num_joints());
     localTransforms.resize(skeleton->num_soa_joints());
+    inertializer.setup(skeleton->num_joints());
 
 
     ozz::animation::LocalToModelJob localToModelJob;
@@ -60,6 +71,7 @@ struct AnimationContext
 
   void add_animation(const ozz::animation::Animation *animation, float progress, float weight = 1.f )
   {
+    engine::MemoryTagScope memoryTag(engine::MemoryTag::SamplingContexts);
     AnimationLayer &layer = layers.emplace_back();
     layer.localLayerTransforms.resize(skeleton->num_soa_joints());
     layer.currentAnimation = animation;
@@ -90,9 +102,33 @@ struct Character
   JPH::Ref<JPH::RagdollSettings> ragdollSettings;
   JPH::Ref<JPH::Ragdoll> ragdoll;
   float ragdollToAnimationDeltaTime = 1.f / 60.f;
+  // ragdoll is attached by RagdollManager only while the character interacts with physics
+  RagdollState ragdollState = RagdollState::Animated;
+  float ragdollTimer = 0.f; // seconds since the last interaction or since the hit
+  bool ragdollHit = false;  // request to fall, consumed by the next tick
+  bool ragdollKept = false; // always driven, for debugging
+  bool ragdollDragged = false; // head follows ragdollTargetTransform
+  std::vector<int> ragdollNodes;     // skeleton node of every ragdoll joint, -1 if missing
+  JPH::Array<JPH::Mat44> ragdollPose; // scratch for ragdoll sync
+  std::vector<int> groundProbeNodes; // skeleton node of every GroundProbe, -1 if missing
+  GroundHit groundHits[int(GroundProbe::Count)]; // after the physics step, see query_ground
+
+  // world transforms of the two last simulation ticks, [1] is the newest, see publish_poses
+  std::vector<mat4> publishedPoses[2];
+  // interpolated between published poses on the main thread, used by render
+  std::vector<mat4> renderPose;
+
+  std::vector<NodeBounds> nodeBounds; // built from the mesh bone bounds on the first update_world_bounds
+  BoundingBox worldBounds;            // around worldTransforms of the last tick
+  BoundingBox publishedBounds[2];     // next to publishedPoses
+  BoundingBox renderBounds;           // covers both published poses, so any interpolated pose is inside
+  bool visible = true;                // seen by the user camera on the last tick
+  int culledTicks = 0;                // ticks without animation update while out of view
+  float animationDeltaTime = 0.f;     // accumulated over the skipped ticks
 
   std::vector<std::shared_ptr<IAnimationController>> controllers;
   float linearVelocity = 0.f;
+  float movementDirection = 0.f; // in degrees, 0 - forward, 90 - right
   int selectedAnimation = -1;
   AnimationState state = AnimationState::Idle;
 
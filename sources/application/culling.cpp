@@ -0,0 +1,118 @@
+#include "culling.h"
+#include "scene.h"
+#include "engine/profiler.h"
+#include <ozz/base/maths/simd_math.h>
+#include <algorithm>
+#include <cassert>
+
+Frustum make_frustum(const mat4 &projection_view)
+{
+  // rows of the matrix, clip space is -w <= x, y, z <= w
+  const mat4 m = transpose(projection_view);
+  Frustum frustum;
+  frustum.planes[0] = m[3] + m[0];
+  frustum.planes[1] = m[3] - m[0];
+  frustum.planes[2] = m[3] + m[1];
+  frustum.planes[3] = m[3] - m[1];
+  frustum.planes[4] = m[3] + m[2];
+  frustum.planes[5] = m[3] - m[2];
+  return frustum;
+}
+
+void frustum_cull(const Frustum &frustum, std::span<const BoundingBox> boxes, std::span<uint8_t> visible)
+{
+  using namespace ozz::math;
+  assert(visible.size() >= boxes.size());
+  const int count = boxes.size();
+  for (int i = 0; i < count; i += 4)
+  {
+    // four boxes transposed to SoA, the tail repeats the last box
+    const BoundingBox *b[4];
+    for (int k = 0; k < 4; k++)
+      b[k] = &boxes[std::min(i + k, count - 1)];
+    const SimdFloat4 minX = simd_float4::Load(b[0]->min.x, b[1]->min.x, b[2]->min.x, b[3]->min.x);
+    const SimdFloat4 minY = simd_float4::Load(b[0]->min.y, b[1]->min.y, b[2]->min.y, b[3]->min.y);
+    const SimdFloat4 minZ = simd_float4::Load(b[0]->min.z, b[1]->min.z, b[2]->min.z, b[3]->min.z);
+    const SimdFloat4 maxX = simd_float4::Load(b[0]->max.x, b[1]->max.x, b[2]->max.x, b[3]->max.x);
+    const SimdFloat4 maxY = simd_float4::Load(b[0]->max.y, b[1]->max.y, b[2]->max.y, b[3]->max.y);
+    const SimdFloat4 maxZ = simd_float4::Load(b[0]->max.z, b[1]->max.z, b[2]->max.z, b[3]->max.z);
+    const SimdFloat4 half = simd_float4::Load1(0.5f);
+    const SimdFloat4 centerX = (minX + maxX) * half, centerY = (minY + maxY) * half, centerZ = (minZ + maxZ) * half;
+    const SimdFloat4 extentX = (maxX - minX) * half, extentY = (maxY - minY) * half, extentZ = (maxZ - minZ) * half;
+
+    // empty boxes have a negative extent
+    SimdInt4 outside = CmpLt(extentX, simd_float4::zero());
+    for (const vec4 &plane : frustum.planes)
+    {
+      const SimdFloat4 nx = simd_float4::Load1(plane.x), ny = simd_float4::Load1(plane.y), nz = simd_float4::Load1(plane.z);
+      const SimdFloat4 distance = MAdd(centerX, nx, MAdd(centerY, ny, MAdd(centerZ, nz, simd_float4::Load1(plane.w))));
+      const SimdFloat4 radius = MAdd(extentX, Abs(nx), MAdd(extentY, Abs(ny), extentZ * Abs(nz)));
+      outside = Or(outside, CmpLt(distance + radius, simd_float4::zero()));
+    }
+    const int outsideMask = MoveMask(outside);
+    for (int k = 0; k < 4 && i + k < count; k++)
+      visible[i + k] = (outsideMask & (1 << k)) == 0;
+  }
+}
+
+static void build_node_bounds(Character &character)
+{
+  std::vector<BoundingBox> boxes(character.animationContext.worldTransforms.size());
+  for (const MeshPtr &mesh : character.meshes)
+  {
+    for (size_t bone = 0; bone < mesh->boneBounds.size(); bone++)
+    {
+      auto it = character.skeletonInfo.nodesMap.find(mesh->bonesNames[bone]);
+      if (it != character.skeletonInfo.nodesMap.end() && it->second < int(boxes.size()))
+        boxes[it->second].add(mesh->boneBounds[bone]);
+    }
+  }
+  for (size_t node = 0; node < boxes.size(); node++)
+    if (!boxes[node].empty())
+      character.nodeBounds.push_back({int(node), (boxes[node].min + boxes[node].max) * 0.5f, (boxes[node].max - boxes[node].min) * 0.5f});
+}
+
+void update_world_bounds(Character &character)
+{
+  using namespace ozz::math;
+  if (character.nodeBounds.empty())
+    build_node_bounds(character);
+
+  const auto &worldTransforms = character.animationContext.worldTransforms;
+  SimdFloat4 boundsMin = simd_float4::Load1(FLT_MAX);
+  SimdFloat4 boundsMax = simd_float4::Load1(-FLT_MAX);
+  for (const NodeBounds &bounds : character.nodeBounds)
+  {
+    // center is transformed, extent is projected on the world axes by the absolute rotation-scale
+    const Float4x4 &transform = worldTransforms[bounds.node];
+    const SimdFloat4 center = TransformPoint(transform, simd_float4::Load3PtrU(&bounds.center.x));
+    const SimdFloat4 extent = MAdd(Abs(transform.cols[0]), simd_float4::Load1(bounds.extent.x),
+      MAdd(Abs(transform.cols[1]), simd_float4::Load1(bounds.extent.y), Abs(transform.cols[2]) * simd_float4::Load1(bounds.extent.z)));
+    boundsMin = Min(boundsMin, center - extent);
+    boundsMax = Max(boundsMax, center + extent);
+  }
+  BoundingBox worldBounds;
+  if (!character.nodeBounds.empty())
+  {
+    Store3PtrU(boundsMin, &worldBounds.min.x);
+    Store3PtrU(boundsMax, &worldBounds.max.x);
+  }
+  character.worldBounds = worldBounds;
+}
+
+void update_visibility(Scene &scene, const mat4 &projection_view)
+{
+  PROFILE_ZONE("visibility");
+  std::vector<BoundingBox> boxes(scene.characters.size());
+  std::vector<uint8_t> visible(scene.characters.size(), 1);
+  for (size_t i = 0; i < scene.characters.size(); i++)
+    boxes[i] = scene.characters[i].worldBounds;
+  if (scene.culling.enabled)
+    frustum_cull(make_frustum(projection_view), boxes, visible);
+  for (size_t i = 0; i < scene.characters.size(); i++)
+  {
+    Character &character = scene.characters[i];
+    // bounds appear after the first animated tick, until then the character counts as visible
+    character.visible = visible[i] || character.worldBounds.empty();
+  }
+}
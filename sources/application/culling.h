@@ -0,0 +1,40 @@
+#pragma once
+#include "engine/3dmath.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+struct Scene;
+struct Character;
+
+// six planes, a point p is inside when dot(plane, vec4(p, 1)) >= 0 for all of them
+struct Frustum
+{
+  vec4 planes[6];
+};
+
+// projection_view == camera.projection * inverse(camera.transform)
+Frustum make_frustum(const mat4 &projection_view);
+
+// tests four boxes per SIMD iteration, visible[i] is 0 for boxes completely outside, empty boxes are outside
+void frustum_cull(const Frustum &frustum, std::span<const BoundingBox> boxes, std::span<uint8_t> visible);
+
+// box of a skeleton node in its own space, merged from the bone bounds of all meshes skinned by the node
+struct NodeBounds
+{
+  int node;
+  vec3 center;
+  vec3 extent;
+};
+
+// refits Character::worldBounds around the node boxes placed by the current worldTransforms
+void update_world_bounds(Character &character);
+
+struct CullingSettings
+{
+  bool enabled = true;
+  int culledUpdateInterval = 4; // ticks between animation updates of characters out of view, 1 - every tick
+};
+
+// sets Character::visible from the camera and the bounds of the last tick
+void update_visibility(Scene &scene, const mat4 &projection_view);
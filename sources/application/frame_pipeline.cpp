@@ -0,0 +1,163 @@
+#include "frame_pipeline.h"
+#include "scene.h"
+#include "engine/profiler.h"
+#include "engine/event.h"
+
+void build_frame_snapshot(const Scene &scene, const mat4 &camera_transform, const mat4 &projection, uint64_t input_time,
+  FrameSnapshot &snapshot)
+{
+  PROFILE_ZONE("build snapshot");
+  snapshot.cameraTransform = camera_transform;
+  snapshot.projection = projection;
+  snapshot.inputTime = input_time;
+  snapshot.characters.resize(scene.characters.size());
+
+  std::vector<BoundingBox> bounds(scene.characters.size());
+  std::vector<uint8_t> visible(scene.characters.size(), 1);
+  for (size_t c = 0; c < scene.characters.size(); c++)
+    bounds[c] = scene.characters[c].renderBounds;
+  if (scene.culling.enabled)
+    frustum_cull(make_frustum(projection * inverse(camera_transform)), bounds, visible);
+
+  for (size_t c = 0; c < scene.characters.size(); c++)
+  {
+    const Character &character = scene.characters[c];
+    CharacterSnapshot &characterSnapshot = snapshot.characters[c];
+    characterSnapshot.character = &character;
+    // bounds appear with the first published pose
+    characterSnapshot.visible = visible[c] || character.renderBounds.empty();
+    characterSnapshot.palettes.resize(character.meshes.size());
+    const BoundingBox &box = character.renderBounds;
+    const float radius = box.empty() ? 0.f : length(box.max - box.min) * 0.5f;
+    const float distance = length((box.max + box.min) * 0.5f - vec3(camera_transform[3]));
+    // the camera inside the bounds sees the full detail
+    characterSnapshot.screenSize = distance > radius ? radius * projection[1][1] / distance : FLT_MAX;
+    if (!characterSnapshot.visible)
+    {
+      for (std::vector<mat4> &palette : characterSnapshot.palettes)
+        palette.clear();
+      continue;
+    }
+    const std::vector<mat4> &pose = character.renderPose;
+    for (size_t m = 0; m < character.meshes.size(); m++)
+    {
+      const MeshPtr &mesh = character.meshes[m];
+      std::vector<mat4> &palette = characterSnapshot.palettes[m];
+      palette.resize(pose.empty() ? 0 : mesh->inverseBindPose.size());
+      for (size_t i = 0; i < palette.size(); i++)
+      {
+        auto it = character.skeletonInfo.nodesMap.find(mesh->bonesNames[i]);
+        if (it == character.skeletonInfo.nodesMap.end())
+        {
+          const std::string &name = mesh->bonesNames[i];
+          engine::error("Bone \"%s\" from Mesh \"%s\" not found in skeleton", mesh->name.c_str(), name.c_str());
+          palette[i] = glm::identity<glm::mat4>();
+        }
+        else
+        {
+          int nodeInSkeletonIdx = it->second;
+          palette[i] = pose[nodeInSkeletonIdx] * mesh->inverseBindPose[i];
+        }
+      }
+    }
+  }
+}
+
+const FrameSnapshot &FramePipeline::begin_frame(Scene &scene, float dt)
+{
+  if (depth != activeDepth)
+  {
+    // slots in flight were laid out for the old depth
+    flush();
+    activeDepth = glm::clamp(depth, 1, MAX_PIPELINE_DEPTH);
+    depth = activeDepth;
+  }
+
+  // the camera is updated on the main thread, requests carry it to the update job
+  UpdateRequest request;
+  request.slot = submitted % (MAX_PIPELINE_DEPTH + 1);
+  request.dt = dt;
+  request.cameraTransform = scene.userCamera.transform;
+  request.projection = scene.userCamera.projection;
+  request.inputTime = engine::get_profiler_time_ns();
+  request.commands = std::move(pendingCommands);
+  pendingCommands.clear();
+  active = true;
+  engine::set_event_phase_off_main_thread(engine::EventPhase::PostPhysics, true);
+  slotCounters[request.slot].pending.store(1, std::memory_order_relaxed);
+  submitted++;
+  {
+    std::unique_lock lock(requestsMutex);
+    requests.push_back(std::move(request));
+    if (!draining)
+    {
+      draining = true;
+      engine::get_job_system().submit([this, &scene]() { drain(scene); }, &drainCounter);
+    }
+  }
+
+  const uint64_t target = submitted > firstFresh + activeDepth ? submitted - 1 - activeDepth : firstFresh;
+  const int slot = target % (MAX_PIPELINE_DEPTH + 1);
+  {
+    PROFILE_ZONE("wait update");
+    engine::get_job_system().wait(slotCounters[slot]);
+  }
+  return snapshots[slot];
+}
+
+// a single job runs the requests one by one, frames depend on each other through the simulation
+void FramePipeline::drain(Scene &scene)
+{
+  while (true)
+  {
+    UpdateRequest request;
+    {
+      std::unique_lock lock(requestsMutex);
+      if (requests.empty())
+      {
+        draining = false;
+        return;
+      }
+      request = std::move(requests.front());
+      requests.pop_front();
+    }
+    {
+      PROFILE_ZONE("frame update");
+      std::unique_lock lock(scene.simulationMutex);
+      for (SceneCommand &command : request.commands)
+        command(scene);
+      // the camera of the request, the main thread keeps moving scene.userCamera meanwhile
+      advance_simulation(scene, request.dt, request.projection * inverse(request.cameraTransform));
+      // the main thread is rendering, so events of the ticks are delivered here
+      engine::dispatch_events(engine::EventPhase::PostPhysics);
+      interpolate_poses(scene);
+      FrameSnapshot &snapshot = snapshots[request.slot];
+      build_frame_snapshot(scene, request.cameraTransform, request.projection, request.inputTime, snapshot);
+      capture_ui_state(scene, snapshot.ui);
+    }
+    slotCounters[request.slot].pending.store(0, std::memory_order_release);
+  }
+}
+
+void FramePipeline::flush()
+{
+  engine::get_job_system().wait(drainCounter);
+  firstFresh = submitted;
+  active = false;
+  engine::set_event_phase_off_main_thread(engine::EventPhase::PostPhysics, false);
+}
+
+void FramePipeline::apply_commands(Scene &scene)
+{
+  for (SceneCommand &command : pendingCommands)
+    command(scene);
+  pendingCommands.clear();
+}
+
+void edit_scene(Scene &scene, SceneCommand &&command)
+{
+  if (scene.framePipeline.is_active())
+    scene.framePipeline.post_command(std::move(command));
+  else
+    command(scene);
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "engine/3dmath.h"
+#include "engine/job_system.h"
+#include "ui_state.h"
+#include <deque>
+#include <mutex>
+#include <vector>
+
+struct Scene;
+struct Character;
+
+// everything render needs from one updated frame, render doesn't touch simulated state
+struct CharacterSnapshot
+{
+  const Character *character = nullptr;
+  std::vector<std::vector<mat4>> palettes; // skinning matrices per mesh, empty for culled characters
+  bool visible = true;
+  float screenSize = 0.f; // projected bounds radius over the half of the screen height
+};
+
+struct FrameSnapshot
+{
+  mat4 cameraTransform;
+  mat4 projection;
+  std::vector<CharacterSnapshot> characters;
+  uint64_t inputTime = 0; // profiler time when the frame input was polled
+  SceneUiState ui;        // filled by pipelined updates only
+};
+
+// coarser LODs are drawn while their error stays below pixelError on screen
+struct LodSettings
+{
+  float pixelError = 1.f;
+  int forcedLod = -1; // -1 - select by screen size
+};
+
+// reads Character::renderPose and renderBounds, characters outside of the camera frustum get no palettes
+void build_frame_snapshot(const Scene &scene, const mat4 &camera_transform, const mat4 &projection, uint64_t input_time,
+  FrameSnapshot &snapshot);
+
+constexpr int MAX_PIPELINE_DEPTH = 3;
+
+// Updates run on the job system in submission order while the main thread renders
+// the snapshot of a frame submitted depth frames earlier. The main thread doesn't touch the scene
+// while updates are in flight, its edits are scene commands applied by the next update.
+class FramePipeline
+{
+  struct UpdateRequest
+  {
+    int slot;
+    float dt;
+    mat4 cameraTransform;
+    mat4 projection;
+    uint64_t inputTime;
+    std::vector<SceneCommand> commands; // run before the update
+  };
+
+  FrameSnapshot snapshots[MAX_PIPELINE_DEPTH + 1];
+  engine::JobCounter slotCounters[MAX_PIPELINE_DEPTH + 1];
+  std::mutex requestsMutex;
+  std::deque<UpdateRequest> requests;
+  bool draining = false;
+  engine::JobCounter drainCounter;
+  uint64_t submitted = 0;
+  uint64_t firstFresh = 0; // snapshots before it are left from before the last flush
+  int activeDepth = 1;
+  bool active = false; // frames were submitted since the last flush
+  std::vector<SceneCommand> pendingCommands;
+
+  void drain(Scene &scene);
+
+public:
+  // frames of update in flight while a frame is rendered, applied on the next begin_frame
+  int depth = 1;
+
+  // submits the update of a new frame and returns the snapshot to render this frame
+  const FrameSnapshot &begin_frame(Scene &scene, float dt);
+
+  // waits for all submitted updates
+  void flush();
+
+  // true between begin_frame and the next flush, the scene belongs to the update job
+  bool is_active() const { return active; }
+
+  // the command goes with the next submitted frame
+  void post_command(SceneCommand &&command) { pendingCommands.push_back(std::move(command)); }
+
+  // runs commands posted after the last submitted frame, when the pipeline is left, call after flush
+  void apply_commands(Scene &scene);
+
+  ~FramePipeline() { flush(); }
+};
@@ -0,0 +1,104 @@
+#include "ground_queries.h"
+#include "character.h"
+#include "physics_world.h"
+#include "engine/job_system.h"
+#include "engine/profiler.h"
+#include "import/timer.h"
+#include <Jolt/Physics/Body/BodyLock.h>
+#include <Jolt/Physics/Collision/CastResult.h>
+#include <Jolt/Physics/Collision/RayCast.h>
+#include <Jolt/Physics/Collision/NarrowPhaseQuery.h>
+
+// feet stand on static geometry and on dynamic props, never on ragdolls or debris
+class GroundBroadPhaseFilter final : public JPH::BroadPhaseLayerFilter
+{
+public:
+  bool ShouldCollide(JPH::BroadPhaseLayer inLayer) const override
+  {
+    return inLayer == BroadPhaseLayers::Static || inLayer == BroadPhaseLayers::Moving;
+  }
+};
+
+class GroundObjectFilter final : public JPH::ObjectLayerFilter
+{
+public:
+  bool ShouldCollide(JPH::ObjectLayer inLayer) const override
+  {
+    return inLayer == ObjectLayers::Static || inLayer == ObjectLayers::Moving;
+  }
+};
+
+static const char *groundProbeNames[] = {"LeftFoot", "RightFoot", "Hips"};
+static_assert(sizeof(groundProbeNames) / sizeof(groundProbeNames[0]) == size_t(GroundProbe::Count));
+
+static void cast_ground_rays(const GroundQueries &queries, const JPH::PhysicsSystem &physicsSystem, int begin, int end)
+{
+  const JPH::NarrowPhaseQuery &narrowPhase = physicsSystem.GetNarrowPhaseQueryNoLock();
+  const JPH::BodyLockInterfaceNoLock &bodyLocks = physicsSystem.GetBodyLockInterfaceNoLock();
+  const GroundBroadPhaseFilter broadPhaseFilter;
+  const GroundObjectFilter objectFilter;
+  for (int i = begin; i < end; i++)
+  {
+    const vec3 origin = queries.origins[i];
+    const JPH::RRayCast ray(JPH::RVec3(origin.x, origin.y, origin.z), JPH::Vec3(0.f, -queries.lengths[i], 0.f));
+    JPH::RayCastResult result;
+    GroundHit &hit = *queries.results[i];
+    hit = GroundHit();
+    if (!narrowPhase.CastRay(ray, result, broadPhaseFilter, objectFilter))
+      continue;
+    const JPH::RVec3 point = ray.GetPointOnRay(result.mFraction);
+    hit.hit = true;
+    hit.height = float(point.GetY());
+    JPH::BodyLockRead lock(bodyLocks, result.mBodyID);
+    if (lock.Succeeded())
+    {
+      const JPH::Vec3 normal = lock.GetBody().GetWorldSpaceSurfaceNormal(result.mSubShapeID2, point);
+      hit.normal = vec3(normal.GetX(), normal.GetY(), normal.GetZ());
+    }
+  }
+}
+
+void query_ground(GroundQueries &queries, const PhysicsWorld &world, std::vector<Character> &characters)
+{
+  PROFILE_ZONE("ground queries");
+  Timer timer;
+  queries.origins.clear();
+  queries.lengths.clear();
+  queries.results.clear();
+  for (Character &character : characters)
+  {
+    if (character.groundProbeNodes.empty())
+    {
+      for (const char *name : groundProbeNames)
+      {
+        auto it = character.skeletonInfo.nodesMap.find(name);
+        character.groundProbeNodes.push_back(it != character.skeletonInfo.nodesMap.end() ? it->second : -1);
+      }
+    }
+    const auto &worldTransforms = character.animationContext.worldTransforms;
+    for (int probe = 0; probe < int(GroundProbe::Count); probe++)
+    {
+      const int node = character.groundProbeNodes[probe];
+      if (node < 0)
+        continue;
+      vec3 position;
+      ozz::math::Store3PtrU(worldTransforms[node].cols[3], &position.x);
+      const float depth = probe == int(GroundProbe::Hips) ? queries.hipProbeDepth : queries.footProbeDepth;
+      queries.origins.push_back(position + vec3(0.f, queries.probeHeight, 0.f));
+      queries.lengths.push_back(queries.probeHeight + depth);
+      queries.results.push_back(&character.groundHits[probe]);
+    }
+  }
+
+  // a ray is a few microseconds, batches keep the job overhead below the query cost
+  const JPH::PhysicsSystem &physicsSystem = world.mPhysicsSystem;
+  engine::get_job_system().parallel_for(queries.origins.size(), 32, [&](int begin, int end)
+  {
+    cast_ground_rays(queries, physicsSystem, begin, end);
+  });
+
+  queries.lastRayCount = queries.origins.size();
+  queries.lastQueryMs = timer.elapsed_ms();
+  if (queries.lastRayCount > 0)
+    engine::profile_counter("ground rays per ms", queries.lastRayCount / std::max(queries.lastQueryMs, 0.001f));
+}
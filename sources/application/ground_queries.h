@@ -0,0 +1,41 @@
+#pragma once
+#include "engine/3dmath.h"
+#include <vector>
+
+struct Character;
+struct PhysicsWorld;
+
+enum class GroundProbe
+{
+  LeftFoot,
+  RightFoot,
+  Hips,
+  Count
+};
+
+// ground under one probe joint, input of foot IK
+struct GroundHit
+{
+  vec3 normal = vec3(0.f, 1.f, 0.f);
+  float height = 0.f; // world y of the hit point
+  bool hit = false;
+};
+
+// foot and hip probes of all characters, cast as one parallel batch after the physics step
+struct GroundQueries
+{
+  float probeHeight = 0.5f;    // rays start above the joint, so a foot below the ground still finds it
+  float footProbeDepth = 0.5f; // below the joint
+  float hipProbeDepth = 1.5f;
+
+  int lastRayCount = 0;
+  float lastQueryMs = 0.f;
+
+  // scratch, reused between ticks
+  std::vector<vec3> origins;
+  std::vector<float> lengths;
+  std::vector<GroundHit *> results;
+};
+
+// uses the no-lock narrow phase, bodies must not change while it runs
+void query_ground(GroundQueries &queries, const PhysicsWorld &world, std::vector<Character> &characters);
@@ -0,0 +1,180 @@
+#include "inertialization.h"
+#include <algorithm>
+#include <ozz/base/maths/simd_math.h>
+
+void InertializationCurve::init(float _x0, float _v0, float _duration)
+{
+  x0 = _x0;
+  // velocity moving away from the target would overshoot, ignore it
+  v0 = _v0 > 0.f ? 0.f : _v0;
+  t1 = _duration;
+  if (v0 < 0.f)
+    t1 = std::min(t1, -5.f * x0 / v0);
+  if (t1 <= 1e-5f)
+  {
+    a = b = c = d = v0 = x0 = t1 = 0.f;
+    return;
+  }
+  const float t1_2 = t1 * t1, t1_3 = t1_2 * t1, t1_4 = t1_3 * t1, t1_5 = t1_4 * t1;
+  const float a0 = std::max(0.f, (-8.f * v0 * t1 - 20.f * x0) / t1_2);
+  a = -(12.f * x0 + 6.f * v0 * t1 + a0 * t1_2) / (2.f * t1_5);
+  b = (30.f * x0 + 16.f * v0 * t1 + 3.f * a0 * t1_2) / (2.f * t1_4);
+  c = -(20.f * x0 + 12.f * v0 * t1 + 3.f * a0 * t1_2) / (2.f * t1_3);
+  d = a0 * 0.5f;
+}
+
+float InertializationCurve::evaluate(float t) const
+{
+  if (t >= t1)
+    return 0.f;
+  return (((((a * t + b) * t + c) * t + d) * t + v0) * t) + x0;
+}
+
+using JointPose = PoseInertializer::JointPose;
+
+static void load_joint_poses(ozz::span<const ozz::math::SoaTransform> soa, int num_joints, std::vector<JointPose> &out)
+{
+  out.resize(num_joints);
+  alignas(16) float tx[4], ty[4], tz[4], rx[4], ry[4], rz[4], rw[4];
+  for (int i = 0; i < (int)soa.size(); i++)
+  {
+    const ozz::math::SoaTransform &t = soa[i];
+    ozz::math::StorePtr(t.translation.x, tx);
+    ozz::math::StorePtr(t.translation.y, ty);
+    ozz::math::StorePtr(t.translation.z, tz);
+    ozz::math::StorePtr(t.rotation.x, rx);
+    ozz::math::StorePtr(t.rotation.y, ry);
+    ozz::math::StorePtr(t.rotation.z, rz);
+    ozz::math::StorePtr(t.rotation.w, rw);
+    for (int j = 0; j < 4 && i * 4 + j < num_joints; j++)
+    {
+      out[i * 4 + j].translation = vec3(tx[j], ty[j], tz[j]);
+      out[i * 4 + j].rotation = quat(rw[j], rx[j], ry[j], rz[j]);
+    }
+  }
+}
+
+static void store_joint_poses(const std::vector<JointPose> &poses, ozz::span<ozz::math::SoaTransform> soa)
+{
+  alignas(16) float tx[4], ty[4], tz[4], rx[4], ry[4], rz[4], rw[4];
+  for (int i = 0; i < (int)soa.size(); i++)
+  {
+    ozz::math::SoaTransform &t = soa[i];
+    // keep the padding lanes of the last soa element untouched
+    ozz::math::StorePtr(t.translation.x, tx);
+    ozz::math::StorePtr(t.translation.y, ty);
+    ozz::math::StorePtr(t.translation.z, tz);
+    ozz::math::StorePtr(t.rotation.x, rx);
+    ozz::math::StorePtr(t.rotation.y, ry);
+    ozz::math::StorePtr(t.rotation.z, rz);
+    ozz::math::StorePtr(t.rotation.w, rw);
+    for (int j = 0; j < 4 && i * 4 + j < (int)poses.size(); j++)
+    {
+      const JointPose &pose = poses[i * 4 + j];
+      tx[j] = pose.translation.x, ty[j] = pose.translation.y, tz[j] = pose.translation.z;
+      rx[j] = pose.rotation.x, ry[j] = pose.rotation.y, rz[j] = pose.rotation.z, rw[j] = pose.rotation.w;
+    }
+    t.translation.x = ozz::math::simd_float4::LoadPtr(tx);
+    t.translation.y = ozz::math::simd_float4::LoadPtr(ty);
+    t.translation.z = ozz::math::simd_float4::LoadPtr(tz);
+    t.rotation.x = ozz::math::simd_float4::LoadPtr(rx);
+    t.rotation.y = ozz::math::simd_float4::LoadPtr(ry);
+    t.rotation.z = ozz::math::simd_float4::LoadPtr(rz);
+    t.rotation.w = ozz::math::simd_float4::LoadPtr(rw);
+  }
+}
+
+// rotation angle of q around axis, q is expected to be in the same hemisphere as the offset
+static float twist_angle(const quat &q, const vec3 &axis)
+{
+  return 2.f * atan2f(dot(vec3(q.x, q.y, q.z), axis), q.w);
+}
+
+void PoseInertializer::setup(int num_joints)
+{
+  numJoints = num_joints;
+  recordedPoses = 0;
+  active = false;
+  offsets.resize(num_joints);
+  targetJoints.resize(num_joints);
+  sourceJoints.resize(num_joints);
+  previousSourceJoints.resize(num_joints);
+}
+
+void PoseInertializer::start(ozz::span<const ozz::math::SoaTransform> target, float transition_duration)
+{
+  if (recordedPoses == 0 || transition_duration <= 0.f)
+    return;
+
+  load_joint_poses(target, numJoints, targetJoints);
+  load_joint_poses(ozz::make_span(lastPoses[0]), numJoints, sourceJoints);
+  const bool hasVelocity = recordedPoses > 1 && lastDeltaTime > 0.f;
+  if (hasVelocity)
+    load_joint_poses(ozz::make_span(lastPoses[1]), numJoints, previousSourceJoints);
+
+  for (int i = 0; i < numJoints; i++)
+  {
+    JointOffset &offset = offsets[i];
+    const JointPose &to = targetJoints[i];
+    const JointPose &from = sourceJoints[i];
+
+    vec3 translationOffset = from.translation - to.translation;
+    float translationLength = length(translationOffset);
+    offset.translationAxis = translationLength > 1e-6f ? translationOffset / translationLength : vec3(0.f);
+    float translationVelocity = 0.f;
+    if (hasVelocity)
+    {
+      const float previousLength = dot(previousSourceJoints[i].translation - to.translation, offset.translationAxis);
+      translationVelocity = (translationLength - previousLength) / lastDeltaTime;
+    }
+    offset.translation.init(translationLength, translationVelocity, transition_duration);
+
+    quat rotationOffset = from.rotation * inverse(to.rotation);
+    if (rotationOffset.w < 0.f)
+      rotationOffset = -rotationOffset;
+    vec3 rotationAxis = vec3(rotationOffset.x, rotationOffset.y, rotationOffset.z);
+    float sinHalfAngle = length(rotationAxis);
+    offset.rotationAxis = sinHalfAngle > 1e-6f ? rotationAxis / sinHalfAngle : vec3(1.f, 0.f, 0.f);
+    float angle = 2.f * atan2f(sinHalfAngle, rotationOffset.w);
+    float angularVelocity = 0.f;
+    if (hasVelocity)
+    {
+      quat previousOffset = previousSourceJoints[i].rotation * inverse(to.rotation);
+      if (dot(previousOffset, rotationOffset) < 0.f)
+        previousOffset = -previousOffset;
+      angularVelocity = (angle - twist_angle(previousOffset, offset.rotationAxis)) / lastDeltaTime;
+    }
+    offset.rotation.init(angle, angularVelocity, transition_duration);
+  }
+  elapsed = 0.f;
+  duration = transition_duration;
+  active = true;
+}
+
+void PoseInertializer::apply(ozz::span<ozz::math::SoaTransform> pose, float dt)
+{
+  if (!active)
+    return;
+  // the target scratch isn't needed after start
+  std::vector<JointPose> &joints = targetJoints;
+  load_joint_poses(pose, numJoints, joints);
+  for (int i = 0; i < numJoints; i++)
+  {
+    const JointOffset &offset = offsets[i];
+    joints[i].translation += offset.translationAxis * offset.translation.evaluate(elapsed);
+    joints[i].rotation = angleAxis(offset.rotation.evaluate(elapsed), offset.rotationAxis) * joints[i].rotation;
+  }
+  store_joint_poses(joints, pose);
+
+  elapsed += dt;
+  if (elapsed >= duration)
+    active = false;
+}
+
+void PoseInertializer::record(ozz::span<const ozz::math::SoaTransform> pose, float dt)
+{
+  std::swap(lastPoses[0], lastPoses[1]);
+  lastPoses[0].assign(pose.begin(), pose.end());
+  recordedPoses = std::min(recordedPoses + 1, 2);
+  lastDeltaTime = dt;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "engine/3dmath.h"
+#include <vector>
+#include <ozz/base/span.h>
+#include <ozz/base/containers/vector.h>
+#include <ozz/base/maths/soa_transform.h>
+
+// Quintic decay of a scalar offset from x0 with velocity v0 to zero at t1 (D. Bollo, "Inertialization", GDC 2018)
+struct InertializationCurve
+{
+  float a = 0, b = 0, c = 0, d = 0, v0 = 0, x0 = 0, t1 = 0;
+
+  void init(float x0, float v0, float duration);
+  float evaluate(float t) const;
+};
+
+// Replaces a crossfade between two poses: at the transition start the offset between the
+// last displayed pose and the new target pose is stored per joint and decays to zero,
+// so only the target controller has to be sampled during the transition.
+struct PoseInertializer
+{
+  struct JointPose
+  {
+    vec3 translation;
+    quat rotation;
+  };
+
+  struct JointOffset
+  {
+    vec3 translationAxis = vec3(0.f);
+    InertializationCurve translation;
+    vec3 rotationAxis = vec3(0.f);
+    InertializationCurve rotation;
+  };
+
+  int numJoints = 0;
+  // two last output poses, lastPoses[0] is the newest
+  ozz::vector<ozz::math::SoaTransform> lastPoses[2];
+  int recordedPoses = 0;
+  float lastDeltaTime = 0.f;
+
+  std::vector<JointOffset> offsets;
+  // scratch poses of start and apply, sized in setup so the per tick path doesn't allocate
+  std::vector<JointPose> targetJoints, sourceJoints, previousSourceJoints;
+  float elapsed = 0.f;
+  float duration = 0.f;
+  bool active = false;
+
+  void setup(int num_joints);
+
+  // call after the target pose for the first frame of the transition is blended
+  void start(ozz::span<const ozz::math::SoaTransform> target, float transition_duration);
+
+  // adds the decaying offset to the pose, advances transition time by dt
+  void apply(ozz::span<ozz::math::SoaTransform> pose, float dt);
+
+  // remembers the final pose of the frame, it is the source of a future transition
+  void record(ozz::span<const ozz::math::SoaTransform> pose, float dt);
+
+  // forgets recorded poses, while nothing can start a transition recording is skipped
+  void clear_history() { recordedPoses = 0; }
+};
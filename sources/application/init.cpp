@@ -1,7 +1,10 @@
 #include "scene.h"
+#include "static_collision.h"
 #include "motion_matching/feature_data_base.h"
+#include <filesystem>
 
-JPH::Ref<JPH::RagdollSettings> create_ragdoll_settings(const SkeletonPtr &skeleton_src);
+// shared by characters with the same skeleton, cached in a binary file between runs
+JPH::Ref<JPH::RagdollSettings> get_ragdoll_settings(const SkeletonPtr &skeleton, const std::string &cache_path);
 
 static glm::mat4 get_projective_matrix()
 {
@@ -11,6 +14,37 @@ static glm::mat4 get_projective_matrix()
   return glm::perspective(fovY, engine::get_aspect_ratio(), zNear, zFar);
 }
 
+// forward clips on the y axis plus the strafe and backward loops the data base has, parameter is the velocity,
+// without side clips the samples are collinear and the 1D space over speed is kept
+static std::shared_ptr<IAnimationController> make_locomotion_blend_space(const AnimationDataBase &data_base,
+  std::vector<AnimationNode1D> &&forward_animations)
+{
+  std::vector<AnimationNode2D> samples;
+  for (const AnimationNode1D &node : forward_animations)
+    if (node.animation)
+      samples.push_back({node.animation, vec2(0.f, node.parameter)});
+
+  const char *gaits[] = {"Walk", "Jog", "Run"};
+  const std::pair<const char *, vec2> directions[] = {{"L", vec2(-1.f, 0.f)}, {"R", vec2(1.f, 0.f)}, {"B", vec2(0.f, -1.f)}};
+  bool hasSideClips = false;
+  for (int gait = 0; gait < 3; gait++)
+    for (const auto &[suffix, direction] : directions)
+    {
+      const std::string name = std::string("MOB1_") + gaits[gait] + "_" + suffix + "_Loop";
+      if (const ozz::animation::Animation *animation = data_base.find_animation(name))
+      {
+        samples.push_back({animation, direction * float(gait + 1)});
+        hasSideClips |= direction.x != 0.f;
+      }
+    }
+  if (!hasSideClips)
+  {
+    engine::log("No strafe clips for the locomotion blend space, it stays 1D");
+    return std::make_shared<BlendSpace1D>(std::move(forward_animations));
+  }
+  return std::make_shared<BlendSpace2D>(std::move(samples));
+}
+
 void application_init(Scene &scene)
 {
   init_phys_globals();
@@ -63,29 +97,29 @@ void application_init(Scene &scene)
     character.meshes = motusMan.meshes;
     character.material = material;
     character.skeletonInfo = SkeletonInfo(motusMan.skeleton);
-    character.ragdollSettings = create_ragdoll_settings(motusMan.skeleton.skeleton);
+    character.ragdollSettings = get_ragdoll_settings(motusMan.skeleton.skeleton, "resources/MotusMan_v55/MotusMan_v55.ragdoll");
     character.animationContext.setup(motusMan.skeleton.skeleton.get());
     std::vector<AnimationNode1D> movementAnimations = {
-      {scene.animationDataBase.find_animation("MOB1_Walk_F_Loop_IPC"), 1.f},
-      {scene.animationDataBase.find_animation("MOB1_Jog_F_Loop_IPC"), 2.f},
-      {scene.animationDataBase.find_animation("MOB1_Run_F_Loop_IPC"), 3.f}
+      {scene.animationDataBase.find_animation("MOB1_Walk_F_Loop"), 1.f},
+      {scene.animationDataBase.find_animation("MOB1_Jog_F_Loop"), 2.f},
+      {scene.animationDataBase.find_animation("MOB1_Run_F_Loop"), 3.f}
     };
     std::vector<AnimationNode1D> idleToMovementAnimations = {
-      {scene.animationDataBase.find_animation("MOB1_Stand_Relaxed_To_Walk_F_IPC"), 1.f},
-      {scene.animationDataBase.find_animation("MOB1_Stand_Relaxed_To_Jog_F_IPC"), 2.f},
-      {scene.animationDataBase.find_animation("MOB1_Stand_Relaxed_To_Run_F_IPC"), 3.f}
+      {scene.animationDataBase.find_animation("MOB1_Stand_Relaxed_To_Walk_F"), 1.f},
+      {scene.animationDataBase.find_animation("MOB1_Stand_Relaxed_To_Jog_F"), 2.f},
+      {scene.animationDataBase.find_animation("MOB1_Stand_Relaxed_To_Run_F"), 3.f}
     };
     std::vector<AnimationNode1D> movementToIdleAnimations = {
-      {scene.animationDataBase.find_animation("MOB1_Walk_F_To_Stand_Relaxed_IPC"), 1.f},
-      {scene.animationDataBase.find_animation("MOB1_Jog_F_To_Stand_Relaxed_IPC"), 2.f},
-      {scene.animationDataBase.find_animation("MOB1_Run_F_To_Stand_Relaxed_IPC"), 3.f}
+      {scene.animationDataBase.find_animation("MOB1_Walk_F_To_Stand_Relaxed"), 1.f},
+      {scene.animationDataBase.find_animation("MOB1_Jog_F_To_Stand_Relaxed"), 2.f},
+      {scene.animationDataBase.find_animation("MOB1_Run_F_To_Stand_Relaxed"), 3.f}
     };
 
 
     std::vector<AnimationGraphNode> nodes(4);
-    nodes[0].animation = std::make_shared<SingleAnimation>(scene.animationDataBase.find_animation("MOB1_Stand_Relaxed_Idle_v2_IPC"));
+    nodes[0].animation = std::make_shared<SingleAnimation>(scene.animationDataBase.find_animation("MOB1_Stand_Relaxed_Idle_v2"));
     nodes[0].state = AnimationState::Idle;
-    nodes[1].animation = std::make_shared<BlendSpace1D>(std::move(movementAnimations));
+    nodes[1].animation = make_locomotion_blend_space(scene.animationDataBase, std::move(movementAnimations));
     nodes[1].state = AnimationState::Movement;
 
     nodes[0].edges.push_back({&nodes[0], &nodes[1], std::make_shared<BlendSpace1D>(std::move(idleToMovementAnimations)), 0.4f});
@@ -104,7 +138,7 @@ void application_init(Scene &scene)
     character.meshes = motusMan.meshes;
     character.material = material;
     character.skeletonInfo = SkeletonInfo(motusMan.skeleton);
-    character.ragdollSettings = create_ragdoll_settings(motusMan.skeleton.skeleton);
+    character.ragdollSettings = get_ragdoll_settings(motusMan.skeleton.skeleton, "resources/MotusMan_v55/MotusMan_v55.ragdoll");
     character.animationContext.setup(motusMan.skeleton.skeleton.get());
     character.controllers.push_back(std::make_shared<SingleAnimation>(scene.animationDataBase.animations[0].get()));
     scene.characters.push_back(std::move(character));
@@ -132,6 +166,14 @@ void application_init(Scene &scene)
   scene.models.push_back(std::move(motusMan));
   scene.models.push_back(std::move(ruby));
 
+  // collision cooked in earlier runs, added to every physics world created later
+  for (const ModelAsset &model : scene.models)
+  {
+    const std::string cookedPath = get_static_collision_path(model.path);
+    if (std::filesystem::exists(cookedPath))
+      scene.staticCollisionPaths.push_back(cookedPath);
+  }
+
 
   std::fflush(stdout);
 }
\ No newline at end of file
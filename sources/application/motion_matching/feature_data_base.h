@@ -3,6 +3,7 @@
 #include <string>
 #include <map>
 #include "engine/import/model.h"
+#include <ozz/base/containers/vector.h>
 
 struct Float2
 {
@@ -31,7 +32,7 @@ struct FrameFeature
 
 struct AnimationClipFeatures
 {
-  std::vector<FrameFeature> features;
+  ozz::vector<FrameFeature> features; // allocated through ozz::memory to be accounted as FeatureDataBase
   std::string name;
 };
 
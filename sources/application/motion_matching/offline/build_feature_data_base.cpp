@@ -1,9 +1,11 @@
 #include "application/motion_matching/feature_data_base.h"
 #include "application/character.h"
 #include "engine/import/model.h"
+#include "engine/memory.h"
 
 #include <ozz/animation/runtime/sampling_job.h>
 #include <ozz/animation/runtime/skeleton_utils.h>
+#include <algorithm>
 
 const float FPS = 30.f;
 
@@ -67,26 +69,62 @@ static std::vector<PoseData> sample_animation(AnimationContext &animationContext
   return poses;
 }
 
+// future trajectory samples, in frames
+static const int TRAJECTORY_OFFSETS[3] = {10, 20, 30};
+
+static Float2 to_local_xz(vec3 v, float yaw)
+{
+  // rotate into the root frame, where z is the character forward
+  const float s = sinf(-yaw), c = cosf(-yaw);
+  return Float2{v.x * c + v.z * s, -v.x * s + v.z * c};
+}
+
+// looping clips continue from their start, like displacement() and yaw_delta() wrap, others hold the last frame
+static float get_future_ratio(int frame_idx, int num_frames, bool looping)
+{
+  if (looping)
+    return float(frame_idx % num_frames) / num_frames;
+  return std::min(float(frame_idx) / num_frames, 1.f);
+}
+
+static void fill_trajectory(FrameFeature &feature, const RootMotionTrack &rootMotion, int frame_idx, int num_frames, bool looping)
+{
+  const float ratio = float(frame_idx) / num_frames;
+  const float nextRatio = get_future_ratio(frame_idx + 1, num_frames, looping);
+  const float yaw = rootMotion.sample_yaw(ratio);
+
+  Float2 *positions[3] = {&feature.trajectoryPosition0, &feature.trajectoryPosition1, &feature.trajectoryPosition2};
+  Float2 *directions[3] = {&feature.trajectoryDirection0, &feature.trajectoryDirection1, &feature.trajectoryDirection2};
+  for (int i = 0; i < 3; i++)
+  {
+    const float futureRatio = get_future_ratio(frame_idx + TRAJECTORY_OFFSETS[i], num_frames, looping);
+    *positions[i] = to_local_xz(rootMotion.displacement(ratio, futureRatio), yaw);
+    const float deltaYaw = rootMotion.yaw_delta(ratio, futureRatio);
+    *directions[i] = Float2{sinf(deltaYaw), cosf(deltaYaw)};
+  }
+  feature.hipsVelocity = to_local_xz(rootMotion.displacement(ratio, nextRatio) * FPS, yaw);
+}
+
 FeatureDataBase build_feature_data_base(const AnimationDataBase &animationDataBase)
 {
+  engine::MemoryTagScope memoryTag(engine::MemoryTag::FeatureDataBase);
   FeatureDataBase dataBase;
   AnimationContext animationContext;
   animationContext.setup(animationDataBase.skeleton.get());
 
+  // one clip per animation, so clips can be indexed as animationDataBase.animations
   for (const auto &animation : animationDataBase.animations)
   {
-    if (std::string_view(animation->name()).ends_with("_IPC"))
-      continue;
-    std::string IPCPair = animation->name();
-    IPCPair += "_IPC";
-    const ozz::animation::Animation *IPCAnimation = animationDataBase.find_animation(IPCPair);
-    assert(IPCAnimation != nullptr);
     AnimationClipFeatures clip;
-    clip.name = IPCPair;
-    std::vector<PoseData> posesRootMotion = sample_animation(animationContext, animation.get());
-    std::vector<PoseData> posesInPlace = sample_animation(animationContext, IPCAnimation);
-    assert(posesRootMotion.size() == posesInPlace.size());
-    clip.features.resize(posesRootMotion.size() - 1);
+    clip.name = animation->name();
+    const RootMotionTrack *rootMotion = animationDataBase.find_root_motion(clip.name);
+    // the clip naming convention of the animation set, "MOB1_Walk_F_Loop"
+    const bool looping = clip.name.find("_Loop") != std::string::npos;
+    if (!rootMotion)
+      engine::error("Animation \"%s\" has no root motion, trajectory features are empty", clip.name.c_str());
+
+    std::vector<PoseData> posesInPlace = sample_animation(animationContext, animation.get());
+    clip.features.resize(posesInPlace.size() - 1);
     const auto FPS_v = ozz::math::simd_float4::Load1(FPS);
     for (int i = 0; i < clip.features.size(); i++)
     {
@@ -97,9 +135,11 @@ FeatureDataBase build_feature_data_base(const AnimationDataBase &animationDataBa
       ozz::math::Store3PtrU(posesInPlace[i].rightFoot, &feature.rightFootPosition.x);
       ozz::math::Store3PtrU(leftFootVelocity, &feature.leftFootVelocity.x);
       ozz::math::Store3PtrU(rightFootVelocity, &feature.rightFootVelocity.x);
+      if (rootMotion)
+        fill_trajectory(feature, *rootMotion, i, posesInPlace.size(), looping);
     }
-    dataBase.clipMap[IPCPair] = dataBase.clips.size();
-    dataBase.clips.push_back(clip);
+    dataBase.clipMap[clip.name] = dataBase.clips.size();
+    dataBase.clips.push_back(std::move(clip));
   }
   return dataBase;
-}
\ No newline at end of file
+}
@@ -0,0 +1,88 @@
+#include "physics_world.h"
+#include <Jolt/Physics/Body/BodyInterface.h>
+#include <Jolt/Physics/Body/BodyCreationSettings.h>
+#include <Jolt/Physics/Collision/Shape/BoxShape.h>
+#include "engine/api.h"
+#include "import/timer.h"
+
+const char *get_physics_job_backend_name(PhysicsJobBackend backend)
+{
+  switch (backend)
+  {
+  case PhysicsJobBackend::EnginePool: return "engine pool";
+  case PhysicsJobBackend::JoltThreadPool: return "jolt pool";
+  case PhysicsJobBackend::SingleThreaded: return "single";
+  }
+  return "";
+}
+
+void spawn_benchmark_scene(PhysicsWorld &world, const JPH::Ref<JPH::RagdollSettings> &ragdoll_settings, int ragdoll_count, int box_count,
+  std::vector<JPH::Ref<JPH::Ragdoll>> &ragdolls)
+{
+  JPH::BodyInterface &bodyInterface = world.mPhysicsSystem.GetBodyInterface();
+  const int perLayer = 15 * 15;
+  for (int i = 0; i < ragdoll_count; i++)
+  {
+    JPH::Ref<JPH::Ragdoll> ragdoll = world.create_ragdoll(ragdoll_settings);
+    const int cell = i % perLayer, layer = i / perLayer;
+    const JPH::Vec3 offset((cell % 15 - 7) * 1.2f, 0.5f + layer * 2.f, (cell / 15 - 7) * 1.2f);
+    for (JPH::uint b = 0; b < ragdoll->GetBodyCount(); b++)
+    {
+      const JPH::BodyID id = ragdoll->GetBodyID(b);
+      bodyInterface.SetPosition(id, bodyInterface.GetPosition(id) + offset, JPH::EActivation::DontActivate);
+    }
+    ragdoll->AddToPhysicsSystem(JPH::EActivation::Activate);
+    ragdolls.push_back(ragdoll);
+  }
+
+  JPH::Ref<JPH::Shape> boxShape = new JPH::BoxShape(JPH::Vec3(0.25f, 0.25f, 0.25f));
+  for (int i = 0; i < box_count; i++)
+  {
+    const int cell = i % perLayer, layer = i / perLayer;
+    const JPH::Vec3 position((cell % 15 - 7) * 1.2f + 0.6f, 3.f + layer * 0.6f, (cell / 15 - 7) * 1.2f + 0.6f);
+    JPH::BodyCreationSettings settings(boxShape, position, JPH::Quat::sIdentity(), JPH::EMotionType::Dynamic, ObjectLayers::Moving);
+    bodyInterface.CreateAndAddBody(settings, JPH::EActivation::Activate);
+  }
+  world.mPhysicsSystem.OptimizeBroadPhase();
+}
+
+static PhysicsBenchmarkResult run_benchmark_case(const JPH::Ref<JPH::RagdollSettings> &ragdoll_settings,
+  PhysicsJobBackend backend, int thread_count, int ragdoll_count, int steps)
+{
+  PhysicsWorldSettings settings;
+  settings.jobBackend = backend;
+  settings.threadCount = thread_count;
+  PhysicsWorld world(settings);
+
+  std::vector<JPH::Ref<JPH::Ragdoll>> ragdolls;
+  spawn_benchmark_scene(world, ragdoll_settings, ragdoll_count, 0, ragdolls);
+
+  const float fixedTimeStep = 1.0f / 60.0f;
+  const int warmupSteps = 10;
+  for (int i = 0; i < warmupSteps; i++)
+    world.update_physics(fixedTimeStep);
+  Timer timer;
+  for (int i = 0; i < steps; i++)
+    world.update_physics(fixedTimeStep);
+  const float stepMs = timer.elapsed_ms() / std::max(steps, 1);
+
+  for (JPH::Ragdoll *ragdoll : ragdolls)
+    ragdoll->RemoveFromPhysicsSystem();
+  return {backend, world.mJobSystem->GetMaxConcurrency(), ragdoll_count, stepMs, world.mTempAllocator->get_high_water_mark()};
+}
+
+std::vector<PhysicsBenchmarkResult> run_physics_benchmark(const JPH::Ref<JPH::RagdollSettings> &ragdoll_settings,
+  std::span<const int> ragdoll_counts, std::span<const int> thread_counts, int steps)
+{
+  std::vector<PhysicsBenchmarkResult> results;
+  engine::log("Physics benchmark, %d steps per case", steps);
+  engine::log("%-12s %8s %8s %10s %10s", "backend", "threads", "ragdolls", "step ms", "temp KiB");
+  for (PhysicsJobBackend backend : {PhysicsJobBackend::EnginePool, PhysicsJobBackend::JoltThreadPool})
+    for (int threadCount : thread_counts)
+      for (int ragdollCount : ragdoll_counts)
+      {
+        const PhysicsBenchmarkResult &result = results.emplace_back(run_benchmark_case(ragdoll_settings, backend, threadCount, ragdollCount, steps));
+        engine::log("%-12s %8d %8d %10.3f %10u", get_physics_job_backend_name(backend), result.threadCount, ragdollCount, result.stepMs, result.tempHighWaterMark / 1024);
+      }
+  return results;
+}
@@ -0,0 +1,110 @@
+#include "physics_jobs.h"
+#include "engine/profiler.h"
+#include <algorithm>
+
+EngineJobSystem::EngineJobSystem(engine::JobSystem &pool, int max_concurrency, JPH::uint max_jobs, JPH::uint max_barriers)
+  : JPH::JobSystemWithBarrier(max_barriers), mPool(pool)
+{
+  const int available = pool.thread_count() + 1;
+  mMaxConcurrency = max_concurrency > 0 ? std::min(max_concurrency, available) : available;
+  mJobs.Init(max_jobs, max_jobs);
+}
+
+EngineJobSystem::JobHandle EngineJobSystem::CreateJob(const char *inName, JPH::ColorArg inColor, const JobFunction &inJobFunction, JPH::uint32 inNumDependencies)
+{
+  JPH::uint32 index;
+  while ((index = mJobs.ConstructObject(inName, inColor, this, inJobFunction, inNumDependencies)) == JPH::FixedSizeFreeList<Job>::cInvalidObjectIndex)
+  {
+    JPH_ASSERT(false, "No jobs available!");
+    std::this_thread::yield();
+  }
+  Job *job = &mJobs.Get(index);
+  // the handle holds a reference, so the job can't be freed before it's queued
+  JobHandle handle(job);
+  if (inNumDependencies == 0)
+    QueueJob(job);
+  return handle;
+}
+
+void EngineJobSystem::QueueJob(Job *inJob)
+{
+  // the barrier runs queued jobs on the waiting thread too
+  if (mPool.thread_count() == 0)
+    return;
+  inJob->AddRef();
+  mPool.submit([inJob]()
+  {
+    PROFILE_ZONE("physics job");
+    // a barrier may already have executed it on the waiting thread, Execute is a no-op then
+    inJob->Execute();
+    inJob->Release();
+  });
+}
+
+void EngineJobSystem::QueueJobs(Job **inJobs, JPH::uint inNumJobs)
+{
+  for (JPH::uint i = 0; i < inNumJobs; i++)
+    QueueJob(inJobs[i]);
+}
+
+void EngineJobSystem::FreeJob(Job *inJob)
+{
+  mJobs.DestructObject(inJob);
+}
+
+GrowingTempAllocator::GrowingTempAllocator(JPH::uint initial_capacity)
+  : mCapacity(JPH::AlignUp(initial_capacity, JPH_RVECTOR_ALIGNMENT))
+{
+  mBase = static_cast<JPH::uint8 *>(JPH::AlignedAllocate(mCapacity, JPH_RVECTOR_ALIGNMENT));
+}
+
+GrowingTempAllocator::~GrowingTempAllocator()
+{
+  JPH_ASSERT(mTop == 0 && mUsed == 0);
+  JPH::AlignedFree(mBase);
+}
+
+void *GrowingTempAllocator::Allocate(JPH::uint inSize)
+{
+  if (inSize == 0)
+    return nullptr;
+  const JPH::uint size = JPH::AlignUp(inSize, JPH_RVECTOR_ALIGNMENT);
+  mUsed += size;
+  mHighWaterMark = std::max(mHighWaterMark, mUsed);
+  if (mTop + size <= mCapacity)
+  {
+    void *address = mBase + mTop;
+    mTop += size;
+    return address;
+  }
+  mOverflowCount++;
+  return JPH::AlignedAllocate(size, JPH_RVECTOR_ALIGNMENT);
+}
+
+void GrowingTempAllocator::Free(void *inAddress, JPH::uint inSize)
+{
+  if (inAddress == nullptr)
+    return;
+  const JPH::uint size = JPH::AlignUp(inSize, JPH_RVECTOR_ALIGNMENT);
+  mUsed -= size;
+  if (inAddress >= mBase && inAddress < mBase + mCapacity)
+  {
+    mTop -= size;
+    JPH_ASSERT(mBase + mTop == inAddress, "Temp allocations must be freed in reverse order");
+  }
+  else
+  {
+    JPH::AlignedFree(inAddress);
+  }
+}
+
+void GrowingTempAllocator::end_step()
+{
+  if (mTop != 0 || mHighWaterMark <= mCapacity)
+    return;
+  // a quarter of headroom for steps with more contacts than seen so far
+  const JPH::uint capacity = JPH::AlignUp(mHighWaterMark + mHighWaterMark / 4, JPH_RVECTOR_ALIGNMENT);
+  JPH::AlignedFree(mBase);
+  mBase = static_cast<JPH::uint8 *>(JPH::AlignedAllocate(capacity, JPH_RVECTOR_ALIGNMENT));
+  mCapacity = capacity;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Jolt/Jolt.h>
+#include <Jolt/Core/JobSystemWithBarrier.h>
+#include <Jolt/Core/FixedSizeFreeList.h>
+#include <Jolt/Core/TempAllocator.h>
+#include "engine/job_system.h"
+
+// Jolt jobs executed by an engine worker pool, the shared one or a pool owned by the physics world
+class EngineJobSystem final : public JPH::JobSystemWithBarrier
+{
+public:
+  // max_concurrency <= 0 uses all workers and the calling thread, a pool without workers leaves every job
+  // to the thread waiting on its barrier
+  EngineJobSystem(engine::JobSystem &pool, int max_concurrency, JPH::uint max_jobs, JPH::uint max_barriers);
+
+  int GetMaxConcurrency() const override { return mMaxConcurrency; }
+  JobHandle CreateJob(const char *inName, JPH::ColorArg inColor, const JobFunction &inJobFunction, JPH::uint32 inNumDependencies = 0) override;
+
+protected:
+  void QueueJob(Job *inJob) override;
+  void QueueJobs(Job **inJobs, JPH::uint inNumJobs) override;
+  void FreeJob(Job *inJob) override;
+
+private:
+  engine::JobSystem &mPool;
+  int mMaxConcurrency;
+  JPH::FixedSizeFreeList<Job> mJobs;
+};
+
+// Stack allocator which falls back to the heap when its buffer is exhausted.
+// Between steps the buffer grows to the observed high-water mark, so overflows stop after a few steps.
+class GrowingTempAllocator final : public JPH::TempAllocator
+{
+public:
+  explicit GrowingTempAllocator(JPH::uint initial_capacity);
+  ~GrowingTempAllocator() override;
+
+  void *Allocate(JPH::uint inSize) override;
+  void Free(void *inAddress, JPH::uint inSize) override;
+
+  // call when all memory is freed, e.g. after PhysicsSystem::Update
+  void end_step();
+
+  JPH::uint get_capacity() const { return mCapacity; }
+  JPH::uint get_high_water_mark() const { return mHighWaterMark; }
+  JPH::uint get_overflow_count() const { return mOverflowCount; }
+
+private:
+  JPH::uint8 *mBase = nullptr;
+  JPH::uint mCapacity = 0;
+  JPH::uint mTop = 0;
+  JPH::uint mUsed = 0; // buffer and heap together
+  JPH::uint mHighWaterMark = 0;
+  JPH::uint mOverflowCount = 0;
+};
@@ -3,6 +3,7 @@
 #include <Jolt/Physics/Collision/BroadPhase/BroadPhaseLayer.h>
 #include <Jolt/Physics/Collision/ObjectLayer.h>
 #include <Jolt/Core/JobSystemSingleThreaded.h>
+#include <Jolt/Core/JobSystemThreadPool.h>
 
 #include <Jolt/Physics/Body/BodyCreationSettings.h>
 #include <Jolt/Physics/Body/Body.h>
@@ -12,6 +13,13 @@
 #include <Jolt/Renderer/DebugRendererSimple.h>
 
 #include "imgui/imgui.h" // for debug rendering
+#include "static_collision.h"
+#include "engine/api.h"
+#include "engine/mapped_file.h"
+#include "engine/memory.h"
+#include "engine/profiler.h"
+#include "import/timer.h"
+#include <cstring>
 
 static glm::vec2 world_to_screen(const glm::mat4 &world_to_screen, glm::vec3 world_position, glm::vec2 display_size)
 {
@@ -63,65 +71,239 @@ public:
   }
 };
 
-class StubBroadPhaseLayer final : public JPH::BroadPhaseLayerInterface
+static bool object_layers_collide(JPH::ObjectLayer layer1, JPH::ObjectLayer layer2)
+{
+  switch (layer1)
+  {
+  case ObjectLayers::Static:
+    return layer2 != ObjectLayers::Static;
+  case ObjectLayers::Moving:
+  case ObjectLayers::Ragdoll:
+    return layer2 != ObjectLayers::Debris;
+  case ObjectLayers::Debris:
+    return layer2 == ObjectLayers::Static;
+  default:
+    return false;
+  }
+}
+
+class BroadPhaseLayerMapping final : public JPH::BroadPhaseLayerInterface
 {
 public:
   JPH::uint GetNumBroadPhaseLayers() const override
   {
-    return 1;
+    return BroadPhaseLayers::Count;
   }
 
   JPH::BroadPhaseLayer GetBroadPhaseLayer(JPH::ObjectLayer inLayer) const override
   {
-    return JPH::BroadPhaseLayer(0x00);
+    JPH_ASSERT(inLayer < ObjectLayers::Count);
+    // broad-phase layers are numbered as object layers
+    return JPH::BroadPhaseLayer(JPH::BroadPhaseLayer::Type(inLayer));
+  }
+
+#if defined(JPH_EXTERNAL_PROFILE) || defined(JPH_PROFILE_ENABLED)
+  const char *GetBroadPhaseLayerName(JPH::BroadPhaseLayer inLayer) const override
+  {
+    const char *names[] = {"Static", "Moving", "Ragdoll", "Debris"};
+    return names[JPH::BroadPhaseLayer::Type(inLayer)];
+  }
+#endif
+};
+
+class LayerVsBroadPhaseFilter final : public JPH::ObjectVsBroadPhaseLayerFilter
+{
+public:
+  bool ShouldCollide(JPH::ObjectLayer inLayer1, JPH::BroadPhaseLayer inLayer2) const override
+  {
+    return object_layers_collide(inLayer1, JPH::ObjectLayer(JPH::BroadPhaseLayer::Type(inLayer2)));
+  }
+};
+
+class LayerPairFilter final : public JPH::ObjectLayerPairFilter
+{
+public:
+  bool ShouldCollide(JPH::ObjectLayer inLayer1, JPH::ObjectLayer inLayer2) const override
+  {
+    return object_layers_collide(inLayer1, inLayer2);
   }
 };
 
 
-static StubBroadPhaseLayer sStubBroadPhaseLayer;
-static JPH::ObjectVsBroadPhaseLayerFilter sObjectVsBroadPhaseLayerFilter;
-static JPH::ObjectLayerPairFilter sObjectLayerPairFilter;
+static BroadPhaseLayerMapping sBroadPhaseLayerMapping;
+static LayerVsBroadPhaseFilter sObjectVsBroadPhaseLayerFilter;
+static LayerPairFilter sObjectLayerPairFilter;
 
-PhysicsWorld::PhysicsWorld()
+PhysicsWorld::PhysicsWorld(const PhysicsWorldSettings &settings) : mMaxSubsteps(settings.maxSubsteps)
 {
-  mTempAllocator = std::make_unique<JPH::TempAllocatorImpl>(1024 * 1024);
+  mTempAllocator = std::make_unique<GrowingTempAllocator>(settings.tempAllocatorSize);
 
-  mJobSystem = std::make_unique<JPH::JobSystemSingleThreaded>(JPH::cMaxPhysicsJobs);
-  int maxBodies = 1024;
-  int bodyMutexes = 0; // use 0 to autodetect
-  int maxBodiesPairs = 1024;
-  int maxBodiesConstraints = 1024;
-  mPhysicsSystem.Init(maxBodies, bodyMutexes, maxBodiesPairs, maxBodiesConstraints, sStubBroadPhaseLayer, sObjectVsBroadPhaseLayerFilter, sObjectLayerPairFilter);
+  switch (settings.jobBackend)
+  {
+  case PhysicsJobBackend::EnginePool:
+    // a thread count gets its own workers, otherwise physics jobs would still spread over the whole shared pool
+    if (settings.threadCount > 0)
+      mJobPool = std::make_unique<engine::JobSystem>(settings.threadCount - 1);
+    mJobSystem = std::make_unique<EngineJobSystem>(mJobPool ? *mJobPool : engine::get_job_system(), settings.threadCount, JPH::cMaxPhysicsJobs, JPH::cMaxPhysicsBarriers);
+    break;
+  case PhysicsJobBackend::JoltThreadPool:
+    // the calling thread takes part in the step too
+    mJobSystem = std::make_unique<JPH::JobSystemThreadPool>(JPH::cMaxPhysicsJobs, JPH::cMaxPhysicsBarriers, settings.threadCount > 0 ? settings.threadCount - 1 : -1);
+    break;
+  case PhysicsJobBackend::SingleThreaded:
+    mJobSystem = std::make_unique<JPH::JobSystemSingleThreaded>(JPH::cMaxPhysicsJobs);
+    break;
+  }
+  mPhysicsSystem.Init(settings.maxBodies, settings.bodyMutexes, settings.maxBodyPairs, settings.maxContactConstraints,
+    sBroadPhaseLayerMapping, sObjectVsBroadPhaseLayerFilter, sObjectLayerPairFilter);
 
   JPH::BodyInterface &bodyInterface = mPhysicsSystem.GetBodyInterface();
 
   {
-    JPH::BodyCreationSettings settings(new JPH::BoxShape(JPH::Vec3(10.0f, 0.1f, 10.0f)), JPH::Vec3(0, -0.1f, 0), JPH::Quat::sIdentity(), JPH::EMotionType::Static, sObjectLayer);
+    JPH::BodyCreationSettings settings(new JPH::BoxShape(JPH::Vec3(10.0f, 0.1f, 10.0f)), JPH::Vec3(0, -0.1f, 0), JPH::Quat::sIdentity(), JPH::EMotionType::Static, ObjectLayers::Static);
     JPH::Body *floor = bodyInterface.CreateBody(settings);
     bodyInterface.AddBody(floor->GetID(), JPH::EActivation::DontActivate);
   }
 
   for (JPH::Vec3 position : {JPH::Vec3(2, 2, 0), JPH::Vec3(-2, 3, 0), JPH::Vec3(-1, 4, 2)})
   {
-    JPH::BodyCreationSettings settings(new JPH::BoxShape(JPH::Vec3(0.5f, 0.5f, 0.5f)), position, JPH::Quat::sIdentity(), JPH::EMotionType::Dynamic, sObjectLayer);
+    JPH::BodyCreationSettings settings(new JPH::BoxShape(JPH::Vec3(0.5f, 0.5f, 0.5f)), position, JPH::Quat::sIdentity(), JPH::EMotionType::Dynamic, ObjectLayers::Moving);
     settings.mOverrideMassProperties = JPH::EOverrideMassProperties::CalculateMassAndInertia;
     settings.mMassPropertiesOverride.mMass = 1.0f;
     JPH::Body *cube = bodyInterface.CreateBody(settings);
     bodyInterface.AddBody(cube->GetID(), JPH::EActivation::Activate);
   }
+  mPhysicsSystem.OptimizeBroadPhase();
+}
+
+// reads Jolt binary state straight from a memory mapped file
+class MemoryStreamIn final : public JPH::StreamIn
+{
+public:
+  MemoryStreamIn(const uint8_t *data, size_t size) : mData(data), mSize(size) {}
+
+  void ReadBytes(void *outData, size_t inNumBytes) override
+  {
+    if (inNumBytes > mSize - mOffset)
+    {
+      memset(outData, 0, inNumBytes);
+      mOffset = mSize;
+      mFailed = true;
+      return;
+    }
+    memcpy(outData, mData + mOffset, inNumBytes);
+    mOffset += inNumBytes;
+  }
+
+  bool IsEOF() const override
+  {
+    return mOffset >= mSize;
+  }
+
+  bool IsFailed() const override
+  {
+    return mFailed;
+  }
+
+private:
+  const uint8_t *mData;
+  size_t mSize;
+  size_t mOffset = 0;
+  bool mFailed = false;
+};
+
+int PhysicsWorld::add_static_collision(const std::string &cooked_path)
+{
+  Timer timer;
+  engine::MappedFile file(cooked_path.c_str());
+  StaticCollisionHeader header;
+  if (!file.is_open() || file.size() < sizeof(header))
+  {
+    engine::error("Static collision \"%s\" not found, cook it from the model first", cooked_path.c_str());
+    return 0;
+  }
+  memcpy(&header, file.data(), sizeof(header));
+  if (header.magic != STATIC_COLLISION_MAGIC || header.version != STATIC_COLLISION_VERSION)
+  {
+    engine::error("Static collision \"%s\" has unsupported format, cook it again", cooked_path.c_str());
+    return 0;
+  }
+
+  MemoryStreamIn stream(file.data() + sizeof(header), file.size() - sizeof(header));
+  JPH::Shape::IDToShapeMap shapeMap;
+  JPH::Shape::IDToMaterialMap materialMap;
+  JPH::BodyInterface &bodyInterface = mPhysicsSystem.GetBodyInterface();
+  std::vector<JPH::BodyID> bodies;
+  bodies.reserve(header.shapeCount);
+  for (uint32_t i = 0; i < header.shapeCount; i++)
+  {
+    JPH::Shape::ShapeResult result = JPH::Shape::sRestoreWithChildren(stream, shapeMap, materialMap);
+    if (result.HasError())
+    {
+      // a part of the level would leave holes to fall through, so the file is rejected as a whole
+      engine::error("Failed to restore static collision from \"%s\": %s, none of its %u shapes are added, cook it again",
+        cooked_path.c_str(), result.GetError().c_str(), header.shapeCount);
+      bodyInterface.DestroyBodies(bodies.data(), int(bodies.size()));
+      return 0;
+    }
+    // vertices are cooked in model space, so bodies sit at the origin
+    JPH::BodyCreationSettings settings(result.Get(), JPH::RVec3::sZero(), JPH::Quat::sIdentity(), JPH::EMotionType::Static, ObjectLayers::Static);
+    JPH::Body *body = bodyInterface.CreateBody(settings);
+    if (!body)
+    {
+      engine::error("Out of bodies while adding static collision \"%s\", %zu of %u shapes are added",
+        cooked_path.c_str(), bodies.size(), header.shapeCount);
+      break;
+    }
+    bodies.push_back(body->GetID());
+  }
+  if (bodies.empty())
+    return 0;
+
+  // one broad-phase tree is built for the whole batch instead of inserting bodies one by one
+  JPH::BodyInterface::AddState state = bodyInterface.AddBodiesPrepare(bodies.data(), int(bodies.size()));
+  bodyInterface.AddBodiesFinalize(bodies.data(), int(bodies.size()), state, JPH::EActivation::DontActivate);
+  engine::log("Static collision \"%s\" added, %zu bodies. %f ms", cooked_path.c_str(), bodies.size(), timer.elapsed_ms());
+  return int(bodies.size());
 }
 
 void PhysicsWorld::update_physics(float dt)
 {
   const float fixedTimeStep = 1.0f / 60.0f;
   mAccumuletedDeltaTime += dt;
+  int substeps = 0;
   while (mAccumuletedDeltaTime >= fixedTimeStep)
   {
+    // slow frames drop simulated time instead of spiraling into more and more substeps
+    if (substeps++ == mMaxSubsteps)
+    {
+      mAccumuletedDeltaTime = 0.0f;
+      break;
+    }
     mAccumuletedDeltaTime -= fixedTimeStep;
     // We should update physics with fixed delta time
+    Timer timer;
     mPhysicsSystem.Update(fixedTimeStep, 1, mTempAllocator.get(), mJobSystem.get());
+    mTempAllocator->end_step();
+    mLastStepMs = timer.elapsed_ms();
   }
 }
+
+void PhysicsWorld::begin_update_physics(float dt)
+{
+  engine::get_job_system().submit([this, dt]()
+  {
+    PROFILE_ZONE("physics");
+    update_physics(dt);
+  }, &mUpdateCounter);
+}
+
+void PhysicsWorld::wait_update_physics()
+{
+  PROFILE_ZONE("wait physics");
+  engine::get_job_system().wait(mUpdateCounter);
+}
+
 void PhysicsWorld::debug_render(const glm::mat4 &world_to_screen, glm::vec3 camera_position)
 {
   ImGuiDebugRenderer *renderer = static_cast<ImGuiDebugRenderer *>(JPH::DebugRenderer::sInstance);
@@ -134,16 +316,59 @@ void PhysicsWorld::debug_render(const glm::mat4 &world_to_screen, glm::vec3 came
   mPhysicsSystem.DrawConstraintLimits(JPH::DebugRenderer::sInstance);
 }
 
+#ifdef JPH_EXTERNAL_PROFILE
+// JPH_PROFILE scopes of Jolt, job names included, become engine profiler zones
+JPH::ExternalProfileMeasurement::ExternalProfileMeasurement(const char *inName, JPH::uint32 inColor)
+{
+  static_assert(sizeof(engine::ProfileScope) <= sizeof(mUserData));
+  new (mUserData) engine::ProfileScope(inName);
+}
+
+JPH::ExternalProfileMeasurement::~ExternalProfileMeasurement()
+{
+  reinterpret_cast<engine::ProfileScope *>(mUserData)->~ProfileScope();
+}
+#endif
+
+// Jolt allocations are accounted as Physics regardless of the current memory tag
+static void *jolt_allocate(size_t size)
+{
+  return engine::tracked_allocate(engine::MemoryTag::Physics, size, 16);
+}
+
+static void *jolt_reallocate(void *block, size_t, size_t new_size)
+{
+  // Jolt arrays make their first allocation through Reallocate
+  return engine::tracked_reallocate(engine::MemoryTag::Physics, block, new_size, 16);
+}
+
+static void *jolt_aligned_allocate(size_t size, size_t alignment)
+{
+  return engine::tracked_allocate(engine::MemoryTag::Physics, size, alignment);
+}
+
+static void jolt_free(void *block)
+{
+  engine::tracked_free(block);
+}
+
 void init_phys_globals()
 {
-  JPH::RegisterDefaultAllocator();
+  JPH::Allocate = jolt_allocate;
+  JPH::Reallocate = jolt_reallocate;
+  JPH::Free = jolt_free;
+  JPH::AlignedAllocate = jolt_aligned_allocate;
+  JPH::AlignedFree = jolt_free;
   JPH::Factory::sInstance = new JPH::Factory();
   JPH::DebugRenderer::sInstance = new ImGuiDebugRenderer();
   JPH::RegisterTypes();
 }
 
+void clear_ragdoll_settings_cache();
+
 void destroy_phys_globals()
 {
+  clear_ragdoll_settings_cache();
   delete JPH::Factory::sInstance;
   JPH::Factory::sInstance = nullptr;
   delete JPH::DebugRenderer::sInstance;
@@ -7,37 +7,114 @@
 #include <Jolt/Core/TempAllocator.h>
 #include <Jolt/Core/JobSystem.h>
 #include <Jolt/Physics/Ragdoll/Ragdoll.h>
+#include "physics_jobs.h"
+#include "ragdoll_manager.h"
+#include <span>
+#include <string>
+#include <vector>
 
 
-constexpr JPH::ObjectLayer sObjectLayer = 0;
-constexpr JPH::CollisionGroup::GroupID sCollisionGroup = 0;
+// static never collides with static, debris only with static, everything else collides
+namespace ObjectLayers
+{
+	constexpr JPH::ObjectLayer Static = 0;
+	constexpr JPH::ObjectLayer Moving = 1;
+	constexpr JPH::ObjectLayer Ragdoll = 2;
+	constexpr JPH::ObjectLayer Debris = 3;
+	constexpr JPH::uint Count = 4;
+}
+
+// one broad-phase tree per object layer, so sleeping static geometry isn't rebuilt with moving bodies
+// and layers which never collide are never queried against each other
+namespace BroadPhaseLayers
+{
+	constexpr JPH::BroadPhaseLayer Static(0);
+	constexpr JPH::BroadPhaseLayer Moving(1);
+	constexpr JPH::BroadPhaseLayer Ragdoll(2);
+	constexpr JPH::BroadPhaseLayer Debris(3);
+	constexpr JPH::uint Count = 4;
+}
 
 void init_phys_globals();
 
 void destroy_phys_globals();
 
+enum class PhysicsJobBackend
+{
+	EnginePool,     // engine workers, the pool shared with animation or threadCount - 1 own ones
+	JoltThreadPool, // Jolt's own threads, fallback
+	SingleThreaded
+};
+
+struct PhysicsWorldSettings
+{
+	PhysicsJobBackend jobBackend = PhysicsJobBackend::EnginePool;
+	int threadCount = 0;                  // threads stepping physics with the calling one, 0 to use all
+	JPH::uint tempAllocatorSize = 256 * 1024; // initial size, grows to the high-water mark
+	// sized for hundreds of ragdolls of ~20 parts
+	JPH::uint maxBodies = 8192;
+	JPH::uint bodyMutexes = 0; // use 0 to autodetect
+	JPH::uint maxBodyPairs = 16384;
+	JPH::uint maxContactConstraints = 8192;
+	int maxSubsteps = 4;
+};
+
 struct PhysicsWorld
 {
 	std::unique_ptr<JPH::JobSystem> mJobSystem;           // The job system that runs physics jobs
+	std::unique_ptr<engine::JobSystem> mJobPool;          // Own workers of the EnginePool backend with a thread count, drained before mJobSystem is destroyed
 
 	JPH::PhysicsSystem mPhysicsSystem;									  // The physics system that simulates the world
 	JPH::PhysicsSettings mPhysicsSettings;							  // Main physics simulation settings
-	std::unique_ptr<JPH::TempAllocator> mTempAllocator;   // Temporary allocator for physics jobs
+	std::unique_ptr<GrowingTempAllocator> mTempAllocator; // Temporary allocator for physics jobs
+	RagdollManager mRagdollManager{*this};                // Pooled ragdolls, destroyed before the physics system
 
 	float mAccumuletedDeltaTime = 0.0f; // Accumulated time since last physics update
-	PhysicsWorld();
+	float mLastStepMs = 0.0f;           // Duration of the last PhysicsSystem::Update
+	int mMaxSubsteps;                   // Steps per update_physics call, the rest of the accumulated time is dropped
+	engine::JobCounter mUpdateCounter;  // Pending asynchronous update
+	JPH::CollisionGroup::GroupID mNextCollisionGroup = 0; // Every ragdoll gets its own group
+	PhysicsWorld(const PhysicsWorldSettings &settings = PhysicsWorldSettings());
 
 	void update_physics(float dt);
 
+	// runs update_physics on the job system, bodies must not be touched until wait_update_physics
+	void begin_update_physics(float dt);
+	void wait_update_physics();
+
 	// world_to_screen == camera.projection * inverse(camera.transform)
 	void debug_render(const glm::mat4 &world_to_screen, glm::vec3 camera_position);
 
+	// loads a cooked static collision file and adds its bodies to the static layer in one batch,
+	// returns the number of added bodies
+	int add_static_collision(const std::string &cooked_path);
+
 	// return weak reference to the ragdoll
+	// parts of one ragdoll are filtered by the settings group filter, different ragdolls always collide
 	JPH::Ref<JPH::Ragdoll> create_ragdoll(const JPH::Ref<JPH::RagdollSettings> &settings)
 	{
-		JPH::Ragdoll *ragdoll = settings->CreateRagdoll(sCollisionGroup, 0, &mPhysicsSystem);
+		JPH::Ragdoll *ragdoll = settings->CreateRagdoll(mNextCollisionGroup++, 0, &mPhysicsSystem);
 		return ragdoll;
 	}
 
 };
 
+const char *get_physics_job_backend_name(PhysicsJobBackend backend);
+
+struct PhysicsBenchmarkResult
+{
+	PhysicsJobBackend backend;
+	int threadCount; // threads which stepped the world, the calling one included
+	int ragdollCount;
+	float stepMs;              // average over measured steps
+	JPH::uint tempHighWaterMark; // bytes
+};
+
+// ragdolls on a grid over the 20x20 m floor, extra layers stack up, so piles form during the run, boxes fall between them
+void spawn_benchmark_scene(PhysicsWorld &world, const JPH::Ref<JPH::RagdollSettings> &ragdoll_settings, int ragdoll_count, int box_count,
+	std::vector<JPH::Ref<JPH::Ragdoll>> &ragdolls);
+
+// steps a fresh world with ragdoll_counts x thread_counts ragdolls for every backend except SingleThreaded
+std::vector<PhysicsBenchmarkResult> run_physics_benchmark(const JPH::Ref<JPH::RagdollSettings> &ragdoll_settings,
+	std::span<const int> ragdoll_counts, std::span<const int> thread_counts, int steps);
+
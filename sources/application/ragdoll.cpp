@@ -9,6 +9,12 @@
 #include <Jolt/Physics/Collision/Shape/CapsuleShape.h>
 #include <Jolt/Physics/Collision/Shape/RotatedTranslatedShape.h>
 #include "import/model.h"
+#include "import/timer.h"
+#include "engine/api.h"
+#include "engine/replay.h"
+#include <Jolt/Core/StreamWrapper.h>
+#include <fstream>
+#include <unordered_map>
 #include <ozz/animation/runtime/local_to_model_job.h>
 #include <ozz/animation/runtime/skeleton_utils.h>
 #include <ozz/base/maths/simd_math.h>
@@ -33,7 +39,7 @@ static JPH::Ref<JPH::Shape> create_capsule_body(float half_height, float radius,
 	return create_capsule_shape(half_height, radius, JPH::Vec3(0, 0, 0), euler);
 }
 
-JPH::Ref<JPH::RagdollSettings> create_ragdoll_settings(const SkeletonPtr &skeleton_src)
+static JPH::Ref<JPH::RagdollSettings> create_ragdoll_settings(const SkeletonPtr &skeleton_src)
 {
   std::vector<ozz::math::Float4x4> transforms;
 	{
@@ -207,7 +213,7 @@ JPH::Ref<JPH::RagdollSettings> create_ragdoll_settings(const SkeletonPtr &skelet
 		part.mPosition = JPH::RVec3(position[0], position[1], position[2]);
 		part.mRotation = JPH::Quat(rotation[0], rotation[1], rotation[2], rotation[3]);
 		part.mMotionType = JPH::EMotionType::Dynamic;
-		part.mObjectLayer = sObjectLayer;
+		part.mObjectLayer = ObjectLayers::Ragdoll;
 
 		// First part is the root, doesn't have a parent and doesn't have a constraint
 		if (p > 0)
@@ -228,11 +234,112 @@ JPH::Ref<JPH::RagdollSettings> create_ragdoll_settings(const SkeletonPtr &skelet
 	// Optional: Stabilize the inertia of the limbs
 	settings->Stabilize();
 
-	// Disable parent child collisions so that we don't get collisions between constrained bodies
-	// settings->DisableParentChildCollisions();
+	// Disable parent child collisions so that we don't get collisions between constrained bodies,
+	// parts which overlap in the bind pose (pelvis and thighs, chest and upper arms) are disabled too
+	std::vector<JPH::Mat44> bindPose(settings->mParts.size());
+	for (size_t p = 0; p < bindPose.size(); ++p)
+		bindPose[p] = JPH::Mat44::sRotationTranslation(settings->mParts[p].mRotation, JPH::Vec3(settings->mParts[p].mPosition));
+	settings->DisableParentChildCollisions(bindPose.data(), 0.05f);
 
 	// Calculate the map needed for GetBodyIndexToConstraintIndex()
 	settings->CalculateBodyIndexToConstraintIndex();
 
 	return settings;
-}
\ No newline at end of file
+}
+
+// bump when create_ragdoll_settings changes, cached files of older versions are rebuilt
+static const uint32_t RAGDOLL_CACHE_VERSION = 1;
+static const uint32_t RAGDOLL_CACHE_MAGIC = 0x4C444752; // "RGDL"
+
+struct RagdollCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t skeletonHash;
+};
+
+// identifies the skeleton asset by its content, characters loaded from the same model share settings
+static uint64_t hash_skeleton(const ozz::animation::Skeleton &skeleton)
+{
+	uint64_t hash = engine::hash_bytes(nullptr, 0);
+	for (const char *name : skeleton.joint_names())
+		hash = engine::hash_bytes(name, strlen(name) + 1, hash);
+	const auto parents = skeleton.joint_parents();
+	hash = engine::hash_bytes(parents.data(), parents.size_bytes(), hash);
+	const auto restPoses = skeleton.joint_rest_poses();
+	return engine::hash_bytes(restPoses.data(), restPoses.size_bytes(), hash);
+}
+
+static JPH::Ref<JPH::RagdollSettings> load_ragdoll_settings(const std::string &path, const uint64_t *skeleton_hash)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return nullptr;
+	RagdollCacheHeader header;
+	if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+		header.magic != RAGDOLL_CACHE_MAGIC || header.version != RAGDOLL_CACHE_VERSION || (skeleton_hash && header.skeletonHash != *skeleton_hash))
+		return nullptr;
+	JPH::StreamInWrapper stream(file);
+	JPH::RagdollSettings::RagdollResult result = JPH::RagdollSettings::sRestoreFromBinaryState(stream);
+	if (result.HasError())
+	{
+		engine::error("Failed to restore ragdoll settings from \"%s\": %s", path.c_str(), result.GetError().c_str());
+		return nullptr;
+	}
+	JPH::Ref<JPH::RagdollSettings> settings = result.Get();
+	settings->CalculateBodyIndexToConstraintIndex();
+	return settings;
+}
+
+static void save_ragdoll_settings(const std::string &path, uint64_t skeleton_hash, const JPH::RagdollSettings &settings)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		engine::error("Failed to write ragdoll settings to \"%s\"", path.c_str());
+		return;
+	}
+	const RagdollCacheHeader header = {RAGDOLL_CACHE_MAGIC, RAGDOLL_CACHE_VERSION, skeleton_hash};
+	file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	JPH::StreamOutWrapper stream(file);
+	settings.SaveBinaryState(stream, true, true);
+}
+
+static std::unordered_map<uint64_t, JPH::Ref<JPH::RagdollSettings>> ragdollSettingsCache;
+
+void clear_ragdoll_settings_cache()
+{
+	ragdollSettingsCache.clear();
+}
+
+JPH::Ref<JPH::RagdollSettings> get_ragdoll_settings(const SkeletonPtr &skeleton, const std::string &cache_path)
+{
+	std::unordered_map<uint64_t, JPH::Ref<JPH::RagdollSettings>> &cache = ragdollSettingsCache;
+	const uint64_t skeletonHash = hash_skeleton(*skeleton);
+	auto it = cache.find(skeletonHash);
+	if (it != cache.end())
+		return it->second;
+
+	Timer timer;
+	JPH::Ref<JPH::RagdollSettings> settings = load_ragdoll_settings(cache_path, &skeletonHash);
+	if (settings)
+	{
+		engine::log("Ragdoll settings loaded from \"%s\" in %.2f ms", cache_path.c_str(), timer.elapsed_ms());
+	}
+	else
+	{
+		settings = create_ragdoll_settings(skeleton);
+		save_ragdoll_settings(cache_path, skeletonHash, *settings);
+		engine::log("Ragdoll settings built in %.2f ms, saved to \"%s\"", timer.elapsed_ms(), cache_path.c_str());
+	}
+	cache.emplace(skeletonHash, settings);
+	return settings;
+}
+
+JPH::Ref<JPH::RagdollSettings> load_cached_ragdoll_settings(const std::string &path)
+{
+	JPH::Ref<JPH::RagdollSettings> settings = load_ragdoll_settings(path, nullptr);
+	if (!settings)
+		engine::error("No ragdoll settings in \"%s\", the application writes them on the first run", path.c_str());
+	return settings;
+}
@@ -0,0 +1,122 @@
+#include "ragdoll_manager.h"
+#include "physics_world.h"
+#include "character.h"
+#include <Jolt/Physics/Collision/CollisionCollectorImpl.h>
+#include <Jolt/Physics/Collision/BroadPhase/BroadPhaseQuery.h>
+#include <Jolt/Physics/Collision/BroadPhase/BroadPhaseLayer.h>
+#include <Jolt/Physics/Collision/ObjectLayer.h>
+#include <algorithm>
+
+RagdollManager::Pool &RagdollManager::get_pool(const JPH::RagdollSettings *settings)
+{
+  auto it = std::find_if(pools.begin(), pools.end(), [&](const Pool &pool) { return pool.settings == settings; });
+  if (it != pools.end())
+    return *it;
+  return pools.emplace_back(Pool{settings, {}});
+}
+
+void RagdollManager::prewarm(const JPH::Ref<JPH::RagdollSettings> &settings, int count)
+{
+  Pool &pool = get_pool(settings.GetPtr());
+  for (int i = 0; i < count; i++)
+    pool.ragdolls.push_back(world.create_ragdoll(settings));
+}
+
+JPH::Ref<JPH::Ragdoll> RagdollManager::acquire(const JPH::Ref<JPH::RagdollSettings> &settings, const JPH::Mat44 *pose)
+{
+  Pool &pool = get_pool(settings.GetPtr());
+  JPH::Ref<JPH::Ragdoll> ragdoll;
+  if (pool.ragdolls.empty())
+  {
+    ragdoll = world.create_ragdoll(settings);
+  }
+  else
+  {
+    ragdoll = pool.ragdolls.back();
+    pool.ragdolls.pop_back();
+  }
+  // bodies aren't in the broad phase yet, nothing to lock
+  ragdoll->SetPose(JPH::RVec3::sZero(), pose, false);
+  ragdoll->SetLinearAndAngularVelocity(JPH::Vec3::sZero(), JPH::Vec3::sZero(), false);
+  ragdoll->AddToPhysicsSystem(JPH::EActivation::Activate);
+  activeCount++;
+  return ragdoll;
+}
+
+void RagdollManager::release(JPH::Ref<JPH::Ragdoll> &ragdoll)
+{
+  if (!ragdoll)
+    return;
+  ragdoll->RemoveFromPhysicsSystem();
+  get_pool(ragdoll->GetRagdollSettings()).ragdolls.push_back(ragdoll);
+  ragdoll = nullptr;
+  activeCount--;
+}
+
+int RagdollManager::get_pooled_count() const
+{
+  int count = 0;
+  for (const Pool &pool : pools)
+    count += pool.ragdolls.size();
+  return count;
+}
+
+bool RagdollManager::has_moving_bodies_nearby(const Character &character) const
+{
+  const JPH::PhysicsSystem &physicsSystem = world.mPhysicsSystem;
+  const glm::vec3 position = character.transform[3];
+  // roughly the space of a standing character
+  const JPH::AABox box(
+    JPH::Vec3(position.x - policy.proximityRadius, position.y, position.z - policy.proximityRadius),
+    JPH::Vec3(position.x + policy.proximityRadius, position.y + 2.f, position.z + policy.proximityRadius));
+  JPH::AllHitCollisionCollector<JPH::CollideShapeBodyCollector> collector;
+  physicsSystem.GetBroadPhaseQuery().CollideAABox(box, collector,
+    JPH::SpecifiedBroadPhaseLayerFilter(BroadPhaseLayers::Moving), JPH::SpecifiedObjectLayerFilter(ObjectLayers::Moving));
+  // sleeping props next to the character don't need a ragdoll
+  const JPH::BodyInterface &bodyInterface = physicsSystem.GetBodyInterface();
+  for (const JPH::BodyID &id : collector.mHits)
+    if (bodyInterface.IsActive(id))
+      return true;
+  return false;
+}
+
+bool RagdollManager::update_state(Character &character, float dt) const
+{
+  if (!character.ragdollSettings)
+    return false;
+
+  if (character.ragdollHit)
+  {
+    character.ragdollHit = false;
+    character.ragdollState = RagdollState::Falling;
+    character.ragdollTimer = 0.f;
+  }
+  character.ragdollTimer += dt;
+
+  switch (character.ragdollState)
+  {
+  case RagdollState::Animated:
+  case RagdollState::Driven:
+    if (character.ragdollKept || character.ragdollDragged || has_moving_bodies_nearby(character))
+    {
+      character.ragdollState = RagdollState::Driven;
+      character.ragdollTimer = 0.f;
+    }
+    else if (character.ragdollState == RagdollState::Driven && character.ragdollTimer >= policy.releaseDelay)
+    {
+      character.ragdollState = RagdollState::Animated;
+    }
+    break;
+  case RagdollState::Falling:
+  {
+    const bool asleep = character.ragdoll && !character.ragdoll->IsActive();
+    if ((character.ragdollTimer >= policy.hitDuration && asleep) || character.ragdollTimer >= policy.maxFallDuration)
+    {
+      character.ragdollState = RagdollState::Animated;
+      character.ragdollTimer = 0.f;
+    }
+    break;
+  }
+  }
+  return character.ragdollState != RagdollState::Animated;
+}
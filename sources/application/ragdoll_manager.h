@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Jolt/Jolt.h>
+#include <Jolt/Physics/Ragdoll/Ragdoll.h>
+#include <vector>
+
+struct PhysicsWorld;
+struct Character;
+
+enum class RagdollState
+{
+  Animated, // no ragdoll, pure animation
+  Driven,   // ragdoll follows the animation kinematically and pushes or gets pushed by nearby bodies
+  Falling   // ragdoll simulates freely after a hit, sleeps when it comes to rest
+};
+
+struct RagdollPolicy
+{
+  float proximityRadius = 1.0f; // active moving bodies closer than this attach a ragdoll
+  float releaseDelay = 1.0f;    // seconds without interaction before a driven ragdoll returns to the pool
+  float hitDuration = 3.0f;     // seconds a hit ragdoll falls before it may return to the pool
+  float maxFallDuration = 6.0f; // returned even if it didn't fall asleep
+};
+
+// Keeps ragdolls removed from the physics system until a character interacts with physics,
+// so animated characters cost nothing in the simulation.
+class RagdollManager
+{
+  struct Pool
+  {
+    JPH::RefConst<JPH::RagdollSettings> settings;
+    std::vector<JPH::Ref<JPH::Ragdoll>> ragdolls;
+  };
+
+  PhysicsWorld &world;
+  std::vector<Pool> pools; // one per ragdoll settings
+  int activeCount = 0;
+
+  Pool &get_pool(const JPH::RagdollSettings *settings);
+  bool has_moving_bodies_nearby(const Character &character) const;
+
+public:
+  RagdollPolicy policy;
+
+  explicit RagdollManager(PhysicsWorld &world) : world(world) {}
+
+  // creates ragdolls ahead of time, so attaching one later doesn't allocate
+  void prewarm(const JPH::Ref<JPH::RagdollSettings> &settings, int count);
+
+  // pooled ragdoll moved to pose (joint world matrices) and added to the physics system
+  JPH::Ref<JPH::Ragdoll> acquire(const JPH::Ref<JPH::RagdollSettings> &settings, const JPH::Mat44 *pose);
+
+  // removes the ragdoll from the physics system and returns it to the pool
+  void release(JPH::Ref<JPH::Ragdoll> &ragdoll);
+
+  // advances Character::ragdollState, returns true if the character needs a ragdoll this tick
+  bool update_state(Character &character, float dt) const;
+
+  int get_active_count() const { return activeCount; }
+  int get_pooled_count() const;
+};
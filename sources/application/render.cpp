@@ -1,8 +1,27 @@
 
 #include "scene.h"
+#include "engine/profiler.h"
+#include "engine/api.h"
 
-void render_character(const Character &character, const mat4 &cameraProjView, vec3 cameraPosition, const DirectionLight &light)
+static int select_lod(const Mesh &mesh, float screen_size, const LodSettings &lod_settings)
 {
+  if (lod_settings.forcedLod >= 0)
+    return lod_settings.forcedLod;
+  // lod errors are relative to the mesh radius, the character bounds radius overestimates them for smaller meshes
+  const float pixelsPerRadius = screen_size * engine::get_screen_size().second * 0.5f;
+  int lod = 0;
+  for (int i = 1; i < int(mesh.lods.size()); i++)
+    if (mesh.lods[i].error * pixelsPerRadius <= lod_settings.pixelError)
+      lod = i;
+  return lod;
+}
+
+// returns the number of drawn triangles
+int render_character(const CharacterSnapshot &snapshot, const mat4 &cameraProjView, vec3 cameraPosition, const DirectionLight &light,
+  const LodSettings &lod_settings)
+{
+  PROFILE_ZONE("render character");
+  const Character &character = *snapshot.character;
   const Material &material = *character.material;
   const Shader &shader = material.get_shader();
 
@@ -15,38 +34,22 @@ void render_character(const Character &character, const mat4 &cameraProjView, ve
   shader.set_vec3("AmbientLight", light.ambient);
   shader.set_vec3("SunLight", light.lightColor);
 
-  std::span<const mat4> bindPose = {
-    (const glm::mat4 *)character.animationContext.worldTransforms.data(),
-    character.animationContext.worldTransforms.size()
-  };
-  std::vector<mat4> skinningMatrixes;
-  skinningMatrixes.reserve(bindPose.size());
-
-
-  for (const MeshPtr &mesh : character.meshes)
+  int triangles = 0;
+  for (size_t i = 0; i < character.meshes.size(); i++)
   {
-    skinningMatrixes.resize(mesh->inverseBindPose.size());
-    for (size_t i = 0; i < mesh->inverseBindPose.size(); i++)
-    {
-      auto it = character.skeletonInfo.nodesMap.find(mesh->bonesNames[i]);
-      if (it == character.skeletonInfo.nodesMap.end())
-      {
-        const std::string &name = mesh->bonesNames[i];
-        engine::error("Bone \"%s\" from Mesh \"%s\" not found in skeleton", mesh->name.c_str(), name.c_str());
-        skinningMatrixes[i] = glm::identity<glm::mat4>();
-      }
-      else
-      {
-        int nodeInSkeletonIdx = it->second;
-        skinningMatrixes[i] = bindPose[nodeInSkeletonIdx] * mesh->inverseBindPose[i];
-      }
-    }
-    shader.set_mat4x4("SkinningMatrixes", skinningMatrixes.data(), skinningMatrixes.size());
-    render(mesh);
+    const std::vector<mat4> &palette = snapshot.palettes[i];
+    if (palette.empty())
+      continue;
+    shader.set_mat4x4("SkinningMatrixes", palette.data(), palette.size());
+    const MeshPtr &mesh = character.meshes[i];
+    const int lod = select_lod(*mesh, snapshot.screenSize, lod_settings);
+    render(mesh, lod);
+    triangles += (mesh->lods.empty() ? mesh->numIndices : mesh->lods[std::min(lod, int(mesh->lods.size()) - 1)].numIndices) / 3;
   }
+  return triangles;
 }
 
-void application_render(Scene &scene)
+void application_render(const Scene &scene, const FrameSnapshot &snapshot)
 {
   glEnable(GL_DEPTH_TEST);
   glDisable(GL_BLEND);
@@ -55,10 +58,14 @@ void application_render(Scene &scene)
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 
-  const mat4 &projection = scene.userCamera.projection;
-  const glm::mat4 &transform = scene.userCamera.transform;
+  const mat4 &projection = snapshot.projection;
+  const glm::mat4 &transform = snapshot.cameraTransform;
   mat4 projView = projection * inverse(transform);
 
-  for (const Character &character : scene.characters)
-    render_character(character, projView, glm::vec3(transform[3]), scene.light);
+  PROFILE_GPU_ZONE("characters");
+  int triangles = 0;
+  for (const CharacterSnapshot &character : snapshot.characters)
+    if (character.visible)
+      triangles += render_character(character, projView, glm::vec3(transform[3]), scene.light, scene.lod);
+  engine::profile_counter("character triangles", triangles);
 }
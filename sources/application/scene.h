@@ -6,6 +6,9 @@
 #include "character.h"
 #include "physics_world.h"
 #include "motion_matching/feature_data_base.h"
+#include "simulation.h"
+#include "frame_pipeline.h"
+#include <mutex>
 
 struct Scene
 {
@@ -19,8 +22,27 @@ struct Scene
   std::vector<Character> characters;
 
   std::unique_ptr<PhysicsWorld> physicsWorld;
+  // cooked static collision files, added to every created physics world
+  std::vector<std::string> staticCollisionPaths;
+  GroundQueries groundQueries;
+
+  CullingSettings culling;
+  LodSettings lod;
+
+  FrameMode frameMode = FrameMode::Serial;
+  SimulationThread simulationThread;
+  FramePipeline framePipeline;
+  // held by a simulation tick and by main thread code which touches simulated state (update, ui)
+  std::mutex simulationMutex;
+  // guards Character::publishedPoses and publishedTickTime
+  std::mutex publishMutex;
+  double publishedTickTime = 0.0;
+  float simulationAccumulator = 0.f;
+
   ~Scene()
   {
+    simulationThread.stop();
+    framePipeline.flush();
     characters.clear();
     physicsWorld.reset();
     destroy_phys_globals();
@@ -0,0 +1,120 @@
+#include "simulation.h"
+#include "scene.h"
+#include "engine/profiler.h"
+#include <chrono>
+
+void application_simulate(Scene &scene, float dt, const mat4 &projection_view);
+
+double get_simulation_clock()
+{
+  using namespace std::chrono;
+  static const steady_clock::time_point start = steady_clock::now();
+  return duration<double>(steady_clock::now() - start).count();
+}
+
+void advance_simulation(Scene &scene, float dt, const mat4 &projection_view)
+{
+  scene.simulationAccumulator += dt;
+  int ticks = 0;
+  while (scene.simulationAccumulator >= SIMULATION_TICK)
+  {
+    // a long frame drops simulation time instead of stalling the next frames
+    if (ticks++ == MAX_TICKS_PER_FRAME)
+    {
+      scene.simulationAccumulator = 0.f;
+      break;
+    }
+    scene.simulationAccumulator -= SIMULATION_TICK;
+    application_simulate(scene, SIMULATION_TICK, projection_view);
+    publish_poses(scene, get_simulation_clock() - scene.simulationAccumulator);
+  }
+}
+
+void publish_poses(Scene &scene, double tick_time)
+{
+  std::unique_lock lock(scene.publishMutex);
+  for (Character &character : scene.characters)
+  {
+    std::vector<mat4> &previous = character.publishedPoses[0];
+    std::vector<mat4> &current = character.publishedPoses[1];
+    std::swap(previous, current);
+    const auto &worldTransforms = character.animationContext.worldTransforms;
+    const mat4 *pose = reinterpret_cast<const mat4 *>(worldTransforms.data());
+    current.assign(pose, pose + worldTransforms.size());
+    if (previous.size() != current.size())
+      previous = current;
+    character.publishedBounds[0] = character.publishedBounds[1];
+    character.publishedBounds[1] = character.worldBounds;
+  }
+  scene.publishedTickTime = tick_time;
+}
+
+static mat4 interpolate_transform(const mat4 &from, const mat4 &to, float t)
+{
+  const vec3 fromScale(length(vec3(from[0])), length(vec3(from[1])), length(vec3(from[2])));
+  const vec3 toScale(length(vec3(to[0])), length(vec3(to[1])), length(vec3(to[2])));
+  const quat fromRotation = quat_cast(mat3(vec3(from[0]) / fromScale.x, vec3(from[1]) / fromScale.y, vec3(from[2]) / fromScale.z));
+  const quat toRotation = quat_cast(mat3(vec3(to[0]) / toScale.x, vec3(to[1]) / toScale.y, vec3(to[2]) / toScale.z));
+
+  mat4 result = mat4_cast(slerp(fromRotation, toRotation, t));
+  const vec3 scale = mix(fromScale, toScale, t);
+  result[0] *= scale.x;
+  result[1] *= scale.y;
+  result[2] *= scale.z;
+  result[3] = mix(from[3], to[3], t);
+  return result;
+}
+
+void interpolate_poses(Scene &scene)
+{
+  PROFILE_ZONE("interpolate poses");
+  std::unique_lock lock(scene.publishMutex);
+  const float alpha = glm::clamp(float(get_simulation_clock() - scene.publishedTickTime) / SIMULATION_TICK, 0.f, 1.f);
+  for (Character &character : scene.characters)
+  {
+    const std::vector<mat4> &previous = character.publishedPoses[0];
+    const std::vector<mat4> &current = character.publishedPoses[1];
+    character.renderPose.resize(current.size());
+    for (size_t i = 0; i < current.size(); i++)
+      character.renderPose[i] = interpolate_transform(previous[i], current[i], alpha);
+    character.renderBounds = character.publishedBounds[0];
+    character.renderBounds.add(character.publishedBounds[1]);
+  }
+}
+
+void SimulationThread::start(Scene &scene)
+{
+  if (running)
+    return;
+  running = true;
+  thread = std::thread([this, &scene]()
+  {
+    using clock = std::chrono::steady_clock;
+    engine::set_profiler_thread_name("Simulation");
+    const auto tick = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(SIMULATION_TICK));
+    clock::time_point nextTick = clock::now();
+    while (running)
+    {
+      {
+        PROFILE_ZONE("simulation tick");
+        std::unique_lock lock(scene.simulationMutex);
+        // the main thread moves the camera under the same lock
+        const mat4 projectionView = scene.userCamera.projection * inverse(scene.userCamera.transform);
+        application_simulate(scene, SIMULATION_TICK, projectionView);
+        publish_poses(scene, get_simulation_clock());
+      }
+      nextTick += tick;
+      // after a stall skip the missed ticks instead of running them back to back
+      if (clock::now() - nextTick > MAX_TICKS_PER_FRAME * tick)
+        nextTick = clock::now();
+      std::this_thread::sleep_until(nextTick);
+    }
+  });
+}
+
+void SimulationThread::stop()
+{
+  running = false;
+  if (thread.joinable())
+    thread.join();
+}
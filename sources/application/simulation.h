@@ -0,0 +1,42 @@
+#pragma once
+#include "engine/3dmath.h"
+#include <atomic>
+#include <thread>
+
+struct Scene;
+
+enum class FrameMode
+{
+  Serial,          // simulation ticks run on the main thread before render
+  SimulationThread, // simulation ticks run on their own thread at a fixed rate
+  Pipelined         // frame update runs on the job system while the previous frame renders
+};
+
+// controllers, sampling and physics always advance by this step
+constexpr float SIMULATION_TICK = 1.f / 60.f;
+constexpr int MAX_TICKS_PER_FRAME = 5;
+
+// seconds of a steady clock shared by the simulation and render
+double get_simulation_clock();
+
+// runs the whole ticks accumulated from dt on the calling thread, characters are culled by projection_view
+// of the camera the frame renders with, not by the user camera which the main thread may be moving
+void advance_simulation(Scene &scene, float dt, const mat4 &projection_view);
+
+// copies simulated poses for render, tick_time is the clock time the tick corresponds to
+void publish_poses(Scene &scene, double tick_time);
+
+// fills Character::renderPose, render is one tick behind the last published pose
+void interpolate_poses(Scene &scene);
+
+class SimulationThread
+{
+  std::thread thread;
+  std::atomic<bool> running = false;
+
+public:
+  void start(Scene &scene);
+  void stop();
+  bool is_running() const { return running; }
+  ~SimulationThread() { stop(); }
+};
@@ -0,0 +1,67 @@
+#include "static_collision.h"
+#include "physics_world.h"
+#include "engine/api.h"
+#include "import/model.h"
+#include "import/timer.h"
+#include <Jolt/Core/StreamWrapper.h>
+#include <Jolt/Physics/Collision/Shape/MeshShape.h>
+#include <filesystem>
+#include <fstream>
+
+std::string get_static_collision_path(const std::string &model_path)
+{
+	return std::filesystem::path(model_path).replace_extension(".collision").string();
+}
+
+bool cook_static_collision(const std::string &model_path, const std::string &output_path)
+{
+	Timer timer;
+	std::vector<CollisionGeometry> geometry = load_collision_geometry(model_path.c_str());
+
+	std::vector<JPH::Ref<JPH::Shape>> shapes;
+	for (const CollisionGeometry &mesh : geometry)
+	{
+		JPH::VertexList vertices;
+		vertices.reserve(mesh.vertices.size());
+		for (const vec3 &v : mesh.vertices)
+			vertices.push_back(JPH::Float3(v.x, v.y, v.z));
+		JPH::IndexedTriangleList triangles;
+		triangles.reserve(mesh.indices.size() / 3);
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+			triangles.push_back(JPH::IndexedTriangle(mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2]));
+		if (triangles.empty())
+			continue;
+
+		// the constructor drops degenerate and duplicate triangles
+		JPH::MeshShapeSettings settings(std::move(vertices), std::move(triangles));
+		JPH::ShapeSettings::ShapeResult result = settings.Create();
+		if (result.HasError())
+		{
+			engine::error("Failed to build collision of mesh \"%s\": %s", mesh.name.c_str(), result.GetError().c_str());
+			continue;
+		}
+		shapes.push_back(result.Get());
+	}
+
+	std::ofstream file(output_path, std::ios::binary);
+	if (!file)
+	{
+		engine::error("Failed to write static collision to \"%s\"", output_path.c_str());
+		return false;
+	}
+	const StaticCollisionHeader header = {STATIC_COLLISION_MAGIC, STATIC_COLLISION_VERSION, uint32_t(shapes.size())};
+	file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	JPH::StreamOutWrapper stream(file);
+	JPH::Shape::ShapeToIDMap shapeMap;
+	JPH::Shape::MaterialToIDMap materialMap;
+	for (const JPH::Ref<JPH::Shape> &shape : shapes)
+		shape->SaveWithChildren(stream, shapeMap, materialMap);
+	if (stream.IsFailed())
+	{
+		engine::error("Failed to write static collision to \"%s\"", output_path.c_str());
+		return false;
+	}
+	engine::log("Static collision of \"%s\" cooked to \"%s\", %zu shapes. %f ms",
+		model_path.c_str(), output_path.c_str(), shapes.size(), timer.elapsed_ms());
+	return true;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// cooked static collision: header, then every MeshShape saved with SaveWithChildren,
+// sub shapes and materials shared between meshes are stored once
+struct StaticCollisionHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t shapeCount;
+};
+
+// bump when the cooked layout or the shape building changes, files of older versions are rejected
+constexpr uint32_t STATIC_COLLISION_VERSION = 1;
+constexpr uint32_t STATIC_COLLISION_MAGIC = 0x4C4C4F43; // "COLL"
+
+// "resources/level.fbx" -> "resources/level.collision"
+std::string get_static_collision_path(const std::string &model_path);
+
+// offline step, builds MeshShapes from all meshes of the model, it's slow, never called at scene start
+bool cook_static_collision(const std::string &model_path, const std::string &output_path);
@@ -1,8 +1,13 @@
 #include "imgui/imgui.h"
 #include "imgui/ImGuizmo.h"
+#include <algorithm>
 #include <filesystem>
+#include <future>
 
 #include "scene.h"
+#include "static_collision.h"
+#include "engine/api.h"
+#include "engine/memory.h"
 
 static ImGuizmo::OPERATION mCurrentGizmoOperation(ImGuizmo::TRANSLATE);
 static ImGuizmo::MODE mCurrentGizmoMode(ImGuizmo::WORLD);
@@ -17,13 +22,37 @@ static ImVec2 to_imvec2(const glm::vec2 &v)
 {
   return ImVec2(v.x, v.y);
 }
-static void show_info()
+static void show_info(Scene &scene, const SceneUiState &state)
 {
   if (ImGui::Begin("Info"))
   {
     ImGui::Text("ESC - exit");
     ImGui::Text("F5 - recompile shaders");
     ImGui::Text("Left Mouse Button and Wheel - controll camera");
+
+    const char *frameModes[] = {
+      "Serial",
+      "Simulation thread",
+      "Pipelined",
+    };
+    int frameMode = (int)scene.frameMode;
+    if (ImGui::Combo("Frame mode", &frameMode, frameModes, IM_ARRAYSIZE(frameModes)))
+      scene.frameMode = (FrameMode)frameMode;
+    if (scene.frameMode == FrameMode::Pipelined)
+      ImGui::SliderInt("Pipeline depth", &scene.framePipeline.depth, 1, MAX_PIPELINE_DEPTH);
+    ImGui::Text("Simulation tick %.1f ms", SIMULATION_TICK * 1000.f);
+
+    CullingSettings culling = state.culling;
+    bool cullingChanged = ImGui::Checkbox("Frustum culling", &culling.enabled);
+    cullingChanged |= ImGui::SliderInt("Culled update interval", &culling.culledUpdateInterval, 1, 16);
+    if (cullingChanged)
+      edit_scene(scene, [culling](Scene &scene) { scene.culling = culling; });
+    int visibleCharacters = 0;
+    for (const CharacterUiState &character : state.characters)
+      visibleCharacters += character.visible;
+    ImGui::Text("Visible characters %d/%zu", visibleCharacters, state.characters.size());
+    ImGui::SliderFloat("LOD pixel error", &scene.lod.pixelError, 0.1f, 10.f);
+    ImGui::SliderInt("Forced LOD (-1 - auto)", &scene.lod.forcedLod, -1, 3);
   }
   ImGui::End();
 }
@@ -37,7 +66,8 @@ static glm::vec2 world_to_screen(const UserCamera &camera, glm::vec3 world_posit
   return glm::vec2(screen.x * io.DisplaySize.x, io.DisplaySize.y - screen.y * io.DisplaySize.y);
 }
 
-static void manipulate_transform(glm::mat4 &transform, const UserCamera &camera)
+// true if the gizmo moved the transform
+static bool manipulate_transform(glm::mat4 &transform, const UserCamera &camera)
 {
   ImGuizmo::BeginFrame();
   const glm::mat4 &projection = camera.projection;
@@ -50,75 +80,91 @@ static void manipulate_transform(glm::mat4 &transform, const UserCamera &camera)
   ImGuizmo::Manipulate(glm::value_ptr(cameraView), glm::value_ptr(projection), mCurrentGizmoOperation, mCurrentGizmoMode,
                        glm::value_ptr(globNodeTm));
 
+  const bool changed = globNodeTm != transform;
   transform = globNodeTm;
+  return changed;
 }
 
-static void show_characters(Scene &scene)
+static void show_characters(Scene &scene, const SceneUiState &state)
 {
   // implement showing characters when only one character can be selected
   static uint32_t selectedCharacter = -1u;
   static uint32_t selectedNode = -1u;
   static uint32_t selectedAnimation = -1u;
-  static bool dragRagdoll = false;
   if (ImGui::Begin("Scene"))
   {
-    for (size_t i = 0; i < scene.characters.size(); i++)
+    for (size_t i = 0; i < state.characters.size(); i++)
     {
-      Character &character = scene.characters[i];
+      const CharacterUiState &characterState = state.characters[i];
       ImGui::PushID(i);
-      if (ImGui::Selectable(character.name.c_str(), selectedCharacter == i, ImGuiSelectableFlags_AllowDoubleClick))
+      if (ImGui::Selectable(characterState.name.c_str(), selectedCharacter == i, ImGuiSelectableFlags_AllowDoubleClick))
       {
         selectedCharacter = i;
         if (ImGui::IsMouseDoubleClicked(0))
         {
-          scene.userCamera.arcballCamera.targetPosition = vec3(character.transform[3]) + vec3(0, 1, 0);
+          scene.userCamera.arcballCamera.targetPosition = vec3(characterState.transform[3]) + vec3(0, 1, 0);
         }
       }
 
       if (selectedCharacter == i)
       {
-        if (ImGui::SliderFloat("linearVelocity", &character.linearVelocity, 0.f, 3.f))
-        {
-          // update the parameter of the BlendSpace1D controller
-        }
+        float linearVelocity = characterState.linearVelocity;
+        if (ImGui::SliderFloat("linearVelocity", &linearVelocity, 0.f, 3.f))
+          edit_scene(scene, [i, linearVelocity](Scene &scene) { scene.characters[i].linearVelocity = linearVelocity; });
+        float movementDirection = characterState.movementDirection;
+        if (ImGui::SliderFloat("movementDirection", &movementDirection, -180.f, 180.f))
+          edit_scene(scene, [i, movementDirection](Scene &scene) { scene.characters[i].movementDirection = movementDirection; });
         const char *animationState[] = {
           "Idle",
           "Walk",
         };
-        int currentState = (int)character.state;
+        int currentState = (int)characterState.state;
 
         if (ImGui::ListBox("AnimationState", &currentState, animationState, IM_ARRAYSIZE(animationState)))
         {
-          character.state = (AnimationState)currentState;
-          // set the state of the AnimationGraph controller
+          // the AnimationGraph controller takes the state on the next update
+          edit_scene(scene, [i, currentState](Scene &scene) { scene.characters[i].state = (AnimationState)currentState; });
         }
-        ImGui::Checkbox("DragRagdoll", &dragRagdoll);
+        if (characterState.hasAnimationGraph)
+        {
+          bool inertialization = characterState.inertialization;
+          if (ImGui::Checkbox("Inertialization", &inertialization))
+          {
+            const TransitionMode mode = inertialization ? TransitionMode::Inertialization : TransitionMode::CrossFade;
+            edit_scene(scene, [i, mode](Scene &scene)
+            {
+              for (const auto &controller : scene.characters[i].controllers)
+                if (AnimationGraph *graph = dynamic_cast<AnimationGraph *>(controller.get()))
+                  graph->set_transition_mode(mode);
+            });
+          }
+        }
+        bool ragdollDragged = characterState.ragdollDragged;
+        if (ImGui::Checkbox("DragRagdoll", &ragdollDragged))
+          edit_scene(scene, [i, ragdollDragged](Scene &scene) { scene.characters[i].ragdollDragged = ragdollDragged; });
 
 
         {
           for (size_t animationIdx = 0; animationIdx < scene.animationDataBase.animations.size(); animationIdx++)
           {
             const auto animName = scene.animationDataBase.animations[animationIdx]->name();
-            if (!std::string_view(animName).ends_with("_IPC"))
-              continue;
             if (ImGui::Selectable(animName, selectedAnimation == animationIdx))
             {
               selectedAnimation = animationIdx;
-              character.selectedAnimation = animationIdx;
+              edit_scene(scene, [i, animationIdx](Scene &scene) { scene.characters[i].selectedAnimation = animationIdx; });
             }
           }
         }
         const float INDENT = 15.0f;
         ImGui::Indent(INDENT);
-        ImGui::Text("Meshes: %zu", character.meshes.size());
+        ImGui::Text("Meshes: %zu", characterState.meshCount);
         // show skeleton
-        SkeletonInfo &skeletonInfo = character.skeletonInfo;
-        ImGui::Text("Skeleton Nodes: %zu", skeletonInfo.names.size());
-        for (size_t j = 0; j < skeletonInfo.names.size(); j++)
+        ImGui::Text("Skeleton Nodes: %zu", characterState.nodeNames.size());
+        for (size_t j = 0; j < characterState.nodeNames.size(); j++)
         {
           // show text with tabs for hierarchy
-          const std::string &name = skeletonInfo.names[j];
-          int depth = skeletonInfo.hierarchyDepth[j];
+          const std::string &name = characterState.nodeNames[j];
+          int depth = characterState.nodeDepths[j];
           std::string tabs(depth, ' ');
           std::string label = tabs + name;
           if (ImGui::Selectable(label.c_str(), selectedNode == j))
@@ -130,30 +176,40 @@ static void show_characters(Scene &scene)
       }
       ImGui::PopID();
     }
-    if (selectedCharacter < scene.characters.size())
+    if (selectedCharacter < state.characters.size())
     {
-      Character &character = scene.characters[selectedCharacter];
-      if (dragRagdoll)
+      const CharacterUiState &characterState = state.characters[selectedCharacter];
+      const uint32_t i = selectedCharacter;
+      if (characterState.ragdollDragged)
       {
-        manipulate_transform(character.ragdollTargetTransform, scene.userCamera);
+        glm::mat4 target = characterState.ragdollTargetTransform;
+        if (manipulate_transform(target, scene.userCamera))
+          edit_scene(scene, [i, target](Scene &scene) { scene.characters[i].ragdollTargetTransform = target; });
       }
-      else if (selectedNode < character.skeletonInfo.names.size())
+      else if (selectedNode < characterState.pose.size())
       {
-        glm::mat4 &worldTransform = reinterpret_cast<glm::mat4 &>(character.animationContext.worldTransforms[selectedNode]);
-        glm::mat4 transform = character.transform * worldTransform;
-        manipulate_transform(transform, scene.userCamera);
-        worldTransform = inverse(character.transform) * transform;
+        // moves the joint of the last tick, the next animation update overrides it
+        glm::mat4 transform = characterState.transform * characterState.pose[selectedNode];
+        if (manipulate_transform(transform, scene.userCamera))
+        {
+          const glm::mat4 worldTransform = inverse(characterState.transform) * transform;
+          const uint32_t node = selectedNode;
+          edit_scene(scene, [i, node, worldTransform](Scene &scene)
+          { reinterpret_cast<glm::mat4 &>(scene.characters[i].animationContext.worldTransforms[node]) = worldTransform; });
+        }
       }
       else
       {
-        manipulate_transform(character.transform, scene.userCamera);
+        glm::mat4 transform = characterState.transform;
+        if (manipulate_transform(transform, scene.userCamera))
+          edit_scene(scene, [i, transform](Scene &scene) { scene.characters[i].transform = transform; });
       }
     }
   }
   ImGui::End();
-  if (selectedCharacter < scene.characters.size())
+  if (selectedCharacter < state.characters.size())
   {
-    Character &character = scene.characters[selectedCharacter];
+    const CharacterUiState &characterState = state.characters[selectedCharacter];
 
     {
       const ImU32 flags = ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoInputs | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoBringToFrontOnFocus;
@@ -172,13 +228,13 @@ static void show_characters(Scene &scene)
       ImDrawList* drawList = ImGui::GetWindowDrawList();
       // nice golden semi-transparent color
       const auto color = IM_COL32(255, 215, 0, 128);
-      for (size_t j = 0; j < character.skeletonInfo.names.size(); j++)
+      for (size_t j = 0; j < characterState.pose.size(); j++)
       {
-        const glm::mat4 &transform = reinterpret_cast<const glm::mat4 &>(character.animationContext.worldTransforms[j]);
-        int parent = character.skeletonInfo.parents[j];
+        const glm::mat4 &transform = characterState.pose[j];
+        int parent = characterState.nodeParents[j];
         if (parent > 0)
         {
-          const glm::mat4 &parentTransform = reinterpret_cast<const glm::mat4 &>(character.animationContext.worldTransforms[parent]);
+          const glm::mat4 &parentTransform = characterState.pose[parent];
           const glm::vec3 &from = glm::vec3(parentTransform[3]);
           const glm::vec3 &to = glm::vec3(transform[3]);
           const glm::vec2 fromScreen = world_to_screen(scene.userCamera, from);
@@ -189,19 +245,17 @@ static void show_characters(Scene &scene)
 
       const float FPS = 30.f;
       const float velocityMultiplier = 0.1f;
-      for (const auto &controller : character.controllers)
+      // the SingleAnimation controller plays the selected clip
       {
-        if (const SingleAnimation *singleAnimation = dynamic_cast<SingleAnimation *>(controller.get()))
+        if (characterState.animationTime >= 0.f && characterState.selectedAnimation >= 0)
         {
-          if (character.selectedAnimation == -1u)
-            continue;
-          int currentFrameIdx = static_cast<int>(singleAnimation->animation->duration() * FPS * singleAnimation->progress);
-          const auto &clip = scene.featureDataBase.clips[character.selectedAnimation];
+          int currentFrameIdx = static_cast<int>(characterState.animationTime * FPS);
+          const auto &clip = scene.featureDataBase.clips[characterState.selectedAnimation];
           if (currentFrameIdx >= clip.features.size())
             currentFrameIdx = clip.features.size() - 1;
           const FrameFeature &feature = clip.features[currentFrameIdx];
           // drawList->AddCircle
-          const glm::mat4 &transform = character.transform;
+          const glm::mat4 &transform = characterState.transform;
           glm::vec4 leftFootPosition = transform * to_vec4(feature.leftFootPosition, 1.f);
           glm::vec4 rightFootPosition = transform * to_vec4(feature.rightFootPosition, 1.f);
           glm::vec4 leftFootVelocity = transform * to_vec4(feature.leftFootVelocity, 0.f);
@@ -261,11 +315,8 @@ static void show_models(Scene &scene)
   {
     if (ImGui::Button("Build Animations"))
     {
+      // in place clips are produced from root motion ones by extracting the root trajectory
       std::vector<std::string> paths;
-      for (auto it : std::filesystem::directory_iterator("resources/Animations/IPC"))
-      {
-        paths.push_back(it.path().string());
-      }
       for (auto it : std::filesystem::directory_iterator("resources/Animations/Root_Motion"))
       {
         paths.push_back(it.path().string());
@@ -274,6 +325,20 @@ static void show_models(Scene &scene)
       build_animations(paths, output_path);
 
     }
+    ImGui::SameLine();
+    if (ImGui::Button("Compression Report"))
+    {
+      std::vector<std::string> paths;
+      for (auto it : std::filesystem::directory_iterator("resources/Animations/Root_Motion"))
+      {
+        paths.push_back(it.path().string());
+      }
+      const AnimationCompressionProfile profile = default_compression_profile();
+      std::vector<AnimationCompressionProfile> profiles = {AnimationCompressionProfile()};
+      for (float scale : {0.25f, 0.5f, 1.f, 2.f, 4.f})
+        profiles.push_back(profile.scaled(scale));
+      build_compression_report(paths, profiles, "resources/Animations/compression_report.md");
+    }
 
     static uint32_t selectedModel = -1u;
     for (size_t i = 0; i < scene.models.size(); i++)
@@ -289,6 +354,20 @@ static void show_models(Scene &scene)
         ImGui::Indent(15.0f);
         ImGui::Text("Path: %s", model.path.c_str());
         ImGui::Text("Meshes: %zu", model.meshes.size());
+        if (ImGui::Button("Cook Static Collision"))
+        {
+          const std::string cookedPath = get_static_collision_path(model.path);
+          if (cook_static_collision(model.path, cookedPath))
+            edit_scene(scene, [cookedPath](Scene &scene)
+            {
+              std::vector<std::string> &paths = scene.staticCollisionPaths;
+              if (std::find(paths.begin(), paths.end(), cookedPath) != paths.end())
+                return;
+              paths.push_back(cookedPath);
+              if (scene.physicsWorld)
+                scene.physicsWorld->add_static_collision(cookedPath);
+            });
+        }
 
         for (size_t j = 0; j < model.meshes.size(); j++)
         {
@@ -327,75 +406,298 @@ static void show_models(Scene &scene)
   ImGui::End();
 }
 
-static void show_physics(Scene &scene)
+static void show_physics(Scene &scene, const SceneUiState &state)
 {
   if (ImGui::Begin("Phisics"))
   {
-    if (!scene.physicsWorld)
+    const PhysicsUiState &physics = state.physics;
+    if (!physics.created)
     {
+      static PhysicsWorldSettings settings;
+      const char *backends[] = {
+        get_physics_job_backend_name(PhysicsJobBackend::EnginePool),
+        get_physics_job_backend_name(PhysicsJobBackend::JoltThreadPool),
+        get_physics_job_backend_name(PhysicsJobBackend::SingleThreaded),
+      };
+      int backend = (int)settings.jobBackend;
+      if (ImGui::Combo("Job system", &backend, backends, IM_ARRAYSIZE(backends)))
+        settings.jobBackend = (PhysicsJobBackend)backend;
+      ImGui::SliderInt("Threads (0 - all)", &settings.threadCount, 0, (int)std::thread::hardware_concurrency());
       if (ImGui::Button("Create Physics World"))
       {
-        scene.physicsWorld = std::make_unique<PhysicsWorld>();
+        edit_scene(scene, [settings = settings](Scene &scene)
+        {
+          if (scene.physicsWorld)
+            return;
+          scene.physicsWorld = std::make_unique<PhysicsWorld>(settings);
+          for (const std::string &path : scene.staticCollisionPaths)
+            scene.physicsWorld->add_static_collision(path);
+        });
       }
     }
     else
     {
+      ImGui::Text("Step %.3f ms, %d threads", physics.stepMs, physics.threadCount);
+      ImGui::Text("Temp allocator %u KiB, high-water %u KiB, %u overflows",
+        physics.tempAllocatorCapacity / 1024, physics.tempAllocatorHighWater / 1024, physics.tempAllocatorOverflows);
+
       static bool drawPhysics = true;
       ImGui::Checkbox("Drag Debug Physics", &drawPhysics);
-      if (drawPhysics)
+      // draws the bodies directly, a pipelined update may be stepping them
+      if (drawPhysics && scene.framePipeline.is_active())
+        ImGui::Text("Debug physics isn't drawn in Pipelined mode");
+      else if (drawPhysics && scene.physicsWorld)
       {
         glm::mat4 worldToScreen = scene.userCamera.projection * inverse(scene.userCamera.transform);
         scene.physicsWorld->debug_render(worldToScreen, vec3(scene.userCamera.transform[3]));
       }
-      if (ImGui::Button("Create Ragdoll"))
+      ImGui::Text("Ground queries: %d rays, %.3f ms, %.0f rays/ms", physics.groundRayCount, physics.groundQueryMs,
+        physics.groundRayCount / std::max(physics.groundQueryMs, 0.001f));
+      float probes[3] = {physics.probeHeight, physics.footProbeDepth, physics.hipProbeDepth};
+      bool probesChanged = ImGui::SliderFloat("Probe height", &probes[0], 0.f, 2.f);
+      probesChanged |= ImGui::SliderFloat("Foot probe depth", &probes[1], 0.f, 2.f);
+      probesChanged |= ImGui::SliderFloat("Hip probe depth", &probes[2], 0.f, 3.f);
+      if (probesChanged)
+        edit_scene(scene, [probes](Scene &scene)
+        {
+          scene.groundQueries.probeHeight = probes[0];
+          scene.groundQueries.footProbeDepth = probes[1];
+          scene.groundQueries.hipProbeDepth = probes[2];
+        });
+      ImGui::Text("Ragdolls: %d active, %d pooled", physics.activeRagdolls, physics.pooledRagdolls);
+      if (ImGui::Button("Prewarm Ragdolls"))
       {
-        for (size_t i = 0; i < scene.characters.size(); i++)
+        edit_scene(scene, [](Scene &scene)
         {
-          Character &character = scene.characters[i];
-          if (!character.ragdollSettings)
-            continue;
-          if (character.ragdoll)
-          {
-            character.ragdoll->RemoveFromPhysicsSystem();
-            character.ragdoll = nullptr;
-          }
-          character.ragdoll = scene.physicsWorld->create_ragdoll(character.ragdollSettings);
-          character.ragdoll->AddToPhysicsSystem(JPH::EActivation::Activate);
-          // character.ragdoll->AddToPhysicsSystem(JPH::EActivation::DontActivate);
+          if (!scene.physicsWorld)
+            return;
+          for (const Character &character : scene.characters)
+            if (character.ragdollSettings)
+              scene.physicsWorld->mRagdollManager.prewarm(character.ragdollSettings, 4);
+          scene.physicsWorld->mPhysicsSystem.OptimizeBroadPhase();
+        });
+      }
+      RagdollPolicy policy = physics.ragdollPolicy;
+      bool policyChanged = ImGui::SliderFloat("Proximity radius", &policy.proximityRadius, 0.f, 5.f);
+      policyChanged |= ImGui::SliderFloat("Release delay", &policy.releaseDelay, 0.f, 5.f);
+      policyChanged |= ImGui::SliderFloat("Hit duration", &policy.hitDuration, 0.f, 10.f);
+      if (policyChanged)
+        edit_scene(scene, [policy](Scene &scene)
+        {
+          if (scene.physicsWorld)
+            scene.physicsWorld->mRagdollManager.policy = policy;
+        });
+
+      for (size_t i = 0; i < state.characters.size(); i++)
+      {
+        const CharacterUiState &characterState = state.characters[i];
+        if (!characterState.ragdollSettings)
+          continue;
+        const char *ragdollStates[] = {"Animated", "Driven", "Falling"};
+        ImGui::PushID(i);
+        ImGui::Text("%s: %s", characterState.name.c_str(), ragdollStates[(int)characterState.ragdollState]);
+        ImGui::SameLine();
+        if (ImGui::Button("Hit"))
+          edit_scene(scene, [i](Scene &scene) { scene.characters[i].ragdollHit = true; });
+        ImGui::SameLine();
+        bool ragdollKept = characterState.ragdollKept;
+        if (ImGui::Checkbox("Keep ragdoll", &ragdollKept))
+          edit_scene(scene, [i, ragdollKept](Scene &scene) { scene.characters[i].ragdollKept = ragdollKept; });
+        if (characterState.hasRagdoll)
+        {
+          float deltaTime = characterState.ragdollToAnimationDeltaTime;
+          if (ImGui::SliderFloat("ragdollToAnimationDeltaTime", &deltaTime, 1.f / 60.f, 1.5f))
+            edit_scene(scene, [i, deltaTime](Scene &scene) { scene.characters[i].ragdollToAnimationDeltaTime = deltaTime; });
         }
+        ImGui::PopID();
       }
 
-      for (size_t i = 0; i < scene.characters.size(); i++)
+      // runs for seconds on its own thread with its own worlds, the app keeps running and competes for the cores
+      static std::vector<PhysicsBenchmarkResult> benchmarkResults;
+      static std::future<std::vector<PhysicsBenchmarkResult>> benchmark;
+      if (benchmark.valid())
+      {
+        if (benchmark.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+          benchmarkResults = benchmark.get();
+        else
+          ImGui::Text("Benchmark is running...");
+      }
+      else if (ImGui::Button("Benchmark"))
+      {
+        auto it = std::find_if(state.characters.begin(), state.characters.end(), [](const CharacterUiState &character) { return character.ragdollSettings != nullptr; });
+        if (it != state.characters.end())
+        {
+          benchmark = std::async(std::launch::async, [ragdollSettings = it->ragdollSettings]()
+          {
+            std::vector<int> threadCounts;
+            for (int threads = 1; threads < (int)std::thread::hardware_concurrency(); threads *= 2)
+              threadCounts.push_back(threads);
+            threadCounts.push_back(std::thread::hardware_concurrency());
+            const int ragdollCounts[] = {1, 8, 32, 64};
+            return run_physics_benchmark(ragdollSettings, ragdollCounts, threadCounts, 120);
+          });
+        }
+      }
+      if (!benchmarkResults.empty())
       {
-        Character &character = scene.characters[i];
-        if (character.ragdoll)
+        ImGui::Columns(4, "physics benchmark");
+        ImGui::Text("Job system"); ImGui::NextColumn();
+        ImGui::Text("Threads"); ImGui::NextColumn();
+        ImGui::Text("Ragdolls"); ImGui::NextColumn();
+        ImGui::Text("Step ms"); ImGui::NextColumn();
+        ImGui::Separator();
+        for (const PhysicsBenchmarkResult &result : benchmarkResults)
         {
-          ImGui::SliderFloat("ragdollToAnimationDeltaTime", &character.ragdollToAnimationDeltaTime, 1.f / 60.f, 1.5f);
+          ImGui::Text("%s", get_physics_job_backend_name(result.backend)); ImGui::NextColumn();
+          ImGui::Text("%d", result.threadCount); ImGui::NextColumn();
+          ImGui::Text("%d", result.ragdollCount); ImGui::NextColumn();
+          ImGui::Text("%.3f", result.stepMs); ImGui::NextColumn();
         }
+        ImGui::Columns(1);
       }
+
       if (ImGui::Button("Destroy Physics World"))
       {
-        for (size_t i = 0; i < scene.characters.size(); i++)
+        edit_scene(scene, [](Scene &scene)
         {
-          Character &character = scene.characters[i];
-          if (character.ragdoll)
+          if (!scene.physicsWorld)
+            return;
+          for (Character &character : scene.characters)
           {
-            character.ragdoll = nullptr;
+            scene.physicsWorld->mRagdollManager.release(character.ragdoll);
+            character.ragdollState = RagdollState::Animated;
           }
-        }
-        scene.physicsWorld.reset();
+          scene.physicsWorld.reset();
+        });
+      }
+    }
+  }
+  ImGui::End();
+}
+
+static void show_memory()
+{
+  if (ImGui::Begin("Memory"))
+  {
+    constexpr size_t TAG_COUNT = size_t(engine::MemoryTag::Count);
+    // allocation rate is averaged over a second
+    static uint64_t lastAllocations[TAG_COUNT] = {};
+    static float allocationRate[TAG_COUNT] = {};
+    static float lastRateTime = 0.f;
+    const float time = engine::get_time();
+    const bool updateRate = time - lastRateTime >= 1.f;
+
+    ImGui::Columns(5, "memory");
+    ImGui::Text("subsystem");
+    ImGui::NextColumn();
+    ImGui::Text("live KB");
+    ImGui::NextColumn();
+    ImGui::Text("peak KB");
+    ImGui::NextColumn();
+    ImGui::Text("live allocations");
+    ImGui::NextColumn();
+    ImGui::Text("allocations/s");
+    ImGui::NextColumn();
+    ImGui::Separator();
+    for (size_t i = 0; i < TAG_COUNT; i++)
+    {
+      engine::MemoryStats stats = engine::get_memory_stats(engine::MemoryTag(i));
+      if (updateRate)
+      {
+        allocationRate[i] = (stats.totalAllocations - lastAllocations[i]) / (time - lastRateTime);
+        lastAllocations[i] = stats.totalAllocations;
       }
+      ImGui::Text("%s", engine::get_memory_tag_name(engine::MemoryTag(i)));
+      ImGui::NextColumn();
+      ImGui::Text("%.1f", stats.liveBytes / 1024.f);
+      ImGui::NextColumn();
+      ImGui::Text("%.1f", stats.peakBytes / 1024.f);
+      ImGui::NextColumn();
+      ImGui::Text("%zu", stats.liveAllocations);
+      ImGui::NextColumn();
+      ImGui::Text("%.0f", allocationRate[i]);
+      ImGui::NextColumn();
     }
+    ImGui::Columns(1);
+    if (updateRate)
+      lastRateTime = time;
+    if (ImGui::Button("Dump to log"))
+      engine::dump_memory_stats();
   }
   ImGui::End();
 }
 
-void application_imgui_render(Scene &scene)
+void capture_ui_state(const Scene &scene, SceneUiState &state)
+{
+  state.characters.resize(scene.characters.size());
+  for (size_t i = 0; i < scene.characters.size(); i++)
+  {
+    const Character &character = scene.characters[i];
+    CharacterUiState &characterState = state.characters[i];
+    characterState.name = character.name;
+    characterState.nodeNames = character.skeletonInfo.names;
+    characterState.nodeDepths = character.skeletonInfo.hierarchyDepth;
+    characterState.nodeParents = character.skeletonInfo.parents;
+    characterState.meshCount = character.meshes.size();
+    characterState.ragdollSettings = character.ragdollSettings;
+    characterState.transform = character.transform;
+    characterState.ragdollTargetTransform = character.ragdollTargetTransform;
+    characterState.pose = character.renderPose;
+    characterState.linearVelocity = character.linearVelocity;
+    characterState.movementDirection = character.movementDirection;
+    characterState.ragdollToAnimationDeltaTime = character.ragdollToAnimationDeltaTime;
+    characterState.selectedAnimation = character.selectedAnimation;
+    characterState.state = character.state;
+    characterState.ragdollState = character.ragdollState;
+    characterState.visible = character.visible;
+    characterState.ragdollKept = character.ragdollKept;
+    characterState.ragdollDragged = character.ragdollDragged;
+    characterState.hasRagdoll = character.ragdoll != nullptr;
+    characterState.animationTime = -1.f;
+    characterState.hasAnimationGraph = false;
+    characterState.inertialization = false;
+    for (const auto &controller : character.controllers)
+    {
+      if (const SingleAnimation *singleAnimation = dynamic_cast<const SingleAnimation *>(controller.get()))
+        characterState.animationTime = singleAnimation->animation->duration() * singleAnimation->progress;
+      if (const AnimationGraph *graph = dynamic_cast<const AnimationGraph *>(controller.get()))
+      {
+        characterState.hasAnimationGraph = true;
+        characterState.inertialization |= graph->get_transition_mode() == TransitionMode::Inertialization;
+      }
+    }
+  }
+  state.culling = scene.culling;
+
+  PhysicsUiState &physics = state.physics;
+  physics.created = scene.physicsWorld != nullptr;
+  if (physics.created)
+  {
+    const PhysicsWorld &world = *scene.physicsWorld;
+    physics.stepMs = world.mLastStepMs;
+    physics.threadCount = world.mJobSystem->GetMaxConcurrency();
+    physics.tempAllocatorCapacity = world.mTempAllocator->get_capacity();
+    physics.tempAllocatorHighWater = world.mTempAllocator->get_high_water_mark();
+    physics.tempAllocatorOverflows = world.mTempAllocator->get_overflow_count();
+    physics.activeRagdolls = world.mRagdollManager.get_active_count();
+    physics.pooledRagdolls = world.mRagdollManager.get_pooled_count();
+    physics.ragdollPolicy = world.mRagdollManager.policy;
+  }
+  const GroundQueries &groundQueries = scene.groundQueries;
+  physics.groundRayCount = groundQueries.lastRayCount;
+  physics.groundQueryMs = groundQueries.lastQueryMs;
+  physics.probeHeight = groundQueries.probeHeight;
+  physics.footProbeDepth = groundQueries.footProbeDepth;
+  physics.hipProbeDepth = groundQueries.hipProbeDepth;
+}
+
+void application_imgui_render(Scene &scene, const SceneUiState &state)
 {
   render_imguizmo(mCurrentGizmoOperation, mCurrentGizmoMode);
 
-  show_info();
-  show_characters(scene);
+  show_info(scene, state);
+  show_characters(scene, state);
   show_models(scene);
-  show_physics(scene);
+  show_physics(scene, state);
+  show_memory();
 }
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+#include "engine/3dmath.h"
+#include "engine/small_function.h"
+#include "character.h"
+#include <string>
+#include <vector>
+
+struct Scene;
+
+// Simulated state shown by the ui. The ui reads this copy and changes the scene only through scene commands,
+// so in Pipelined mode it never touches the scene while a frame update is in flight.
+struct CharacterUiState
+{
+  std::string name;
+  std::vector<std::string> nodeNames;
+  std::vector<int> nodeDepths;
+  std::vector<int> nodeParents;
+  size_t meshCount = 0;
+  JPH::Ref<JPH::RagdollSettings> ragdollSettings; // shared, immutable after load, also starts the benchmark
+  mat4 transform;
+  mat4 ragdollTargetTransform;
+  std::vector<mat4> pose; // render pose, for the skeleton overlay and the joint gizmo
+  float linearVelocity = 0.f;
+  float movementDirection = 0.f;
+  float ragdollToAnimationDeltaTime = 0.f;
+  float animationTime = -1.f; // seconds into the clip of the SingleAnimation controller, -1 without one
+  int selectedAnimation = -1;
+  AnimationState state = AnimationState::Idle;
+  RagdollState ragdollState = RagdollState::Animated;
+  bool hasAnimationGraph = false;
+  bool inertialization = false; // transition mode of the animation graphs
+  bool visible = true;          // seen by the simulation on the last tick
+  bool ragdollKept = false;
+  bool ragdollDragged = false;
+  bool hasRagdoll = false;
+};
+
+struct PhysicsUiState
+{
+  bool created = false;
+  float stepMs = 0.f;
+  int threadCount = 0;
+  uint32_t tempAllocatorCapacity = 0, tempAllocatorHighWater = 0, tempAllocatorOverflows = 0;
+  int activeRagdolls = 0, pooledRagdolls = 0;
+  RagdollPolicy ragdollPolicy;
+  int groundRayCount = 0;
+  float groundQueryMs = 0.f;
+  float probeHeight = 0.f, footProbeDepth = 0.f, hipProbeDepth = 0.f;
+};
+
+struct SceneUiState
+{
+  std::vector<CharacterUiState> characters;
+  CullingSettings culling;
+  PhysicsUiState physics;
+};
+
+// reads the simulated state, called with Scene::simulationMutex locked or by the frame update which owns the scene
+void capture_ui_state(const Scene &scene, SceneUiState &state);
+
+// an edit of simulated state made by the main thread
+using SceneCommand = SmallFunction<void(Scene &), 128>;
+
+// runs the command at once with Scene::simulationMutex held by the caller,
+// or in Pipelined mode before the next frame update on the update job
+void edit_scene(Scene &scene, SceneCommand &&command);
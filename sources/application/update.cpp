@@ -1,24 +1,197 @@
 #include "scene.h"
+#include "engine/profiler.h"
+#include "engine/replay.h"
+#include "engine/job_system.h"
 
 #include <ozz/animation/runtime/local_to_model_job.h>
 #include <ozz/animation/runtime/sampling_job.h>
 #include <ozz/animation/runtime/blending_job.h>
 
+// parameter of directional blend spaces, x - strafe velocity, y - forward velocity
+static vec2 get_blend_space_2d_parameter(const Character &character)
+{
+  const float direction = character.movementDirection * DegToRad;
+  return vec2(sinf(direction), cosf(direction)) * character.linearVelocity;
+}
+
+// parameters changed from ui, recorded so a replay reproduces the same workload
+static void sync_replay_parameters(Character &character)
+{
+  engine::replay_sync(character.transform);
+  engine::replay_sync(character.ragdollTargetTransform);
+  engine::replay_sync(character.ragdollToAnimationDeltaTime);
+  engine::replay_sync(character.ragdollHit);
+  engine::replay_sync(character.ragdollKept);
+  engine::replay_sync(character.ragdollDragged);
+  engine::replay_sync(character.linearVelocity);
+  engine::replay_sync(character.movementDirection);
+  engine::replay_sync(character.selectedAnimation);
+  engine::replay_sync(character.state);
+}
+
+uint64_t pose_checksum(const Scene &scene)
+{
+  uint64_t hash = engine::hash_bytes(nullptr, 0);
+  for (const Character &character : scene.characters)
+  {
+    const auto &worldTransforms = character.animationContext.worldTransforms;
+    hash = engine::hash_bytes(worldTransforms.data(), worldTransforms.size() * sizeof(worldTransforms[0]), hash);
+  }
+  return hash;
+}
+
+// main thread, once per frame
 void application_update(Scene &scene)
 {
-  if (scene.physicsWorld)
-    scene.physicsWorld->update_physics(engine::get_delta_time());
+  // replay runs in Serial mode, otherwise an update job may own the characters now
+  if (engine::get_replay_mode() != engine::ReplayMode::None)
+    for (Character &character : scene.characters)
+      sync_replay_parameters(character);
 
   arcball_camera_update(
     scene.userCamera.arcballCamera,
     scene.userCamera.transform,
     engine::get_delta_time());
+}
+
+// Jolt and ozz matrices are both four SIMD columns, columns are copied without going through memory twice
+static void to_jolt(const ozz::math::Float4x4 &from, JPH::Mat44 &to)
+{
+  for (int c = 0; c < 4; c++)
+    ozz::math::StorePtr(from.cols[c], reinterpret_cast<float *>(&to) + c * 4);
+}
+
+static void to_ozz(const JPH::Mat44 &from, ozz::math::SimdFloat4 offset, ozz::math::Float4x4 &to)
+{
+  for (int c = 0; c < 4; c++)
+    to.cols[c] = ozz::math::simd_float4::LoadPtr(reinterpret_cast<const float *>(&from) + c * 4);
+  to.cols[3] = to.cols[3] + offset;
+}
+
+// drives one ragdoll to the animated pose and writes the simulated pose back into worldTransforms,
+// touches only bodies of this ragdoll, so characters run in parallel with the no lock body interface
+static void sync_ragdoll(Character &character, JPH::BodyInterface &bodyInterface)
+{
+  AnimationContext &animationContext = character.animationContext;
+  JPH::Array<JPH::Mat44> &pose = character.ragdollPose;
+  const std::vector<int> &nodes = character.ragdollNodes;
+  pose.resize(nodes.size());
+  for (size_t jointIdx = 0; jointIdx < nodes.size(); jointIdx++)
+    if (nodes[jointIdx] >= 0)
+      to_jolt(animationContext.worldTransforms[nodes[jointIdx]], pose[jointIdx]);
+
+  // a falling ragdoll isn't driven, so its bodies can fall asleep once at rest
+  if (character.ragdollState == RagdollState::Driven)
+    character.ragdoll->DriveToPoseUsingKinematics(JPH::Vec3::sZero(), pose.data(), character.ragdollToAnimationDeltaTime, false);
+
+  JPH::RVec3 rootOffset;
+  character.ragdoll->GetPose(rootOffset, pose.data(), false);
+
+  if (character.ragdollDragged)
+  {
+    const JPH::BodyID headId = character.ragdoll->GetBodyID(4); // head
+    const auto currentRotation = bodyInterface.GetRotation(headId);
+
+    glm::vec3 targetPosition = character.ragdollTargetTransform[3];
+    const float fixedDeltaTime = 1.f / 60.f;
+    bodyInterface.MoveKinematic(headId, JPH::Vec3(targetPosition.x, targetPosition.y, targetPosition.z), currentRotation, fixedDeltaTime);
+  }
 
+  ozz::animation::LocalToModelJob localToModelJob;
+  localToModelJob.skeleton = animationContext.skeleton;
+  localToModelJob.input = ozz::make_span(animationContext.localTransforms);
+  localToModelJob.output = ozz::make_span(animationContext.worldTransforms);
+  ozz::math::Float4x4 root;
+  memcpy(&root, &character.transform, sizeof(root));
+  localToModelJob.root = &root;
+
+  const ozz::math::SimdFloat4 offset = ozz::math::simd_float4::Load3PtrU(rootOffset.mF32);
+  for (size_t jointIdx = 0; jointIdx < nodes.size(); jointIdx++)
+  {
+    const int nodeIdx = nodes[jointIdx];
+    if (nodeIdx < 0)
+      continue;
+    to_ozz(pose[jointIdx], offset, animationContext.worldTransforms[nodeIdx]);
+
+    // children which aren't ragdoll parts follow their simulated parent
+    localToModelJob.from = nodeIdx;
+    localToModelJob.from_excluded = true;
+    assert(localToModelJob.Validate());
+    const bool success = localToModelJob.Run();
+    assert(success);
+  }
+}
+
+// after the animation of all characters, outside of the physics step
+static void sync_ragdolls(Scene &scene, float dt)
+{
+  PROFILE_ZONE("ragdoll sync");
+  RagdollManager &ragdollManager = scene.physicsWorld->mRagdollManager;
+
+  // adding and removing bodies changes the broad phase, so attaching is serial
+  std::vector<Character *> ragdollCharacters;
   for (Character &character : scene.characters)
   {
+    // characters which don't interact with physics keep their ragdoll in the pool
+    const bool needsRagdoll = ragdollManager.update_state(character, dt);
+    if (!needsRagdoll)
+    {
+      ragdollManager.release(character.ragdoll);
+      continue;
+    }
+    if (character.ragdollNodes.empty())
+    {
+      for (const JPH::SkeletonJoint &joint : character.ragdollSettings->GetSkeleton()->GetJoints())
+      {
+        auto it = character.skeletonInfo.nodesMap.find(joint.mName.c_str());
+        character.ragdollNodes.push_back(it != character.skeletonInfo.nodesMap.end() ? it->second : -1);
+      }
+    }
+    if (!character.ragdoll)
+    {
+      character.ragdollPose.assign(character.ragdollNodes.size(), JPH::Mat44::sIdentity());
+      for (size_t jointIdx = 0; jointIdx < character.ragdollNodes.size(); jointIdx++)
+        if (character.ragdollNodes[jointIdx] >= 0)
+          to_jolt(character.animationContext.worldTransforms[character.ragdollNodes[jointIdx]], character.ragdollPose[jointIdx]);
+      character.ragdoll = ragdollManager.acquire(character.ragdollSettings, character.ragdollPose.data());
+    }
+    assert(character.ragdoll->GetBodyCount() == character.ragdollNodes.size());
+    ragdollCharacters.push_back(&character);
+  }
+
+  JPH::BodyInterface &bodyInterface = scene.physicsWorld->mPhysicsSystem.GetBodyInterfaceNoLock();
+  engine::get_job_system().parallel_for(ragdollCharacters.size(), 1, [&](int begin, int end)
+  {
+    for (int i = begin; i < end; i++)
+      sync_ragdoll(*ragdollCharacters[i], bodyInterface);
+  });
+}
+
+// one simulation tick, called with Scene::simulationMutex locked
+void application_simulate(Scene &scene, float dt, const mat4 &projection_view)
+{
+  // physics steps on workers while characters animate, nothing below touches bodies until the join
+  if (scene.physicsWorld)
+    scene.physicsWorld->begin_update_physics(dt);
+
+  // characters out of view animate at a lower rate, visibility uses the bounds of the previous tick
+  update_visibility(scene, projection_view);
+
+  for (Character &character : scene.characters)
+  {
+    character.animationDeltaTime += dt;
+    if (!character.visible && ++character.culledTicks < scene.culling.culledUpdateInterval)
+      continue;
+    character.culledTicks = 0;
+    const float animationDt = character.animationDeltaTime;
+    character.animationDeltaTime = 0.f;
+
+    PROFILE_ZONE("character");
     AnimationContext &animationContext = character.animationContext;
 
     std::vector<WeightedAnimation> animations;
+    float inertializationDuration = 0.f;
+    bool inertialized = false;
     for (auto &controller : character.controllers)
     {
       // check rtti information that the controller is a BlendSpace1D
@@ -38,21 +211,31 @@ void application_update(Scene &scene)
       {
         blendSpace->set_parameter(glm::length(character.linearVelocity));
       }
+      if (BlendSpace2D *blendSpace = dynamic_cast<BlendSpace2D *>(controller.get()))
+      {
+        blendSpace->set_parameter(get_blend_space_2d_parameter(character));
+      }
       if (AnimationGraph *graph = dynamic_cast<AnimationGraph *>(controller.get()))
       {
         graph->set_state(character.state);
+        graph->consume_inertialization(inertializationDuration);
+        inertialized |= graph->get_transition_mode() == TransitionMode::Inertialization;
         for (auto &node : graph->nodes)
         {
           if (BlendSpace1D *blendSpace = dynamic_cast<BlendSpace1D *>(node.animation.get()))
           {
             blendSpace->set_parameter(glm::length(character.linearVelocity));
           }
+          if (BlendSpace2D *blendSpace = dynamic_cast<BlendSpace2D *>(node.animation.get()))
+          {
+            blendSpace->set_parameter(get_blend_space_2d_parameter(character));
+          }
         }
       }
     }
     for (auto &controller : character.controllers)
     {
-      controller->update(engine::get_delta_time());
+      controller->update(animationDt);
       controller->collect_animations(animations, 1.f);
     }
 
@@ -63,6 +246,7 @@ void application_update(Scene &scene)
     // Animation sampling
     for (AnimationLayer &layer : animationContext.layers)
     {
+      PROFILE_ZONE("sampling");
       ozz::animation::SamplingJob samplingJob;
       samplingJob.ratio = layer.currentProgress;
       assert(0.f <= samplingJob.ratio && samplingJob.ratio <= 1.f);
@@ -79,6 +263,7 @@ void application_update(Scene &scene)
     // Animation blending
     if (!animationContext.layers.empty())
     {
+      PROFILE_ZONE("blending");
       ozz::animation::BlendingJob blendingJob;
       blendingJob.output = ozz::make_span(animationContext.localTransforms);
       blendingJob.threshold = 0.01f;
@@ -102,6 +287,17 @@ void application_update(Scene &scene)
       animationContext.localTransforms.assign(tPose.begin(), tPose.end());
     }
 
+    PoseInertializer &inertializer = animationContext.inertializer;
+    if (inertializationDuration > 0.f)
+      inertializer.start(ozz::make_span(animationContext.localTransforms), inertializationDuration);
+    inertializer.apply(ozz::make_span(animationContext.localTransforms), animationDt);
+    // cross faded graphs never start an inertialization, the pose copy is skipped for them
+    if (inertialized)
+      inertializer.record(ozz::make_span(animationContext.localTransforms), animationDt);
+    else
+      inertializer.clear_history();
+
+    PROFILE_ZONE("local to model");
     ozz::animation::LocalToModelJob localToModelJob;
     localToModelJob.skeleton = animationContext.skeleton;
     localToModelJob.input = ozz::make_span(animationContext.localTransforms);
@@ -114,67 +310,16 @@ void application_update(Scene &scene)
     assert(localToModelJob.Validate());
     const bool success = localToModelJob.Run();
     assert(success);
+  }
 
-    if (character.ragdoll)
-    {
-      const auto &joints = character.ragdoll->GetRagdollSettings()->GetSkeleton()->GetJoints();
-      assert(character.ragdoll->GetBodyCount() == joints.size());
-
-      JPH::Array<JPH::Mat44> animtedPose(joints.size());
-      for (size_t jointIdx = 0; jointIdx < joints.size(); jointIdx++)
-      {
-        const auto &joint = joints[jointIdx];
-        auto it = character.skeletonInfo.nodesMap.find(joint.mName.c_str());
-        if (it == character.skeletonInfo.nodesMap.end())
-          continue;
-        int nodeIdx = it->second;
-        ozz::math::Float4x4 &worldTransform = animationContext.worldTransforms[nodeIdx];
-        memcpy(&animtedPose[jointIdx], &worldTransform, sizeof(JPH::Mat44));
-      }
-
-      character.ragdoll->DriveToPoseUsingKinematics(JPH::Vec3::sZero(), animtedPose.data(), character.ragdollToAnimationDeltaTime);
-
-      // JPH::SkeletonPose pose;
-      // pose.SetSkeleton(character.ragdoll->GetRagdollSettings()->GetSkeleton());
-      // pose.GetJointMatrices() = animtedPose;
-      // pose.CalculateJointStates();
-      // character.ragdoll->DriveToPoseUsingMotors(pose);
-
-      std::vector<JPH::Mat44> outPose(joints.size());
-      JPH::RVec3 rootOffset;
-      character.ragdoll->GetPose(rootOffset, outPose.data(), true);
-
-      if (true)
-      {
-        const JPH::BodyID headId = character.ragdoll->GetBodyID(4); // head
-        JPH::BodyInterface &bodyInterface = scene.physicsWorld->mPhysicsSystem.GetBodyInterface();
-        const auto currentRotation = bodyInterface.GetRotation(headId);
-
-        glm::vec3 targetPosition = character.ragdollTargetTransform[3];
-        const float fixedDeltaTime = 1.f / 60.f;
-        bodyInterface.MoveKinematic(headId, JPH::Vec3(targetPosition.x, targetPosition.y, targetPosition.z), currentRotation, fixedDeltaTime);
-      }
-      for (size_t jointIdx = 0; jointIdx < joints.size(); jointIdx++)
-      {
-        const auto &joint = joints[jointIdx];
-        auto it = character.skeletonInfo.nodesMap.find(joint.mName.c_str());
-        if (it == character.skeletonInfo.nodesMap.end())
-          continue;
-        int nodeIdx = it->second;
-
-        ozz::math::Float4x4 ragdollTransformDeltaOzz;
-        memcpy(&ragdollTransformDeltaOzz, &outPose[jointIdx], sizeof(JPH::Mat44));
-        ozz::math::Float4x4 &worldTransform = animationContext.worldTransforms[nodeIdx];
-        worldTransform = ragdollTransformDeltaOzz;
-        worldTransform.cols[3] = worldTransform.cols[3] + ozz::math::simd_float4::LoadPtrU(rootOffset.mF32);
-
-        localToModelJob.from = nodeIdx;
-        localToModelJob.from_excluded = true;
-        assert(localToModelJob.Validate());
-        const bool success = localToModelJob.Run();
-        assert(success);
-      }
-
-    }
+  if (scene.physicsWorld)
+  {
+    scene.physicsWorld->wait_update_physics();
+    sync_ragdolls(scene, dt);
+    query_ground(scene.groundQueries, *scene.physicsWorld, scene.characters);
   }
-}
\ No newline at end of file
+
+  // after the ragdoll sync, simulated parts move the bounds too
+  for (Character &character : scene.characters)
+    update_world_bounds(character);
+}
@@ -0,0 +1,185 @@
+// Standalone ragdoll scaling benchmark, steps PhysicsWorld without a window or GL context.
+// physics_benchmark [--ragdolls N] [--boxes M] [--threads T] [--frames F] [--backend engine|jolt|single] [--ragdoll-settings path]
+#include "application/physics_world.h"
+#include "engine/api.h"
+#include "engine/memory.h"
+#include "engine/profiler.h"
+#include "import/timer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+JPH::Ref<JPH::RagdollSettings> load_cached_ragdoll_settings(const std::string &path);
+
+struct BenchmarkOptions
+{
+  int ragdolls = 64;
+  int boxes = 0;
+  int threads = 0; // 0 - all
+  int frames = 600;
+  PhysicsJobBackend backend = PhysicsJobBackend::EnginePool;
+  std::string ragdollSettingsPath = "resources/MotusMan_v55/MotusMan_v55.ragdoll";
+};
+
+static bool parse_options(int argc, char **argv, BenchmarkOptions &options)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value)
+      return false;
+    i++;
+    if (!strcmp(arg, "--ragdolls"))
+      options.ragdolls = atoi(value);
+    else if (!strcmp(arg, "--boxes"))
+      options.boxes = atoi(value);
+    else if (!strcmp(arg, "--threads"))
+      options.threads = atoi(value);
+    else if (!strcmp(arg, "--frames"))
+      options.frames = std::max(atoi(value), 1);
+    else if (!strcmp(arg, "--ragdoll-settings"))
+      options.ragdollSettingsPath = value;
+    else if (!strcmp(arg, "--backend"))
+    {
+      if (!strcmp(value, "engine"))
+        options.backend = PhysicsJobBackend::EnginePool;
+      else if (!strcmp(value, "jolt"))
+        options.backend = PhysicsJobBackend::JoltThreadPool;
+      else if (!strcmp(value, "single"))
+        options.backend = PhysicsJobBackend::SingleThreaded;
+      else
+        return false;
+    }
+    else
+      return false;
+  }
+  return true;
+}
+
+// names of the jobs PhysicsSystem::Update creates, jobs don't nest, so their zones add up without double counting
+static const char *get_job_phase(const char *job)
+{
+  static const char *broadPhase[] = {"Update Broadphase Prepare", "Update Broadphase Finalize"};
+  static const char *narrowPhase[] = {"Find Collisions", "Find CCD Contacts", "Resolve CCD Contacts"};
+  static const char *solver[] = {
+    "Determine Active Constraints", "Setup Velocity Constraints", "Build Islands from Constraints", "Finalize Islands",
+    "Body Set Island Index", "Solve Velocity Constraints", "Pre Integrate Velocity", "Integrate Velocity",
+    "Post Integrate Velocity", "Solve Position Constraints"};
+  auto contains = [job](const auto &names)
+  { return std::any_of(std::begin(names), std::end(names), [job](const char *name) { return !strcmp(name, job); }); };
+  if (contains(broadPhase))
+    return "broad phase";
+  if (contains(narrowPhase))
+    return "narrow phase";
+  if (contains(solver))
+    return "solver";
+  return nullptr;
+}
+
+static float percentile(const std::vector<float> &sorted, float p)
+{
+  const size_t idx = std::min(sorted.size() - 1, size_t(p * (sorted.size() - 1) + 0.5f));
+  return sorted[idx];
+}
+
+int main(int argc, char **argv)
+{
+  BenchmarkOptions options;
+  if (!parse_options(argc, argv, options))
+  {
+    printf("usage: %s [--ragdolls N] [--boxes M] [--threads T] [--frames F] [--backend engine|jolt|single] [--ragdoll-settings path]\n", argv[0]);
+    return 1;
+  }
+  engine::init_memory_tracking();
+  init_phys_globals();
+  engine::set_profiler_enabled(true);
+
+  int result = 0;
+  JPH::Ref<JPH::RagdollSettings> ragdollSettings = load_cached_ragdoll_settings(options.ragdollSettingsPath);
+  if (!ragdollSettings)
+  {
+    result = 1;
+  }
+  else
+  {
+    PhysicsWorldSettings settings;
+    settings.jobBackend = options.backend;
+    settings.threadCount = options.threads;
+    PhysicsWorld world(settings);
+    std::vector<JPH::Ref<JPH::Ragdoll>> ragdolls;
+    spawn_benchmark_scene(world, ragdollSettings, options.ragdolls, options.boxes, ragdolls);
+    const engine::MemoryStats setupMemory = engine::get_memory_stats(engine::MemoryTag::Physics);
+
+    const float fixedTimeStep = 1.0f / 60.0f;
+    std::vector<float> stepMs;
+    std::vector<engine::ProfileZoneTotal> zones;
+    stepMs.reserve(options.frames);
+    for (int frame = 0; frame < options.frames; frame++)
+    {
+      const uint64_t start = engine::get_profiler_time_ns();
+      Timer timer;
+      world.update_physics(fixedTimeStep);
+      stepMs.push_back(timer.elapsed_ms());
+      // zones are summed every frame, the per thread rings would wrap over a long run
+      engine::get_profile_zone_totals(start, engine::get_profiler_time_ns(), zones);
+    }
+
+    std::vector<float> sorted = stepMs;
+    std::sort(sorted.begin(), sorted.end());
+    float total = 0.f;
+    for (float ms : stepMs)
+      total += ms;
+    const float mean = total / stepMs.size();
+
+    // the EnginePool backend with --threads steps on its own workers, so this is the number of threads doing the work
+    printf("backend %s, %d threads, %d ragdolls (%u bodies), %d boxes, %d frames\n",
+      get_physics_job_backend_name(options.backend), world.mJobSystem->GetMaxConcurrency(), options.ragdolls,
+      world.mPhysicsSystem.GetNumBodies(), options.boxes, options.frames);
+    printf("step ms: mean %.3f, p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n",
+      mean, percentile(sorted, 0.5f), percentile(sorted, 0.9f), percentile(sorted, 0.99f), sorted.back());
+    if (options.ragdolls > 0)
+      printf("per ragdoll: %.1f us per step\n", mean * 1000.f / options.ragdolls);
+
+    // job time is summed over threads, so it can exceed the wall time of the step
+    const char *phases[] = {"broad phase", "narrow phase", "solver"};
+    uint64_t phaseNs[3] = {}, jobNs = 0;
+    for (const engine::ProfileZoneTotal &zone : zones)
+    {
+      const char *phase = get_job_phase(zone.name);
+      if (!phase)
+        continue;
+      jobNs += zone.totalNs;
+      for (int p = 0; p < 3; p++)
+        if (!strcmp(phase, phases[p]))
+          phaseNs[p] += zone.totalNs;
+    }
+    if (jobNs == 0)
+    {
+      printf("no Jolt job zones, build Jolt with JPH_EXTERNAL_PROFILE for the phase split\n");
+    }
+    else
+    {
+      for (int p = 0; p < 3; p++)
+        printf("%-12s %8.3f ms per step (%4.1f%%)\n", phases[p], phaseNs[p] * 1e-6 / options.frames, 100.0 * phaseNs[p] / jobNs);
+      std::sort(zones.begin(), zones.end(), [](const auto &a, const auto &b) { return a.totalNs > b.totalNs; });
+      printf("top zones, thread time per step:\n");
+      for (size_t i = 0; i < std::min<size_t>(zones.size(), 12); i++)
+        printf("  %-32s %8.3f ms %6u calls\n", zones[i].name, zones[i].totalNs * 1e-6 / options.frames, zones[i].count);
+    }
+
+    const engine::MemoryStats memory = engine::get_memory_stats(engine::MemoryTag::Physics);
+    printf("physics memory: %.2f MiB after setup, %.2f MiB peak, temp allocator high-water %u KiB, %llu allocations during the run\n",
+      setupMemory.liveBytes / (1024.0 * 1024.0), memory.peakBytes / (1024.0 * 1024.0), world.mTempAllocator->get_high_water_mark() / 1024,
+      (unsigned long long)(memory.totalAllocations - setupMemory.totalAllocations));
+
+    for (JPH::Ragdoll *ragdoll : ragdolls)
+      ragdoll->RemoveFromPhysicsSystem();
+  }
+  destroy_phys_globals();
+  engine::flush_log();
+  return result;
+}
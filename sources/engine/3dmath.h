@@ -7,6 +7,7 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/euler_angles.hpp>
 #include <glm/gtx/vector_angle.hpp>
+#include <cfloat>
 using namespace glm;
 
 constexpr float PI = 3.1415926535897932384626433832795f;
@@ -33,4 +34,23 @@ template<typename T>
 quat to_quat(const T& t)
 {
   return quat(t.w, t.x, t.y, t.z);
-}
\ No newline at end of file
+}
+
+// axis aligned box, a default constructed box is empty and grows with add
+struct BoundingBox
+{
+  vec3 min = vec3(FLT_MAX);
+  vec3 max = vec3(-FLT_MAX);
+
+  bool empty() const { return min.x > max.x; }
+  void add(const vec3 &p)
+  {
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
+  void add(const BoundingBox &box)
+  {
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
+  }
+};
@@ -26,7 +26,8 @@ namespace engine
 
   // LOGGING SUBSYSTEM //
 
-  // thread safe logging with saving history into ringBuffer
+  // thread safe lock-free logging, messages are printed and saved into history by a writer thread
+  // identical messages repeated more than a few times per second are dropped
 
   // max number of log messages to keep in history
   const int MAX_LOG_HISTORY = 128;
@@ -37,6 +38,9 @@ namespace engine
   // log white message into console
   void log(const char *format, ...);
 
+  // block until queued messages are printed
+  void flush_log();
+
   // INPUT SUBSYSTEM //
 
   // Event for keyboard input
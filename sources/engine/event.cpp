@@ -0,0 +1,74 @@
+#include "engine/event.h"
+#include "engine/api.h"
+#include <algorithm>
+#include <mutex>
+
+namespace engine
+{
+  struct EventRegistry
+  {
+    std::mutex mutex;
+    std::vector<EventQueueBase *> events[size_t(EventPhase::Count)];
+  };
+
+  // function static, so events defined as globals in other translation units can register
+  static EventRegistry &get_registry()
+  {
+    static EventRegistry registry;
+    return registry;
+  }
+
+  void register_event(EventPhase phase, EventQueueBase *event)
+  {
+    EventRegistry &registry = get_registry();
+    std::unique_lock lock(registry.mutex);
+    registry.events[size_t(phase)].push_back(event);
+  }
+
+  void unregister_event(EventPhase phase, EventQueueBase *event)
+  {
+    EventRegistry &registry = get_registry();
+    std::unique_lock lock(registry.mutex);
+    std::erase(registry.events[size_t(phase)], event);
+  }
+
+  static std::atomic<bool> phaseOffMainThread[size_t(EventPhase::Count)] = {};
+
+  void set_event_phase_off_main_thread(EventPhase phase, bool off_main_thread)
+  {
+    phaseOffMainThread[size_t(phase)].store(off_main_thread, std::memory_order_relaxed);
+  }
+
+  bool can_change_subscriptions(EventPhase phase)
+  {
+    if (!phaseOffMainThread[size_t(phase)].load(std::memory_order_relaxed))
+      return true;
+    engine::error("Subscriptions of events dispatched off the main thread can't change, leave the pipelined frame mode first");
+    return false;
+  }
+
+  void dispatch_events(EventPhase phase)
+  {
+    // subscribers may create events, so they are called without the lock
+    thread_local std::vector<EventQueueBase *> events;
+    {
+      EventRegistry &registry = get_registry();
+      std::unique_lock lock(registry.mutex);
+      events = registry.events[size_t(phase)];
+    }
+    for (EventQueueBase *event : events)
+      event->dispatch();
+  }
+
+  uint32_t get_event_thread_index()
+  {
+    static std::atomic<uint32_t> threadCount = 0;
+    thread_local const uint32_t threadIndex = std::min(threadCount++, MAX_EVENT_THREADS);
+    if (threadIndex == MAX_EVENT_THREADS)
+    {
+      static std::once_flag reported;
+      std::call_once(reported, []() { engine::error("More than %u threads post events, the others share a locked queue", MAX_EVENT_THREADS); });
+    }
+    return threadIndex;
+  }
+} // namespace engine
@@ -1,33 +1,244 @@
 #pragma once
 
-#include <functional>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "engine/small_function.h"
 
-template<typename T>
-struct Event
+namespace engine
 {
-  using Delegate = std::function<void (const T &)>;
-  std::vector<Delegate> callbacks;
+  // points of the frame where posted events are delivered, in frame order
+  enum class EventPhase
+  {
+    Input,       // after input polling, before update
+    PostPhysics, // after the simulation ticks of the frame
+    PostUpdate,  // after update, before render
+    Count
+  };
+
+  // delivers events posted to all events of the phase, on the main thread,
+  // PostPhysics events are delivered by the frame update job in the pipelined frame mode
+  void dispatch_events(EventPhase phase);
+
+  // set while events of the phase are dispatched off the main thread, subscriptions to them are refused then
+  void set_event_phase_off_main_thread(EventPhase phase, bool off_main_thread);
+  // false and an error if subscriptions to events of the phase are refused
+  bool can_change_subscriptions(EventPhase phase);
+
+  constexpr uint32_t MAX_EVENT_THREADS = 64;
+  // small index of the calling thread, assigned on first use,
+  // MAX_EVENT_THREADS for the threads beyond the limit, they post to a shared locked queue
+  uint32_t get_event_thread_index();
+
+  struct EventQueueBase
+  {
+    virtual void dispatch() = 0;
+  };
+  void register_event(EventPhase phase, EventQueueBase *event);
+  void unregister_event(EventPhase phase, EventQueueBase *event);
+
+  // single producer single consumer queue of blocks, the consumer frees drained blocks
+  template <typename T>
+  class PostQueue
+  {
+    static constexpr uint32_t BLOCK_SIZE = 64;
+    struct Block
+    {
+      T items[BLOCK_SIZE];
+      std::atomic<uint32_t> written = 0;
+      std::atomic<Block *> next = nullptr;
+      uint32_t read = 0;
+    };
+    Block *head; // consumer
+    Block *tail; // producer
+
+  public:
+    PostQueue() : head(new Block()), tail(head) {}
+    ~PostQueue()
+    {
+      while (head)
+        delete std::exchange(head, head->next.load(std::memory_order_relaxed));
+    }
+    PostQueue(const PostQueue &) = delete;
+    PostQueue &operator=(const PostQueue &) = delete;
+
+    void push(const T &value)
+    {
+      uint32_t idx = tail->written.load(std::memory_order_relaxed);
+      if (idx == BLOCK_SIZE)
+      {
+        Block *block = new Block();
+        tail->next.store(block, std::memory_order_release);
+        tail = block;
+        idx = 0;
+      }
+      tail->items[idx] = value;
+      tail->written.store(idx + 1, std::memory_order_release);
+    }
+
+    template <typename Consumer>
+    void drain(Consumer &&consumer)
+    {
+      while (true)
+      {
+        const uint32_t written = head->written.load(std::memory_order_acquire);
+        while (head->read < written)
+          consumer(head->items[head->read++]);
+        if (head->read < BLOCK_SIZE)
+          return;
+        Block *next = head->next.load(std::memory_order_acquire);
+        if (!next)
+          return;
+        delete std::exchange(head, next);
+      }
+    }
+  };
+} // namespace engine
+
+// Typed event with subscribers called on the thread which dispatches its phase: the main thread,
+// or the frame update job for PostPhysics events in the pipelined frame mode, subscriptions can't change then.
+// operator() calls subscribers immediately, post can be called from any thread:
+// every thread has its own lock-free queue, queues are delivered by engine::dispatch_events
+// at the phase of the event, events of one thread keep their order.
+template <typename T>
+struct Event final : engine::EventQueueBase
+{
+  using Delegate = SmallFunction<void(const T &)>;
+  using SubscriptionId = uint32_t;
+
+  explicit Event(engine::EventPhase _phase = engine::EventPhase::Input) : phase(_phase)
+  {
+    engine::register_event(phase, this);
+  }
+
+  ~Event()
+  {
+    engine::unregister_event(phase, this);
+    for (auto &queue : queues)
+      delete queue.load(std::memory_order_acquire);
+  }
+
+  Event(const Event &) = delete;
+  Event &operator=(const Event &) = delete;
+
+  // on the dispatching thread, safe to call from a subscriber, then the new one gets the next events,
+  // returns 0 if subscriptions are refused
+  SubscriptionId subscribe(Delegate &&delegate)
+  {
+    if (!engine::can_change_subscriptions(phase))
+      return 0;
+    // the running delegates live in subscribers, so it doesn't grow during the call
+    (dispatchDepth > 0 ? pendingSubscribers : subscribers).push_back({++lastId, std::move(delegate)});
+    return lastId;
+  }
+
+  void unsubscribe(SubscriptionId id)
+  {
+    if (!engine::can_change_subscriptions(phase))
+      return;
+    std::erase_if(pendingSubscribers, [id](const Subscriber &subscriber) { return subscriber.id == id; });
+    for (size_t i = 0; i < subscribers.size(); i++)
+    {
+      if (subscribers[i].id != id)
+        continue;
+      // the delegate may be the one running, it's destroyed after the dispatch
+      if (dispatchDepth > 0)
+        subscribers[i].removed = true;
+      else
+        subscribers.erase(subscribers.begin() + i);
+      return;
+    }
+  }
 
   Event &operator+=(Delegate &&delegate)
   {
-    callbacks.emplace_back(std::move(delegate));
+    subscribe(std::move(delegate));
     return *this;
   }
 
-  void operator()(const T & event) const
+  void operator()(const T &event)
+  {
+    invoke(event);
+  }
+
+  void post(const T &event)
+  {
+    const uint32_t threadIndex = engine::get_event_thread_index();
+    if (threadIndex >= engine::MAX_EVENT_THREADS)
+    {
+      std::unique_lock lock(overflowMutex);
+      overflowEvents.push_back(event);
+      return;
+    }
+    std::atomic<engine::PostQueue<T> *> &slot = queues[threadIndex];
+    engine::PostQueue<T> *queue = slot.load(std::memory_order_acquire);
+    if (!queue)
+    {
+      // only the owner thread creates its queue
+      queue = new engine::PostQueue<T>();
+      slot.store(queue, std::memory_order_release);
+    }
+    queue->push(event);
+  }
+
+  void dispatch() override
+  {
+    for (auto &slot : queues)
+      if (engine::PostQueue<T> *queue = slot.load(std::memory_order_acquire))
+        queue->drain([this](const T &event) { invoke(event); });
+    {
+      std::unique_lock lock(overflowMutex);
+      std::swap(overflowEvents, drainedOverflowEvents);
+    }
+    for (const T &event : drainedOverflowEvents)
+      invoke(event);
+    drainedOverflowEvents.clear();
+  }
+
+private:
+  struct Subscriber
+  {
+    SubscriptionId id;
+    Delegate delegate;
+    bool removed = false;
+  };
+  std::vector<Subscriber> subscribers;
+  std::vector<Subscriber> pendingSubscribers; // subscribed during a dispatch
+  std::atomic<engine::PostQueue<T> *> queues[engine::MAX_EVENT_THREADS] = {};
+  std::mutex overflowMutex;
+  std::vector<T> overflowEvents, drainedOverflowEvents;
+  engine::EventPhase phase;
+  SubscriptionId lastId = 0;
+  int dispatchDepth = 0;
+
+  void invoke(const T &event)
   {
-    for (const Delegate& delegate : callbacks)
-      delegate(event);
+    dispatchDepth++;
+    for (size_t i = 0; i < subscribers.size(); i++)
+      if (!subscribers[i].removed)
+        subscribers[i].delegate(event);
+    if (--dispatchDepth == 0)
+    {
+      std::erase_if(subscribers, [](const Subscriber &subscriber) { return subscriber.removed; });
+      for (Subscriber &subscriber : pendingSubscribers)
+        subscribers.push_back(std::move(subscriber));
+      pendingSubscribers.clear();
+    }
   }
 };
 
 // Event struct serve as a simple event system.
 
 // How to use:
-// 1) Define an event:
-// Event<ListenedType> onSomeEvent;
-// 2) Add a listener:
-// onSomeEvent += [](const ListenedType &event) { /* do something */ };
+// 1) Define an event, with the phase its posted events are delivered at:
+// Event<ListenedType> onSomeEvent(engine::EventPhase::PostPhysics);
+// 2) Add a listener, keep the id to remove it later:
+// auto id = onSomeEvent.subscribe([](const ListenedType &event) { /* do something */ });
 // onSomeEvent += [](const ListenedType &event) { /* do something else */ };
-// 3) Trigger the event:
+// onSomeEvent.unsubscribe(id);
+// 3) Trigger the event immediately on the main thread:
 // onSomeEvent(event);
+// or from any thread, to be delivered at engine::dispatch_events(phase):
+// onSomeEvent.post(event);
@@ -0,0 +1,259 @@
+#include "import/animation_compression.h"
+#include "import/model.h"
+#include "engine/api.h"
+#include "timer.h"
+#include <ozz/animation/offline/raw_animation.h>
+#include <ozz/animation/offline/animation_builder.h>
+#include <ozz/animation/offline/animation_optimizer.h>
+#include <ozz/animation/runtime/sampling_job.h>
+#include <ozz/animation/runtime/local_to_model_job.h>
+#include <ozz/base/maths/soa_transform.h>
+#include <ozz/base/maths/simd_math.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <thread>
+
+using AnimationOptimizer = ozz::animation::offline::AnimationOptimizer;
+using RawAnimation = ozz::animation::offline::RawAnimation;
+
+// defined in import.cpp
+bool load_raw_animation(const std::string &path, SkeletonPtr &skeleton, RawAnimation &raw_animation, RootMotionTrack *root_motion);
+
+AnimationOptimizer AnimationCompressionProfile::make_optimizer(const ozz::animation::Skeleton &skeleton) const
+{
+  AnimationOptimizer optimizer;
+  optimizer.setting = AnimationOptimizer::Setting(tolerance, distance);
+  for (int i = 0; i < skeleton.num_joints(); i++)
+  {
+    std::string_view jointName = skeleton.joint_names()[i];
+    for (const JointCompressionRule &rule : rules)
+    {
+      if (jointName.find(rule.pattern) != std::string_view::npos)
+      {
+        optimizer.joints_setting_override[i] = AnimationOptimizer::Setting(rule.tolerance, rule.distance);
+        break;
+      }
+    }
+  }
+  return optimizer;
+}
+
+AnimationCompressionProfile AnimationCompressionProfile::scaled(float scale) const
+{
+  AnimationCompressionProfile profile = *this;
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), " x%.2f", scale);
+  profile.name += suffix;
+  profile.tolerance *= scale;
+  for (JointCompressionRule &rule : profile.rules)
+    rule.tolerance *= scale;
+  return profile;
+}
+
+AnimationCompressionProfile default_compression_profile()
+{
+  AnimationCompressionProfile profile;
+  profile.name = "locomotion";
+  profile.tolerance = 1e-3f;
+  profile.distance = 1e-1f;
+  profile.rules = {
+    // fingers go first, "LeftHandThumb1" must not match a stricter hand rule
+    {"Thumb", 5e-3f, 2e-2f},
+    {"Index", 5e-3f, 2e-2f},
+    {"Middle", 5e-3f, 2e-2f},
+    {"Ring", 5e-3f, 2e-2f},
+    {"Pinky", 5e-3f, 2e-2f},
+    // hips move the whole body, feet errors are visible as sliding
+    {"Hips", 1e-4f, 1.f},
+    {"Foot", 1e-4f, 1e-1f},
+    {"Toe", 1e-4f, 1e-1f},
+    {"Leg", 2e-4f, 5e-1f},
+  };
+  return profile;
+}
+
+struct ProfileStats
+{
+  size_t size = 0;
+  float maxEffectorError = 0.f; // meters
+  float maxFootError = 0.f;     // meters
+  double samplingTime = 0.0;    // microseconds
+  int samples = 0;
+};
+
+struct ClipSampler
+{
+  const ozz::animation::Skeleton &skeleton;
+  ozz::animation::SamplingJob::Context context;
+  std::vector<ozz::math::SoaTransform> locals;
+
+  ClipSampler(const ozz::animation::Skeleton &_skeleton) :
+    skeleton(_skeleton), context(_skeleton.num_joints()), locals(_skeleton.num_soa_joints()) {}
+
+  // returns sampling time in microseconds
+  float sample(const ozz::animation::Animation &animation, float ratio, std::vector<ozz::math::Float4x4> &models)
+  {
+    ozz::animation::SamplingJob samplingJob;
+    samplingJob.animation = &animation;
+    samplingJob.context = &context;
+    samplingJob.ratio = ratio;
+    samplingJob.output = ozz::make_span(locals);
+    Timer timer;
+    const bool sampled = samplingJob.Run();
+    const float time = timer.elapsed_us();
+    assert(sampled);
+
+    ozz::animation::LocalToModelJob localToModelJob;
+    localToModelJob.skeleton = &skeleton;
+    localToModelJob.input = ozz::make_span(locals);
+    localToModelJob.output = ozz::make_span(models);
+    const bool converted = localToModelJob.Run();
+    assert(converted);
+    return time;
+  }
+};
+
+static float distance(const ozz::math::Float4x4 &a, const ozz::math::Float4x4 &b)
+{
+  return ozz::math::GetX(ozz::math::Length3(a.cols[3] - b.cols[3]));
+}
+
+void build_compression_report(
+  const std::vector<std::string> &paths,
+  const std::vector<AnimationCompressionProfile> &profiles,
+  const std::string &output_path)
+{
+  Timer timer;
+  SkeletonPtr skeleton;
+  size_t firstClip = 0;
+  {
+    RawAnimation unused;
+    while (firstClip < paths.size() && !load_raw_animation(paths[firstClip], skeleton, unused, nullptr))
+      firstClip++;
+  }
+  if (!skeleton)
+  {
+    engine::error("Compression report: no animations found");
+    return;
+  }
+
+  const int numJoints = skeleton->num_joints();
+  std::vector<bool> isEffector(numJoints, true);
+  std::vector<bool> isFoot(numJoints, false);
+  for (int i = 0; i < numJoints; i++)
+  {
+    const int parent = skeleton->joint_parents()[i];
+    if (parent >= 0)
+      isEffector[parent] = false;
+    std::string_view name = skeleton->joint_names()[i];
+    isFoot[i] = name.find("Foot") != std::string_view::npos || name.find("Toe") != std::string_view::npos;
+  }
+
+  // reference is the same clip built without keyframe reduction
+  const int numStats = profiles.size() + 1;
+  std::vector<std::vector<ProfileStats>> clipStats(paths.size(), std::vector<ProfileStats>(numStats));
+  std::atomic<size_t> nextClip = firstClip;
+
+  auto worker = [&]()
+  {
+    // one sampler per profile, so sampling contexts stay warm as they would at runtime
+    ClipSampler referenceSampler(*skeleton);
+    std::vector<std::unique_ptr<ClipSampler>> samplers(profiles.size());
+    for (auto &sampler : samplers)
+      sampler = std::make_unique<ClipSampler>(*skeleton);
+    std::vector<ozz::math::Float4x4> referenceModels(numJoints), models(numJoints);
+    for (size_t clipIdx = nextClip++; clipIdx < paths.size(); clipIdx = nextClip++)
+    {
+      RawAnimation rawAnimation;
+      // clips are measured in place, as they are stored in the database
+      RootMotionTrack rootMotion;
+      // skeleton is already built, so it is only read here
+      if (!load_raw_animation(paths[clipIdx], skeleton, rawAnimation, &rootMotion))
+        continue;
+
+      ozz::animation::offline::AnimationBuilder builder;
+      AnimationPtr reference = builder(rawAnimation);
+      std::vector<AnimationPtr> optimized(profiles.size());
+      for (size_t p = 0; p < profiles.size(); p++)
+      {
+        RawAnimation optimizedAnimation;
+        profiles[p].make_optimizer(*skeleton)(rawAnimation, *skeleton, &optimizedAnimation);
+        optimized[p] = builder(optimizedAnimation);
+      }
+
+      std::vector<ProfileStats> &stats = clipStats[clipIdx];
+      stats[0].size = reference->size();
+      for (size_t p = 0; p < profiles.size(); p++)
+        stats[p + 1].size = optimized[p]->size();
+
+      const float FPS = 30.f;
+      const int numFrames = std::max(static_cast<int>(reference->duration() * FPS), 1);
+      for (int frame = 0; frame <= numFrames; frame++)
+      {
+        const float ratio = float(frame) / numFrames;
+        stats[0].samplingTime += referenceSampler.sample(*reference, ratio, referenceModels);
+        stats[0].samples++;
+        for (size_t p = 0; p < profiles.size(); p++)
+        {
+          ProfileStats &s = stats[p + 1];
+          s.samplingTime += samplers[p]->sample(*optimized[p], ratio, models);
+          s.samples++;
+          for (int j = 0; j < numJoints; j++)
+          {
+            if (!isEffector[j] && !isFoot[j])
+              continue;
+            const float error = distance(referenceModels[j], models[j]);
+            if (isEffector[j])
+              s.maxEffectorError = std::max(s.maxEffectorError, error);
+            if (isFoot[j])
+              s.maxFootError = std::max(s.maxFootError, error);
+          }
+        }
+      }
+    }
+  };
+
+  const int numThreads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::thread> threads;
+  for (int i = 0; i < numThreads; i++)
+    threads.emplace_back(worker);
+  for (std::thread &thread : threads)
+    thread.join();
+
+  std::vector<ProfileStats> total(numStats);
+  for (const std::vector<ProfileStats> &stats : clipStats)
+    for (int p = 0; p < numStats; p++)
+    {
+      total[p].size += stats[p].size;
+      total[p].maxEffectorError = std::max(total[p].maxEffectorError, stats[p].maxEffectorError);
+      total[p].maxFootError = std::max(total[p].maxFootError, stats[p].maxFootError);
+      total[p].samplingTime += stats[p].samplingTime;
+      total[p].samples += stats[p].samples;
+    }
+
+  std::ofstream report(output_path);
+  auto print_row = [&](const char *format, auto... args)
+  {
+    char row[256];
+    snprintf(row, sizeof(row), format, args...);
+    report << row << '\n';
+    engine::log("%s", row);
+  };
+  print_row("| profile | size KB | size %% | max effector error mm | max foot error mm | sampling us |");
+  print_row("|---|---|---|---|---|---|");
+  for (int p = 0; p < numStats; p++)
+  {
+    const ProfileStats &s = total[p];
+    const char *name = p == 0 ? "no reduction" : profiles[p - 1].name.c_str();
+    print_row("| %s | %.1f | %.1f | %.3f | %.3f | %.2f |",
+      name,
+      s.size / 1024.f,
+      total[0].size ? 100.f * s.size / total[0].size : 0.f,
+      s.maxEffectorError * 1000.f,
+      s.maxFootError * 1000.f,
+      s.samples ? s.samplingTime / s.samples : 0.0);
+  }
+  engine::log("Compression report \"%s\" built. %f ms", output_path.c_str(), timer.elapsed_ms());
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace ozz::animation
+{
+class Skeleton;
+namespace offline
+{
+class AnimationOptimizer;
+}
+} // namespace ozz::animation
+
+// Joints which name contains pattern use these optimizer settings instead of the profile defaults.
+// tolerance - max error in meters at distance from the joint, see ozz::animation::offline::AnimationOptimizer::Setting
+struct JointCompressionRule
+{
+  std::string pattern;
+  float tolerance;
+  float distance;
+};
+
+struct AnimationCompressionProfile
+{
+  std::string name = "ozz default";
+  float tolerance = 1e-3f; // 1mm
+  float distance = 1e-1f;  // 10cm
+  std::vector<JointCompressionRule> rules; // first matching rule wins
+
+  ozz::animation::offline::AnimationOptimizer make_optimizer(const ozz::animation::Skeleton &skeleton) const;
+
+  // copy with all tolerances multiplied by scale, distances are kept
+  AnimationCompressionProfile scaled(float scale) const;
+};
+
+// strict feet and hips to avoid foot sliding, loose fingers
+AnimationCompressionProfile default_compression_profile();
+
+// Builds every clip from paths with each profile in parallel and writes a markdown table with
+// runtime size, max model space error of end effectors and feet, and sampling time per profile.
+void build_compression_report(
+  const std::vector<std::string> &paths,
+  const std::vector<AnimationCompressionProfile> &profiles,
+  const std::string &output_path);
@@ -1,26 +1,116 @@
 #include "render/mesh.h"
 #include <vector>
+#include <algorithm>
 #include <3dmath.h>
 #include <assimp/scene.h>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include "engine/api.h"
+#include "engine/memory.h"
+#include "engine/replay.h"
 #include "glad/glad.h"
 #include "timer.h"
+#include <filesystem>
+#include <fstream>
 
 #include "import/model.h"
+#include "import/mesh_lod.h"
+#include "import/mesh_optimize.h"
 
-MeshPtr create_mesh(const aiMesh *mesh)
+// LOD index buffers are cooked next to the model and rebuilt when the source mesh changes
+static const uint32_t MESH_LOD_MAGIC = 0x53444F4C; // "LODS"
+// bump when the simplifier or the optimizer changes, cooked files of older versions are rebuilt
+static const uint32_t MESH_LOD_VERSION = 3;
+static const int MAX_MESH_LODS = 4;
+
+struct CookedMeshLods
+{
+  uint64_t sourceHash = 0;
+  std::vector<MeshLod> lods;
+  std::vector<uint32_t> indices; // of all levels
+  std::vector<uint32_t> vertexOrder; // welded vertices in the fetch order
+};
+
+static std::string get_mesh_lods_path(const char *model_path)
+{
+  return std::filesystem::path(model_path).replace_extension(".lods").string();
+}
+
+static std::vector<CookedMeshLods> load_mesh_lods(const std::string &path)
+{
+  std::vector<CookedMeshLods> meshes;
+  std::ifstream file(path, std::ios::binary);
+  uint32_t magic = 0, version = 0, meshCount = 0;
+  if (!file.read(reinterpret_cast<char *>(&magic), sizeof(magic)) || !file.read(reinterpret_cast<char *>(&version), sizeof(version)) ||
+    magic != MESH_LOD_MAGIC || version != MESH_LOD_VERSION || !file.read(reinterpret_cast<char *>(&meshCount), sizeof(meshCount)))
+    return meshes;
+  meshes.resize(meshCount);
+  for (CookedMeshLods &mesh : meshes)
+  {
+    uint32_t lodCount = 0, indexCount = 0;
+    file.read(reinterpret_cast<char *>(&mesh.sourceHash), sizeof(mesh.sourceHash));
+    file.read(reinterpret_cast<char *>(&lodCount), sizeof(lodCount));
+    mesh.lods.resize(file ? lodCount : 0);
+    file.read(reinterpret_cast<char *>(mesh.lods.data()), mesh.lods.size() * sizeof(MeshLod));
+    file.read(reinterpret_cast<char *>(&indexCount), sizeof(indexCount));
+    mesh.indices.resize(file ? indexCount : 0);
+    file.read(reinterpret_cast<char *>(mesh.indices.data()), mesh.indices.size() * sizeof(uint32_t));
+    uint32_t vertexCount = 0;
+    file.read(reinterpret_cast<char *>(&vertexCount), sizeof(vertexCount));
+    mesh.vertexOrder.resize(file ? vertexCount : 0);
+    file.read(reinterpret_cast<char *>(mesh.vertexOrder.data()), mesh.vertexOrder.size() * sizeof(uint32_t));
+    if (!file)
+    {
+      engine::error("Mesh LODs \"%s\" are truncated", path.c_str());
+      return {};
+    }
+  }
+  return meshes;
+}
+
+static void save_mesh_lods(const std::string &path, const std::vector<CookedMeshLods> &meshes)
+{
+  std::ofstream file(path, std::ios::binary);
+  if (!file)
+  {
+    engine::error("Failed to write mesh LODs to \"%s\"", path.c_str());
+    return;
+  }
+  const uint32_t header[3] = {MESH_LOD_MAGIC, MESH_LOD_VERSION, uint32_t(meshes.size())};
+  file.write(reinterpret_cast<const char *>(header), sizeof(header));
+  for (const CookedMeshLods &mesh : meshes)
+  {
+    const uint32_t lodCount = mesh.lods.size(), indexCount = mesh.indices.size(), vertexCount = mesh.vertexOrder.size();
+    file.write(reinterpret_cast<const char *>(&mesh.sourceHash), sizeof(mesh.sourceHash));
+    file.write(reinterpret_cast<const char *>(&lodCount), sizeof(lodCount));
+    file.write(reinterpret_cast<const char *>(mesh.lods.data()), lodCount * sizeof(MeshLod));
+    file.write(reinterpret_cast<const char *>(&indexCount), sizeof(indexCount));
+    file.write(reinterpret_cast<const char *>(mesh.indices.data()), indexCount * sizeof(uint32_t));
+    file.write(reinterpret_cast<const char *>(&vertexCount), sizeof(vertexCount));
+    file.write(reinterpret_cast<const char *>(mesh.vertexOrder.data()), vertexCount * sizeof(uint32_t));
+  }
+}
+
+template <typename T>
+static uint64_t hash_span(std::span<const T> data, uint64_t hash)
+{
+  return engine::hash_bytes(data.data(), data.size_bytes(), hash);
+}
+
+// cooked is reused when it was built from the same data, otherwise LODs are rebuilt into it and cooked_changed is set
+MeshPtr create_mesh(const aiMesh *mesh, CookedMeshLods &cooked, bool &cooked_changed)
 {
   std::vector<uint32_t> indices;
-  std::vector<vec3> vertices;
-  std::vector<vec3> normals;
-  std::vector<vec2> uv;
-  std::vector<uvec4> boneIndexes;
-  std::vector<vec4> boneWeights;
+  VertexStreams streams;
+  std::vector<vec3> &vertices = streams.vertices;
+  std::vector<vec3> &normals = streams.normals;
+  std::vector<vec2> &uv = streams.uv;
+  std::vector<uvec4> &boneIndexes = streams.boneIndexes;
+  std::vector<vec4> &boneWeights = streams.boneWeights;
   std::vector<mat4> inverseBindPose;
   std::vector<std::string> bonesNames;
   std::map<std::string, int> bonesMap;
+  std::vector<BoundingBox> boneBounds;
 
   int numVert = mesh->mNumVertices;
   int numFaces = mesh->mNumFaces;
@@ -90,8 +180,53 @@ MeshPtr create_mesh(const aiMesh *mesh)
       float s = w.x + w.y + w.z + w.w;
       boneWeights[i] *= 1.f / s;
     }
+
+    // vertices barely moved by a bone don't widen its box
+    const float boundsWeightThreshold = 0.05f;
+    boneBounds.resize(numBones);
+    for (int i = 0; i < numVert; i++)
+      for (int j = 0; j < 4; j++)
+        if (boneWeights[i][j] > boundsWeightThreshold)
+        {
+          const int bone = boneIndexes[i][j];
+          boneBounds[bone].add(vec3(inverseBindPose[bone] * vec4(vertices[i], 1.f)));
+        }
+  }
+
+  // assimp splits vertices per face corner, welding them makes the mesh connected for the simplifier and the cache
+  const float sourceAcmr = compute_acmr(indices, vertices.size());
+  weld_vertices(streams, indices);
+
+  uint64_t sourceHash = engine::hash_bytes(nullptr, 0);
+  sourceHash = hash_span<uint32_t>(indices, sourceHash);
+  sourceHash = hash_span<vec3>(vertices, sourceHash);
+  sourceHash = hash_span<vec3>(normals, sourceHash);
+  sourceHash = hash_span<vec2>(uv, sourceHash);
+  sourceHash = hash_span<vec4>(boneWeights, sourceHash);
+  sourceHash = hash_span<uvec4>(boneIndexes, sourceHash);
+  if (cooked.lods.empty() || cooked.sourceHash != sourceHash)
+  {
+    Timer timer;
+    const SimplifyMesh simplifyMesh = {vertices, uv, boneWeights, boneIndexes};
+    build_mesh_lods(simplifyMesh, indices, MAX_MESH_LODS, cooked.indices, cooked.lods);
+    // every level is drawn on its own, so each one gets its own triangle order
+    for (const MeshLod &lod : cooked.lods)
+    {
+      std::span<uint32_t> lodIndices(cooked.indices.data() + lod.firstIndex, lod.numIndices);
+      optimize_vertex_cache(lodIndices, vertices.size());
+      optimize_overdraw(lodIndices, vertices);
+    }
+    cooked.vertexOrder = optimize_vertex_fetch(cooked.indices, vertices.size());
+    cooked.sourceHash = sourceHash;
+    cooked_changed = true;
+    engine::log("Mesh \"%s\" simplified to %zu LODs, %u -> %u triangles. %f ms", mesh->mName.C_Str(), cooked.lods.size(),
+      cooked.lods.front().numIndices / 3, cooked.lods.back().numIndices / 3, timer.elapsed_ms());
+    engine::log("Mesh \"%s\" optimized, %d -> %zu vertices, ACMR %.3f -> %.3f", mesh->mName.C_Str(), numVert,
+      cooked.vertexOrder.size(), sourceAcmr, compute_acmr(std::span(cooked.indices.data(), cooked.lods.front().numIndices), cooked.vertexOrder.size()));
   }
-  return create_mesh(mesh->mName.C_Str(), indices, vertices, normals, uv, boneWeights, boneIndexes, std::move(inverseBindPose), std::move(bonesNames), std::move(bonesMap));
+  reorder_vertices(streams, cooked.vertexOrder);
+  std::vector<MeshLod> lods = cooked.lods;
+  return create_mesh(mesh->mName.C_Str(), cooked.indices, vertices, normals, uv, boneWeights, boneIndexes, std::move(inverseBindPose), std::move(bonesNames), std::move(bonesMap), std::move(boneBounds), std::move(lods));
 }
 
 #include <ozz/animation/offline/raw_skeleton.h>
@@ -100,6 +235,7 @@ MeshPtr create_mesh(const aiMesh *mesh)
 #include <ozz/animation/offline/raw_animation.h>
 #include <ozz/animation/offline/animation_builder.h>
 #include <ozz/animation/offline/animation_optimizer.h>
+#include <ozz/animation/runtime/local_to_model_job.h>
 #include <ozz/base/io/archive.h>
 #include <ozz/base/io/stream.h>
 
@@ -141,11 +277,113 @@ static void load_skeleton(Joint &joint, SkeletonOffline &skeleton, const aiNode
   }
 }
 
-AnimationPtr create_animation(const aiAnimation *animation, const SkeletonPtr &skeleton, ozz::animation::offline::AnimationOptimizer optimizer = ozz::animation::offline::AnimationOptimizer())
+// joint which carries the character displacement in root motion clips
+static const char *ROOT_MOTION_JOINT = "Hips";
+
+template <typename Key, typename Lerp>
+static auto sample_keys(const ozz::vector<Key> &keys, float time, Lerp &&lerp)
 {
-  // Creates a RawAnimation.
-  ozz::animation::offline::RawAnimation raw_animation;
+  auto next = std::upper_bound(keys.begin(), keys.end(), time, [](float t, const Key &key) { return t < key.time; });
+  if (next == keys.begin())
+    return keys.front().value;
+  if (next == keys.end())
+    return keys.back().value;
+  auto prev = next - 1;
+  float t = (time - prev->time) / (next->time - prev->time);
+  return lerp(prev->value, next->value, t);
+}
+
+static vec3 sample_translation(const ozz::animation::offline::RawAnimation::JointTrack &track, float time)
+{
+  ozz::math::Float3 v = sample_keys(track.translations, time, [](const ozz::math::Float3 &a, const ozz::math::Float3 &b, float t) { return ozz::math::Lerp(a, b, t); });
+  return vec3(v.x, v.y, v.z);
+}
+
+static quat sample_rotation(const ozz::animation::offline::RawAnimation::JointTrack &track, float time)
+{
+  ozz::math::Quaternion q = sample_keys(track.rotations, time, [](const ozz::math::Quaternion &a, const ozz::math::Quaternion &b, float t) { return ozz::math::NLerp(a, b, t); });
+  return quat(q.w, q.x, q.y, q.z);
+}
 
+// Moves horizontal displacement of the root joint from the raw animation into a RootMotionTrack.
+// The pose keeps its rotation, the track only records yaw for trajectory queries.
+static bool extract_root_motion(ozz::animation::offline::RawAnimation &raw_animation, const ozz::animation::Skeleton &skeleton, RootMotionTrack &root_motion)
+{
+  const int rootIdx = ozz::animation::FindJoint(skeleton, ROOT_MOTION_JOINT);
+  if (rootIdx < 0)
+  {
+    engine::error("Root motion joint \"%s\" not found, \"%s\" is kept as is", ROOT_MOTION_JOINT, raw_animation.name.c_str());
+    return false;
+  }
+  ozz::animation::offline::RawAnimation::JointTrack &track = raw_animation.tracks[rootIdx];
+  if (track.translations.empty() || track.rotations.empty())
+    return false;
+
+  // root joint translation is local to its parent, which is not animated in our clips
+  glm::mat4 parentTransform = glm::identity<glm::mat4>();
+  const int parentIdx = skeleton.joint_parents()[rootIdx];
+  if (parentIdx >= 0)
+  {
+    std::vector<ozz::math::Float4x4> restTransforms(skeleton.num_joints());
+    ozz::animation::LocalToModelJob localToModelJob;
+    localToModelJob.skeleton = &skeleton;
+    localToModelJob.input = skeleton.joint_rest_poses();
+    localToModelJob.output = ozz::make_span(restTransforms);
+    const bool success = localToModelJob.Run();
+    assert(success);
+    memcpy(&parentTransform, &restTransforms[parentIdx], sizeof(parentTransform));
+  }
+  const glm::mat3 parentLinear = glm::mat3(parentTransform);
+  const glm::quat parentRotation = glm::quat_cast(glm::mat3(normalize(parentLinear[0]), normalize(parentLinear[1]), normalize(parentLinear[2])));
+  const glm::mat3 inverseParentLinear = inverse(parentLinear);
+
+  auto model_position = [&](float time) { return vec3(parentTransform * vec4(sample_translation(track, time), 1.f)); };
+  const vec3 startPosition = model_position(0.f);
+
+  // resample uniformly at the key rate of the root translation track
+  const int numSamples = std::max((int)track.translations.size(), 2);
+  root_motion.name = raw_animation.name.c_str();
+  root_motion.duration = raw_animation.duration;
+  root_motion.positions.resize(numSamples);
+  root_motion.yaws.resize(numSamples);
+  for (int i = 0; i < numSamples; i++)
+  {
+    const float time = raw_animation.duration * i / (numSamples - 1);
+    const vec3 offset = model_position(time) - startPosition;
+    root_motion.positions[i] = vec2(offset.x, offset.z);
+
+    const vec3 forward = (parentRotation * sample_rotation(track, time)) * vec3(0.f, 0.f, 1.f);
+    float yaw = atan2f(forward.x, forward.z);
+    if (i > 0)
+    {
+      float delta = yaw - root_motion.yaws[i - 1];
+      yaw = root_motion.yaws[i - 1] + (delta - PITWO * floorf((delta + PI) / PITWO));
+    }
+    root_motion.yaws[i] = yaw;
+  }
+
+  // leave only vertical motion in the pose
+  std::vector<vec3> offsets(track.translations.size());
+  for (size_t i = 0; i < track.translations.size(); i++)
+  {
+    const auto &key = track.translations[i];
+    vec3 modelOffset = vec3(parentTransform * vec4(key.value.x, key.value.y, key.value.z, 1.f)) - startPosition;
+    offsets[i] = inverseParentLinear * vec3(modelOffset.x, 0.f, modelOffset.z);
+  }
+  for (size_t i = 0; i < track.translations.size(); i++)
+  {
+    auto &value = track.translations[i].value;
+    value = ozz::math::Float3(value.x - offsets[i].x, value.y - offsets[i].y, value.z - offsets[i].z);
+  }
+  return true;
+}
+
+static void create_raw_animation(
+  const aiAnimation *animation,
+  const SkeletonPtr &skeleton,
+  ozz::animation::offline::RawAnimation &raw_animation,
+  RootMotionTrack *root_motion)
+{
   raw_animation.name = animation->mName.C_Str();
   // Sets animation duration.
   // All the animation keyframes times must be within range [0, duration].
@@ -228,6 +466,9 @@ AnimationPtr create_animation(const aiAnimation *animation, const SkeletonPtr &s
     }
   }
 
+  if (root_motion)
+    extract_root_motion(raw_animation, *skeleton, *root_motion);
+
   // Test for animation validity. These are the errors that could invalidate
   // an animation:
   //  1. Animation duration is less than 0.
@@ -236,6 +477,17 @@ AnimationPtr create_animation(const aiAnimation *animation, const SkeletonPtr &s
   if (!raw_animation.Validate()) {
     assert(false);
   }
+}
+
+AnimationPtr create_animation(
+  const aiAnimation *animation,
+  const SkeletonPtr &skeleton,
+  ozz::animation::offline::AnimationOptimizer optimizer = ozz::animation::offline::AnimationOptimizer(),
+  RootMotionTrack *root_motion = nullptr)
+{
+  // Creates a RawAnimation.
+  ozz::animation::offline::RawAnimation raw_animation;
+  create_raw_animation(animation, skeleton, raw_animation, root_motion);
 
   // Creates a AnimationBuilder instance.
   ozz::animation::offline::AnimationBuilder builder;
@@ -249,8 +501,6 @@ AnimationPtr create_animation(const aiAnimation *animation, const SkeletonPtr &s
 
   AnimationPtr animationPtr = builder(optimized_animation);
 
-  AnimationPtr optimizedAnimation;
-
   engine::log("Animation \"%s\" loaded", animation->mName.C_Str());
 
   return animationPtr;
@@ -297,14 +547,21 @@ ModelAsset load_model(const char *path)
   // a new runtime skeleton instance.
   // This operation will fail and return an empty unique_ptr if the RawSkeleton
   // isn't valid.
+  engine::MemoryTagScope memoryTag(engine::MemoryTag::AnimationClips);
   SkeletonPtr skeleton = builder(raw_skeleton);
   model.skeleton.skeleton = std::move(skeleton);
 
+  const std::string lodsPath = get_mesh_lods_path(path);
+  std::vector<CookedMeshLods> cookedLods = load_mesh_lods(lodsPath);
+  cookedLods.resize(scene->mNumMeshes);
+  bool cookedChanged = false;
   model.meshes.resize(scene->mNumMeshes);
   for (uint32_t i = 0; i < scene->mNumMeshes; i++)
   {
-    model.meshes[i] = create_mesh(scene->mMeshes[i]);
+    model.meshes[i] = create_mesh(scene->mMeshes[i], cookedLods[i], cookedChanged);
   }
+  if (cookedChanged)
+    save_mesh_lods(lodsPath, cookedLods);
 
   model.animations.resize(scene->mNumAnimations);
   for (uint32_t i = 0; i < scene->mNumAnimations; i++)
@@ -316,49 +573,178 @@ ModelAsset load_model(const char *path)
   return model;
 }
 
-void build_animations(const std::vector<std::string> &paths, const std::string &output_path)
+static void collect_collision_geometry(const aiScene &scene, const aiNode &node, const aiMatrix4x4 &parent_transform,
+  std::vector<CollisionGeometry> &geometry)
+{
+  const aiMatrix4x4 transform = parent_transform * node.mTransformation;
+  for (uint32_t i = 0; i < node.mNumMeshes; i++)
+  {
+    const aiMesh *mesh = scene.mMeshes[node.mMeshes[i]];
+    if (!mesh->HasFaces() || !mesh->HasPositions())
+      continue;
+    CollisionGeometry &collision = geometry.emplace_back();
+    collision.name = mesh->mName.C_Str();
+    collision.vertices.resize(mesh->mNumVertices);
+    for (uint32_t j = 0; j < mesh->mNumVertices; j++)
+      collision.vertices[j] = to_vec3(transform * mesh->mVertices[j]);
+    collision.indices.reserve(mesh->mNumFaces * 3);
+    for (uint32_t j = 0; j < mesh->mNumFaces; j++)
+    {
+      // lines and points left by triangulation don't collide
+      const aiFace &face = mesh->mFaces[j];
+      if (face.mNumIndices == 3)
+        collision.indices.insert(collision.indices.end(), face.mIndices, face.mIndices + 3);
+    }
+  }
+  for (uint32_t i = 0; i < node.mNumChildren; i++)
+    collect_collision_geometry(scene, *node.mChildren[i], transform, geometry);
+}
+
+std::vector<CollisionGeometry> load_collision_geometry(const char *path)
+{
+  Timer timer;
+  Assimp::Importer importer;
+  importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_PRESERVE_PIVOTS, false);
+  importer.SetPropertyFloat(AI_CONFIG_GLOBAL_SCALE_FACTOR_KEY, 1.f);
+
+  // no normals, uvs or bones, winding is kept counter clockwise as physics expects
+  importer.ReadFile(path,
+    aiPostProcessSteps::aiProcess_Triangulate |
+    aiPostProcessSteps::aiProcess_JoinIdenticalVertices |
+    aiPostProcessSteps::aiProcess_GlobalScale);
+
+  std::vector<CollisionGeometry> geometry;
+  const aiScene *scene = importer.GetScene();
+  if (!scene)
+  {
+    engine::error("Filed to read model file \"%s\"", path);
+    return geometry;
+  }
+  collect_collision_geometry(*scene, *scene->mRootNode, aiMatrix4x4(), geometry);
+  engine::log("Collision geometry of \"%s\" loaded, %zu meshes. %f ms", path, geometry.size(), timer.elapsed_ms());
+  return geometry;
+}
+
+// Root motion tracks are stored after the last animation of the archive
+static const uint32_t ROOT_MOTION_SECTION_TAG = 0x544F4D52; // "RMOT"
+static const uint32_t ROOT_MOTION_SECTION_VERSION = 1;
+
+static void save_root_motions(ozz::io::OArchive &archive, const std::vector<RootMotionTrack> &root_motions)
+{
+  archive << ROOT_MOTION_SECTION_TAG << ROOT_MOTION_SECTION_VERSION;
+  archive << static_cast<uint32_t>(root_motions.size());
+  for (const RootMotionTrack &track : root_motions)
+  {
+    archive << static_cast<uint32_t>(track.name.size());
+    archive << ozz::io::MakeArray(track.name.data(), track.name.size());
+    archive << track.duration;
+    archive << static_cast<uint32_t>(track.positions.size());
+    archive << ozz::io::MakeArray(reinterpret_cast<const float *>(track.positions.data()), track.positions.size() * 2);
+    archive << ozz::io::MakeArray(track.yaws.data(), track.yaws.size());
+  }
+}
+
+static void load_root_motions(ozz::io::IArchive &archive, ozz::io::Stream &stream, AnimationDataBase &data)
+{
+  if (stream.Tell() >= static_cast<int>(stream.Size()))
+    return;
+  uint32_t tag = 0, version = 0, count = 0;
+  archive >> tag >> version;
+  if (tag != ROOT_MOTION_SECTION_TAG || version != ROOT_MOTION_SECTION_VERSION)
+  {
+    engine::error("Animation Database \"%s\" has unsupported root motion section, rebuild it", data.path.c_str());
+    return;
+  }
+  archive >> count;
+  data.rootMotions.resize(count);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    RootMotionTrack &track = data.rootMotions[i];
+    uint32_t nameLength = 0, numSamples = 0;
+    archive >> nameLength;
+    track.name.resize(nameLength);
+    archive >> ozz::io::MakeArray(track.name.data(), nameLength);
+    archive >> track.duration;
+    archive >> numSamples;
+    track.positions.resize(numSamples);
+    track.yaws.resize(numSamples);
+    archive >> ozz::io::MakeArray(reinterpret_cast<float *>(track.positions.data()), numSamples * 2);
+    archive >> ozz::io::MakeArray(track.yaws.data(), numSamples);
+    data.rootMotionMap[track.name] = i;
+  }
+}
+
+bool load_raw_animation(const std::string &path, SkeletonPtr &skeleton, ozz::animation::offline::RawAnimation &raw_animation, RootMotionTrack *root_motion)
+{
+  Assimp::Importer importer;
+  importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_PRESERVE_PIVOTS, false);
+  importer.SetPropertyFloat(AI_CONFIG_GLOBAL_SCALE_FACTOR_KEY, 1.f);
+
+  importer.ReadFile(path,
+    aiPostProcessSteps::aiProcess_LimitBoneWeights |
+    aiPostProcessSteps::aiProcess_GlobalScale);
+
+  const aiScene *scene = importer.GetScene();
+  if (!scene || scene->mNumAnimations == 0)
+  {
+    return false;
+  }
+
+  if (!skeleton)
+  {
+    SkeletonOffline helperSkeleton;
+    RawSkeleton raw_skeleton;
+    raw_skeleton.roots.resize(1);
+    load_skeleton(raw_skeleton.roots[0], helperSkeleton, *scene->mRootNode, -1, 0);
+    if (!raw_skeleton.Validate())
+    {
+      assert(false);
+    }
+    ozz::animation::offline::SkeletonBuilder builder;
+    skeleton = builder(raw_skeleton);
+  }
+  create_raw_animation(scene->mAnimations[0], skeleton, raw_animation, root_motion);
+  return true;
+}
+
+void build_animations(const std::vector<std::string> &paths, const std::string &output_path, const AnimationCompressionProfile &profile)
 {
   Timer timer;
 
   SkeletonPtr skeleton;
   ozz::io::File output(output_path.c_str(), "wb");
   ozz::io::OArchive outputArchive(&output);
+  std::vector<RootMotionTrack> rootMotions;
+  ozz::animation::offline::AnimationOptimizer optimizer;
+  size_t totalSize = 0;
 
   for (const std::string &path : paths)
   {
-    Assimp::Importer importer;
-    importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_PRESERVE_PIVOTS, false);
-    importer.SetPropertyFloat(AI_CONFIG_GLOBAL_SCALE_FACTOR_KEY, 1.f);
-
-    importer.ReadFile(path,
-      aiPostProcessSteps::aiProcess_LimitBoneWeights |
-      aiPostProcessSteps::aiProcess_GlobalScale);
-
-    const aiScene *scene = importer.GetScene();
-    if (!scene)
+    ozz::animation::offline::RawAnimation rawAnimation;
+    RootMotionTrack rootMotion;
+    const bool hadSkeleton = skeleton != nullptr;
+    if (!load_raw_animation(path, skeleton, rawAnimation, &rootMotion))
     {
       continue;
     }
-
-    if (!skeleton)
+    if (!hadSkeleton)
     {
-      SkeletonOffline helperSkeleton;
-      RawSkeleton raw_skeleton;
-      raw_skeleton.roots.resize(1);
-      load_skeleton(raw_skeleton.roots[0], helperSkeleton, *scene->mRootNode, -1, 0);
-      if (!raw_skeleton.Validate())
-      {
-        assert(false);
-      }
-      ozz::animation::offline::SkeletonBuilder builder;
-      skeleton = builder(raw_skeleton);
       outputArchive << *skeleton;
+      optimizer = profile.make_optimizer(*skeleton);
     }
-    ozz::animation::offline::AnimationOptimizer defaultOptimizer;
-    AnimationPtr animation = create_animation(scene->mAnimations[0], skeleton, defaultOptimizer);
+
+    ozz::animation::offline::RawAnimation optimizedAnimation;
+    optimizer(rawAnimation, *skeleton, &optimizedAnimation);
+    ozz::animation::offline::AnimationBuilder builder;
+    AnimationPtr animation = builder(optimizedAnimation);
+    totalSize += animation->size();
 
     outputArchive << *animation;
+    if (!rootMotion.positions.empty())
+      rootMotions.push_back(std::move(rootMotion));
   }
+  engine::log("Animations compressed with \"%s\" profile, %.1f KB", profile.name.c_str(), totalSize / 1024.f);
+  save_root_motions(outputArchive, rootMotions);
   engine::log("Animation Database \"%s\" built. %f ms", output_path.c_str(), timer.elapsed_ms());
 }
 
@@ -366,6 +752,7 @@ void build_animations(const std::vector<std::string> &paths, const std::string &
 AnimationDataBase load_animations(const std::string &path)
 {
   Timer timer;
+  engine::MemoryTagScope memoryTag(engine::MemoryTag::AnimationClips);
   AnimationDataBase data;
   data.path = path;
   ozz::io::File input(path.c_str(), "rb");
@@ -394,6 +781,7 @@ AnimationDataBase load_animations(const std::string &path)
     data.animationMap[animation->name()] = data.animations.size();
     data.animations.push_back(std::move(animation));
   }
+  load_root_motions(archive, input, data);
   engine::log("Animation Database \"%s\" loaded. %f ms", path.c_str(), timer.elapsed_ms());
   return data;
 }
\ No newline at end of file
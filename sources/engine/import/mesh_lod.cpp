@@ -0,0 +1,341 @@
+#include "import/mesh_lod.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
+// weighted sum of squared distances to the planes of adjacent triangles, symmetric 4x4 matrix
+struct Quadric
+{
+  double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+  double weightSum = 0;
+
+  void add_plane(const vec3 &n, float d, float weight)
+  {
+    weightSum += weight;
+    a2 += weight * n.x * n.x; ab += weight * n.x * n.y; ac += weight * n.x * n.z; ad += weight * n.x * d;
+    b2 += weight * n.y * n.y; bc += weight * n.y * n.z; bd += weight * n.y * d;
+    c2 += weight * n.z * n.z; cd += weight * n.z * d;
+    d2 += weight * d * d;
+  }
+
+  void add(const Quadric &q)
+  {
+    a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad; b2 += q.b2; bc += q.bc; bd += q.bd; c2 += q.c2; cd += q.cd; d2 += q.d2;
+    weightSum += q.weightSum;
+  }
+
+  // mean squared distance to the planes, weighted by triangle area, in squared meters
+  double error(const vec3 &p) const
+  {
+    if (weightSum <= 0)
+      return 0.0;
+    const double x = p.x, y = p.y, z = p.z;
+    const double e = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x +
+      b2 * y * y + 2 * bc * y * z + 2 * bd * y + c2 * z * z + 2 * cd * z + d2;
+    return std::max(e / weightSum, 0.0);
+  }
+};
+
+struct Collapse
+{
+  double cost;
+  uint32_t from, to;
+  bool operator>(const Collapse &other) const { return cost > other.cost; }
+};
+
+class MeshSimplifier
+{
+  const SimplifyMesh &mesh;
+  std::vector<uint32_t> triangles;      // 3 per triangle, rewritten by collapses
+  std::vector<uint8_t> triangleRemoved;
+  std::vector<std::vector<uint32_t>> vertexTriangles;
+  std::vector<uint32_t> position;       // vertices with equal positions share a position id
+  std::vector<Quadric> quadrics;        // per position id
+  std::vector<float> deviation;         // per position id, bound of the distance from the source surface around it
+  std::vector<uint8_t> locked;
+  std::vector<uint8_t> vertexRemoved;
+  std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+  float radius = 0.f;
+  size_t aliveTriangles = 0;
+
+  float bone_weight(uint32_t v, uint32_t bone) const
+  {
+    float weight = 0.f;
+    for (int i = 0; i < 4; i++)
+      if (mesh.weightsIndex[v][i] == bone)
+        weight += mesh.weights[v][i];
+    return weight;
+  }
+
+  // L1 distance of skin weights over the bones of both vertices, in squared meters like the quadric error,
+  // fully different weights cost as much as moving 5% of the radius off the surface
+  double skin_penalty(uint32_t a, uint32_t b) const
+  {
+    if (mesh.weights.empty())
+      return 0.0;
+    float difference = 0.f;
+    for (int i = 0; i < 4; i++)
+    {
+      if (mesh.weights[a][i] > 0.f)
+        difference += std::abs(mesh.weights[a][i] - bone_weight(b, mesh.weightsIndex[a][i]));
+      if (mesh.weights[b][i] > 0.f && bone_weight(a, mesh.weightsIndex[b][i]) == 0.f)
+        difference += mesh.weights[b][i];
+    }
+    const double scale = 0.05 * radius;
+    return difference * scale * scale;
+  }
+
+  // squared meters, a uv distance of 1 costs as much as moving 1% of the radius off the surface
+  double uv_penalty(uint32_t a, uint32_t b) const
+  {
+    if (mesh.uv.empty())
+      return 0.0;
+    const vec2 d = mesh.uv[a] - mesh.uv[b];
+    const double scale = 0.01 * radius;
+    return double(dot(d, d)) * scale * scale;
+  }
+
+  double collapse_cost(uint32_t from, uint32_t to) const
+  {
+    return quadrics[position[from]].error(mesh.vertices[to]) + skin_penalty(from, to) + uv_penalty(from, to);
+  }
+
+  void push_collapses(uint32_t v)
+  {
+    for (uint32_t t : vertexTriangles[v])
+    {
+      if (triangleRemoved[t])
+        continue;
+      for (int k = 0; k < 3; k++)
+      {
+        const uint32_t w = triangles[t * 3 + k];
+        if (w == v)
+          continue;
+        if (!locked[v])
+          queue.push({collapse_cost(v, w), v, w});
+        if (!locked[w])
+          queue.push({collapse_cost(w, v), w, v});
+      }
+    }
+  }
+
+  bool has_edge(uint32_t from, uint32_t to) const
+  {
+    for (uint32_t t : vertexTriangles[from])
+      if (!triangleRemoved[t] && (triangles[t * 3] == to || triangles[t * 3 + 1] == to || triangles[t * 3 + 2] == to))
+        return true;
+    return false;
+  }
+
+  // rejects collapses which flip or squash a remaining triangle
+  bool keeps_orientation(uint32_t from, uint32_t to) const
+  {
+    for (uint32_t t : vertexTriangles[from])
+    {
+      const uint32_t *tri = &triangles[t * 3];
+      if (triangleRemoved[t] || tri[0] == to || tri[1] == to || tri[2] == to)
+        continue;
+      vec3 p[3], q[3];
+      for (int k = 0; k < 3; k++)
+      {
+        p[k] = mesh.vertices[tri[k]];
+        q[k] = mesh.vertices[tri[k] == from ? to : tri[k]];
+      }
+      const vec3 before = cross(p[1] - p[0], p[2] - p[0]);
+      const vec3 after = cross(q[1] - q[0], q[2] - q[0]);
+      const float afterLength = length(after);
+      if (afterLength < 1e-12f || dot(before, after) < 0.25f * length(before) * afterLength)
+        return false;
+    }
+    return true;
+  }
+
+  // distance of the moved vertex from the planes of the triangles it leaves, the bound of the source
+  // surface distance grows by it, so the error of the level is a real distance, not a quadric sum
+  float collapse_deviation(uint32_t from, uint32_t to) const
+  {
+    float result = 0.f;
+    const vec3 &target = mesh.vertices[to];
+    for (uint32_t t : vertexTriangles[from])
+    {
+      if (triangleRemoved[t])
+        continue;
+      const uint32_t *tri = &triangles[t * 3];
+      const vec3 &p0 = mesh.vertices[tri[0]];
+      const vec3 normal = cross(mesh.vertices[tri[1]] - p0, mesh.vertices[tri[2]] - p0);
+      const float area = length(normal);
+      if (area > 0.f)
+        result = std::max(result, std::abs(dot(normal, target - p0)) / area);
+    }
+    return result;
+  }
+
+  void collapse(uint32_t from, uint32_t to)
+  {
+    const float moved = deviation[position[from]] + collapse_deviation(from, to);
+    deviation[position[to]] = std::max(deviation[position[to]], moved);
+    for (uint32_t t : vertexTriangles[from])
+    {
+      if (triangleRemoved[t])
+        continue;
+      uint32_t *tri = &triangles[t * 3];
+      if (tri[0] == to || tri[1] == to || tri[2] == to)
+      {
+        triangleRemoved[t] = 1;
+        aliveTriangles--;
+        continue;
+      }
+      for (int k = 0; k < 3; k++)
+        if (tri[k] == from)
+          tri[k] = to;
+      vertexTriangles[to].push_back(t);
+    }
+    vertexTriangles[from].clear();
+    vertexRemoved[from] = 1;
+    if (position[from] != position[to])
+      quadrics[position[to]].add(quadrics[position[from]]);
+  }
+
+public:
+  MeshSimplifier(const SimplifyMesh &mesh, std::span<const uint32_t> indices) :
+    mesh(mesh), triangles(indices.begin(), indices.end())
+  {
+    const size_t vertexCount = mesh.vertices.size();
+    const size_t triangleCount = triangles.size() / 3;
+    triangleRemoved.assign(triangleCount, 0);
+    vertexTriangles.resize(vertexCount);
+    vertexRemoved.assign(vertexCount, 0);
+    locked.assign(vertexCount, 0);
+    aliveTriangles = triangleCount;
+
+    BoundingBox bounds;
+    for (const vec3 &v : mesh.vertices)
+      bounds.add(v);
+    radius = std::max(length(bounds.max - bounds.min) * 0.5f, 1e-6f);
+
+    // vertices split by uv or normal discontinuities share a position
+    struct PositionHash
+    {
+      size_t operator()(const vec3 &v) const
+      {
+        uint32_t bits[3];
+        memcpy(bits, &v, sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+      }
+    };
+    std::unordered_map<vec3, uint32_t, PositionHash> positionIds;
+    position.resize(vertexCount);
+    std::vector<uint32_t> positionVertexCount;
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+      auto [it, inserted] = positionIds.emplace(mesh.vertices[v], uint32_t(positionVertexCount.size()));
+      if (inserted)
+        positionVertexCount.push_back(0);
+      position[v] = it->second;
+      positionVertexCount[it->second]++;
+    }
+    quadrics.resize(positionVertexCount.size());
+    deviation.assign(positionVertexCount.size(), 0.f);
+
+    // edges between positions used by a single triangle are open borders
+    std::unordered_map<uint64_t, uint32_t> edgeUse;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+      const uint32_t *tri = &triangles[t * 3];
+      const vec3 &p0 = mesh.vertices[tri[0]], &p1 = mesh.vertices[tri[1]], &p2 = mesh.vertices[tri[2]];
+      vec3 normal = cross(p1 - p0, p2 - p0);
+      const float area = length(normal);
+      if (area > 0.f)
+      {
+        normal /= area;
+        for (int k = 0; k < 3; k++)
+          quadrics[position[tri[k]]].add_plane(normal, -dot(normal, p0), area);
+      }
+      for (int k = 0; k < 3; k++)
+      {
+        vertexTriangles[tri[k]].push_back(t);
+        const uint32_t a = position[tri[k]], b = position[tri[(k + 1) % 3]];
+        edgeUse[uint64_t(std::min(a, b)) << 32 | std::max(a, b)]++;
+      }
+    }
+    // after welding a position keeps several vertices only where uv or normal is split, unwelded meshes lock entirely
+    for (size_t v = 0; v < vertexCount; v++)
+      locked[v] = positionVertexCount[position[v]] > 1;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+      const uint32_t *tri = &triangles[t * 3];
+      for (int k = 0; k < 3; k++)
+      {
+        const uint32_t a = position[tri[k]], b = position[tri[(k + 1) % 3]];
+        if (edgeUse[uint64_t(std::min(a, b)) << 32 | std::max(a, b)] == 1)
+          locked[tri[k]] = locked[tri[(k + 1) % 3]] = 1;
+      }
+    }
+  }
+
+  std::vector<uint32_t> run(size_t target_index_count, float &error)
+  {
+    for (size_t v = 0; v < mesh.vertices.size(); v++)
+      if (!locked[v])
+        push_collapses(v);
+
+    float maxDeviation = 0.f;
+    while (aliveTriangles * 3 > target_index_count && !queue.empty())
+    {
+      const Collapse top = queue.top();
+      queue.pop();
+      if (vertexRemoved[top.from] || vertexRemoved[top.to] || !has_edge(top.from, top.to))
+        continue;
+      // costs grow after neighbouring collapses, stale entries are re-queued with the current cost
+      const double cost = collapse_cost(top.from, top.to);
+      if (cost > top.cost * 1.0001 + 1e-12)
+      {
+        queue.push({cost, top.from, top.to});
+        continue;
+      }
+      if (!keeps_orientation(top.from, top.to))
+        continue;
+      collapse(top.from, top.to);
+      maxDeviation = std::max(maxDeviation, deviation[position[top.to]]);
+      push_collapses(top.to);
+    }
+
+    error = maxDeviation / radius;
+    std::vector<uint32_t> result;
+    result.reserve(aliveTriangles * 3);
+    for (size_t t = 0; t < triangleRemoved.size(); t++)
+      if (!triangleRemoved[t])
+        result.insert(result.end(), &triangles[t * 3], &triangles[t * 3] + 3);
+    return result;
+  }
+};
+
+std::vector<uint32_t> simplify_mesh(const SimplifyMesh &mesh, std::span<const uint32_t> indices, size_t target_index_count, float &error)
+{
+  MeshSimplifier simplifier(mesh, indices);
+  return simplifier.run(target_index_count, error);
+}
+
+void build_mesh_lods(const SimplifyMesh &mesh, std::span<const uint32_t> indices, int max_lods,
+  std::vector<uint32_t> &lod_indices, std::vector<MeshLod> &lods)
+{
+  lod_indices.assign(indices.begin(), indices.end());
+  lods.assign(1, MeshLod{0, uint32_t(indices.size()), 0.f});
+  std::vector<uint32_t> previous(indices.begin(), indices.end());
+  float totalError = 0.f;
+  // a few dozen triangles aren't worth a draw call of their own
+  while (int(lods.size()) < max_lods && previous.size() >= 64 * 3)
+  {
+    // each level starts from the previous one, so its error adds up with the errors of the previous levels
+    float error = 0.f;
+    std::vector<uint32_t> simplified = simplify_mesh(mesh, previous, previous.size() / 6 * 3, error);
+    if (simplified.size() * 10 > previous.size() * 9)
+      break;
+    totalError += error;
+    lods.push_back(MeshLod{uint32_t(lod_indices.size()), uint32_t(simplified.size()), totalError});
+    lod_indices.insert(lod_indices.end(), simplified.begin(), simplified.end());
+    previous = std::move(simplified);
+  }
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "3dmath.h"
+#include "render/mesh.h"
+#include <span>
+#include <vector>
+
+// vertex data the simplifier respects, uv and skin channels may be empty
+struct SimplifyMesh
+{
+  std::span<const vec3> vertices;
+  std::span<const vec2> uv;
+  std::span<const vec4> weights;
+  std::span<const uvec4> weightsIndex;
+};
+
+// Quadric error edge collapse of a vertex onto its neighbour, so the result indexes the same vertex buffer.
+// Expects welded vertices (weld_vertices), a position shared by several vertices is a split in some attribute:
+// vertices on UV seams, hard normal edges and open borders never move,
+// collapses between differently skinned vertices are penalized.
+// error - bound of the largest distance of the result from the source surface, relative to the mesh radius
+std::vector<uint32_t> simplify_mesh(const SimplifyMesh &mesh, std::span<const uint32_t> indices, size_t target_index_count, float &error);
+
+// LOD 0 is the source, every next level keeps about half of the triangles of the previous one,
+// stops earlier at small meshes or when a level can't be reduced by 10%, indices of all levels are concatenated
+void build_mesh_lods(const SimplifyMesh &mesh, std::span<const uint32_t> indices, int max_lods,
+  std::vector<uint32_t> &lod_indices, std::vector<MeshLod> &lods);
@@ -0,0 +1,289 @@
+#include "import/mesh_optimize.h"
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <numeric>
+#include <unordered_map>
+
+template <typename T>
+static void reorder_channel(std::vector<T> &channel, std::span<const uint32_t> new_order)
+{
+  if (channel.empty())
+    return;
+  std::vector<T> reordered(new_order.size());
+  for (size_t i = 0; i < new_order.size(); i++)
+    reordered[i] = channel[new_order[i]];
+  channel = std::move(reordered);
+}
+
+void reorder_vertices(VertexStreams &streams, std::span<const uint32_t> new_order)
+{
+  reorder_channel(streams.vertices, new_order);
+  reorder_channel(streams.normals, new_order);
+  reorder_channel(streams.uv, new_order);
+  reorder_channel(streams.boneWeights, new_order);
+  reorder_channel(streams.boneIndexes, new_order);
+}
+
+template <typename T>
+static void append_bytes(std::vector<uint8_t> &key, const std::vector<T> &channel, size_t vertex)
+{
+  if (channel.empty())
+    return;
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&channel[vertex]);
+  key.insert(key.end(), bytes, bytes + sizeof(T));
+}
+
+void weld_vertices(VertexStreams &streams, std::vector<uint32_t> &indices)
+{
+  const size_t vertexCount = streams.vertices.size();
+  std::vector<uint8_t> key;
+  std::unordered_map<std::string, uint32_t> unique;
+  unique.reserve(vertexCount);
+  std::vector<uint32_t> remap(vertexCount);
+  std::vector<uint32_t> newOrder;
+  newOrder.reserve(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++)
+  {
+    // bitwise equality, -0 and 0 stay different which only costs a vertex
+    key.clear();
+    append_bytes(key, streams.vertices, v);
+    append_bytes(key, streams.normals, v);
+    append_bytes(key, streams.uv, v);
+    append_bytes(key, streams.boneWeights, v);
+    append_bytes(key, streams.boneIndexes, v);
+    auto [it, inserted] = unique.emplace(std::string(key.begin(), key.end()), uint32_t(newOrder.size()));
+    if (inserted)
+      newOrder.push_back(v);
+    remap[v] = it->second;
+  }
+  for (uint32_t &index : indices)
+    index = remap[index];
+  reorder_vertices(streams, newOrder);
+}
+
+// scores from Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+static const int FORSYTH_CACHE_SIZE = 32;
+
+static float forsyth_vertex_score(int cache_position, int remaining_triangles)
+{
+  if (remaining_triangles == 0)
+    return -1.f;
+  float score = 0.f;
+  if (cache_position >= 0)
+  {
+    // the last triangle's vertices get a fixed score, so the next triangle doesn't just reuse its edge
+    if (cache_position < 3)
+      score = 0.75f;
+    else
+      score = std::pow(1.f - float(cache_position - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f);
+  }
+  // vertices with few triangles left are finished first
+  return score + 2.f / std::sqrt(float(remaining_triangles));
+}
+
+void optimize_vertex_cache(std::span<uint32_t> indices, size_t vertex_count)
+{
+  const size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0)
+    return;
+
+  // triangles of every vertex, live ones first
+  std::vector<uint32_t> remaining(vertex_count, 0);
+  for (uint32_t index : indices)
+    remaining[index]++;
+  std::vector<uint32_t> offsets(vertex_count + 1, 0);
+  for (size_t v = 0; v < vertex_count; v++)
+    offsets[v + 1] = offsets[v] + remaining[v];
+  std::vector<uint32_t> adjacency(indices.size());
+  std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+  for (size_t t = 0; t < triangleCount; t++)
+    for (int k = 0; k < 3; k++)
+      adjacency[filled[indices[t * 3 + k]]++] = t;
+
+  std::vector<int> cachePosition(vertex_count, -1);
+  std::vector<float> vertexScore(vertex_count);
+  for (size_t v = 0; v < vertex_count; v++)
+    vertexScore[v] = forsyth_vertex_score(-1, remaining[v]);
+  std::vector<float> triangleScore(triangleCount);
+  for (size_t t = 0; t < triangleCount; t++)
+    triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+  std::vector<uint8_t> emitted(triangleCount, 0);
+
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+  std::vector<uint32_t> cache, newCache;
+  size_t scanCursor = 0;
+  int64_t bestTriangle = -1;
+  for (size_t t = 0; t < triangleCount; t++)
+    if (bestTriangle < 0 || triangleScore[t] > triangleScore[bestTriangle])
+      bestTriangle = t;
+
+  while (bestTriangle >= 0)
+  {
+    const uint32_t *tri = &indices[bestTriangle * 3];
+    result.insert(result.end(), tri, tri + 3);
+    emitted[bestTriangle] = 1;
+
+    newCache.assign(tri, tri + 3);
+    for (uint32_t v : cache)
+      if (v != tri[0] && v != tri[1] && v != tri[2])
+        newCache.push_back(v);
+    for (int k = 0; k < 3; k++)
+    {
+      // the emitted triangle leaves the live part of the vertex adjacency
+      const uint32_t v = tri[k];
+      uint32_t *begin = &adjacency[offsets[v]];
+      uint32_t *end = begin + remaining[v];
+      std::iter_swap(std::find(begin, end, uint32_t(bestTriangle)), end - 1);
+      remaining[v]--;
+    }
+    for (size_t i = 0; i < newCache.size(); i++)
+      cachePosition[newCache[i]] = i < FORSYTH_CACHE_SIZE ? int(i) : -1;
+    for (uint32_t v : newCache)
+    {
+      vertexScore[v] = forsyth_vertex_score(cachePosition[v], remaining[v]);
+      for (uint32_t i = 0; i < remaining[v]; i++)
+      {
+        const uint32_t t = adjacency[offsets[v] + i];
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+      }
+    }
+    if (newCache.size() > FORSYTH_CACHE_SIZE)
+      newCache.resize(FORSYTH_CACHE_SIZE);
+    std::swap(cache, newCache);
+
+    // the best triangle is next to the cached vertices, otherwise any triangle which is left
+    bestTriangle = -1;
+    float bestScore = -1.f;
+    for (uint32_t v : cache)
+      for (uint32_t i = 0; i < remaining[v]; i++)
+      {
+        const uint32_t t = adjacency[offsets[v] + i];
+        if (triangleScore[t] > bestScore)
+        {
+          bestScore = triangleScore[t];
+          bestTriangle = t;
+        }
+      }
+    if (bestTriangle < 0)
+    {
+      while (scanCursor < triangleCount && emitted[scanCursor])
+        scanCursor++;
+      if (scanCursor < triangleCount)
+        bestTriangle = scanCursor;
+    }
+  }
+  std::copy(result.begin(), result.end(), indices.begin());
+}
+
+void optimize_overdraw(std::span<uint32_t> indices, std::span<const vec3> vertices)
+{
+  const size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0)
+    return;
+
+  // a cluster starts at a triangle which misses the cache with all three vertices,
+  // or misses with two when the cluster so far is within 5% of the mesh ACMR, so the restart costs little
+  const int cacheSize = 16;
+  const float acmrThreshold = compute_acmr(indices, vertices.size(), cacheSize) * 1.05f;
+  const uint32_t minClusterTriangles = 32;
+  std::vector<uint32_t> clusterStarts;
+  std::vector<uint32_t> cacheTime(vertices.size(), 0);
+  uint32_t time = cacheSize + 1;
+  uint32_t clusterMisses = 0;
+  for (size_t t = 0; t < triangleCount; t++)
+  {
+    int misses = 0;
+    for (int k = 0; k < 3; k++)
+    {
+      const uint32_t v = indices[t * 3 + k];
+      if (time - cacheTime[v] > uint32_t(cacheSize))
+      {
+        cacheTime[v] = time++;
+        misses++;
+      }
+    }
+    const uint32_t clusterTriangles = clusterStarts.empty() ? 0 : t - clusterStarts.back();
+    const bool softBoundary = misses >= 2 && clusterTriangles >= minClusterTriangles &&
+      float(clusterMisses) <= acmrThreshold * clusterTriangles;
+    if (t == 0 || misses == 3 || softBoundary)
+    {
+      clusterStarts.push_back(t);
+      clusterMisses = 0;
+    }
+    clusterMisses += misses;
+  }
+  clusterStarts.push_back(triangleCount);
+
+  vec3 meshCenter(0.f);
+  for (uint32_t index : indices)
+    meshCenter += vertices[index];
+  meshCenter /= float(indices.size());
+
+  // clusters facing away from the center are likely in front of the others
+  const size_t clusterCount = clusterStarts.size() - 1;
+  std::vector<float> occlusion(clusterCount);
+  for (size_t c = 0; c < clusterCount; c++)
+  {
+    vec3 center(0.f), normal(0.f);
+    float area = 0.f;
+    for (uint32_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+    {
+      const vec3 &p0 = vertices[indices[t * 3]], &p1 = vertices[indices[t * 3 + 1]], &p2 = vertices[indices[t * 3 + 2]];
+      const vec3 n = cross(p1 - p0, p2 - p0);
+      const float a = length(n);
+      center += (p0 + p1 + p2) * (a / 3.f);
+      normal += n;
+      area += a;
+    }
+    const float normalLength = length(normal);
+    occlusion[c] = area > 0.f && normalLength > 0.f ? dot(center / area - meshCenter, normal / normalLength) : 0.f;
+  }
+
+  std::vector<uint32_t> order(clusterCount);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return occlusion[a] > occlusion[b]; });
+
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+  for (uint32_t c : order)
+    result.insert(result.end(), &indices[clusterStarts[c] * 3], &indices[clusterStarts[c + 1] * 3]);
+  std::copy(result.begin(), result.end(), indices.begin());
+}
+
+std::vector<uint32_t> optimize_vertex_fetch(std::span<uint32_t> indices, size_t vertex_count)
+{
+  const uint32_t unused = ~0u;
+  std::vector<uint32_t> remap(vertex_count, unused);
+  std::vector<uint32_t> newOrder;
+  newOrder.reserve(vertex_count);
+  for (uint32_t &index : indices)
+  {
+    if (remap[index] == unused)
+    {
+      remap[index] = newOrder.size();
+      newOrder.push_back(index);
+    }
+    index = remap[index];
+  }
+  return newOrder;
+}
+
+float compute_acmr(std::span<const uint32_t> indices, size_t vertex_count, int cache_size)
+{
+  if (indices.size() < 3)
+    return 0.f;
+  std::vector<uint32_t> cacheTime(vertex_count, 0);
+  uint32_t time = cache_size + 1;
+  size_t misses = 0;
+  for (uint32_t v : indices)
+  {
+    if (time - cacheTime[v] > uint32_t(cache_size))
+    {
+      cacheTime[v] = time++;
+      misses++;
+    }
+  }
+  return float(misses) / float(indices.size() / 3);
+}
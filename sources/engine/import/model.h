@@ -1,5 +1,7 @@
 #pragma once
 #include "render/mesh.h"
+#include "import/root_motion.h"
+#include "import/animation_compression.h"
 #include <vector>
 #include <ozz/base/memory/unique_ptr.h>
 #include <ozz/animation/runtime/skeleton.h>
@@ -26,7 +28,17 @@ struct ModelAsset
 };
 
 ModelAsset load_model(const char *path);
-void build_animations(const std::vector<std::string> &paths, const std::string &output_path);
+
+// triangles of one mesh in model space, node transforms applied, for offline collision cooking
+struct CollisionGeometry
+{
+  std::string name;
+  std::vector<vec3> vertices;
+  std::vector<uint32_t> indices;
+};
+
+std::vector<CollisionGeometry> load_collision_geometry(const char *path);
+void build_animations(const std::vector<std::string> &paths, const std::string &output_path, const AnimationCompressionProfile &profile = default_compression_profile());
 
 struct AnimationDataBase
 {
@@ -34,6 +46,8 @@ struct AnimationDataBase
   SkeletonPtr skeleton;
   std::vector<AnimationPtr> animations;
   std::map<std::string, int> animationMap;
+  std::vector<RootMotionTrack> rootMotions;
+  std::map<std::string, int> rootMotionMap;
 
   const ozz::animation::Animation *find_animation(const std::string &name) const
   {
@@ -44,6 +58,16 @@ struct AnimationDataBase
     }
     return nullptr;
   }
+
+  const RootMotionTrack *find_root_motion(const std::string &name) const
+  {
+    auto it = rootMotionMap.find(name);
+    if (it != rootMotionMap.end())
+    {
+      return &rootMotions[it->second];
+    }
+    return nullptr;
+  }
 };
 
 AnimationDataBase load_animations(const std::string &path);
@@ -0,0 +1,62 @@
+#pragma once
+#include "3dmath.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Horizontal trajectory of the root joint, extracted from root motion clips by build_animations.
+// The skeletal animation itself is stored in place, this track keeps what was removed from it.
+// Positions are model space (x, z) relative to the first frame, yaw is the root heading in radians.
+struct RootMotionTrack
+{
+  std::string name;
+  float duration = 0.f;
+  std::vector<vec2> positions; // uniformly sampled at the clip's key rate
+  std::vector<float> yaws;     // same sampling, unwrapped so it can be interpolated
+
+  vec3 sample_position(float ratio) const
+  {
+    if (positions.empty())
+      return vec3(0.f);
+    float idx = glm::clamp(ratio, 0.f, 1.f) * (positions.size() - 1);
+    int i0 = (int)idx;
+    int i1 = std::min(i0 + 1, (int)positions.size() - 1);
+    vec2 p = glm::mix(positions[i0], positions[i1], idx - i0);
+    return vec3(p.x, 0.f, p.y);
+  }
+
+  float sample_yaw(float ratio) const
+  {
+    if (yaws.empty())
+      return 0.f;
+    float idx = glm::clamp(ratio, 0.f, 1.f) * (yaws.size() - 1);
+    int i0 = (int)idx;
+    int i1 = std::min(i0 + 1, (int)yaws.size() - 1);
+    return glm::mix(yaws[i0], yaws[i1], idx - i0);
+  }
+
+  // root displacement in model space between two ratios, wraps around the clip end when to_ratio < from_ratio,
+  // the part after the wrap starts from the heading the clip ended with
+  vec3 displacement(float from_ratio, float to_ratio) const
+  {
+    if (to_ratio >= from_ratio)
+      return sample_position(to_ratio) - sample_position(from_ratio);
+    const float loopYaw = sample_yaw(1.f) - sample_yaw(0.f);
+    return (sample_position(1.f) - sample_position(from_ratio)) + rotate_yaw(sample_position(to_ratio) - sample_position(0.f), loopYaw);
+  }
+
+  // rotates a model space offset by a heading change, the inverse of the root frame transform of the trajectory features
+  static vec3 rotate_yaw(vec3 v, float yaw)
+  {
+    const float s = sinf(yaw), c = cosf(yaw);
+    return vec3(v.x * c + v.z * s, v.y, -v.x * s + v.z * c);
+  }
+
+  // root yaw change between two ratios, wraps like displacement
+  float yaw_delta(float from_ratio, float to_ratio) const
+  {
+    if (to_ratio >= from_ratio)
+      return sample_yaw(to_ratio) - sample_yaw(from_ratio);
+    return (sample_yaw(1.f) - sample_yaw(from_ratio)) + (sample_yaw(to_ratio) - sample_yaw(0.f));
+  }
+};
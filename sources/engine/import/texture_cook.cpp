@@ -0,0 +1,237 @@
+#include "import/texture_cook.h"
+#include "engine/api.h"
+#include "engine/replay.h"
+#include "import/timer.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+std::string get_cooked_texture_path(const char *source_path)
+{
+  return std::filesystem::path(source_path).replace_extension(".ctex").string();
+}
+
+uint64_t get_texture_source_stamp(const char *source_path)
+{
+  std::error_code error;
+  const uint64_t stamp[2] = {
+    uint64_t(std::filesystem::file_size(source_path, error)),
+    uint64_t(std::filesystem::last_write_time(source_path, error).time_since_epoch().count())};
+  return engine::hash_bytes(stamp, sizeof(stamp));
+}
+
+struct MipImage
+{
+  int width, height;
+  std::vector<uint8_t> pixels;
+};
+
+static float srgb_to_linear(int value)
+{
+  static const std::vector<float> table = []
+  {
+    std::vector<float> t(256);
+    for (int i = 0; i < 256; i++)
+    {
+      const float c = i / 255.f;
+      t[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+    return t;
+  }();
+  return table[value];
+}
+
+static uint8_t linear_to_srgb(float c)
+{
+  c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+  return uint8_t(std::clamp(c * 255.f + 0.5f, 0.f, 255.f));
+}
+
+// 2x2 box filter, color is averaged in linear space, so mips don't darken like with glGenerateMipmap
+static MipImage downsample(const MipImage &src, int channels)
+{
+  MipImage dst;
+  dst.width = std::max(src.width / 2, 1);
+  dst.height = std::max(src.height / 2, 1);
+  dst.pixels.resize(size_t(dst.width) * dst.height * channels);
+  for (int y = 0; y < dst.height; y++)
+    for (int x = 0; x < dst.width; x++)
+    {
+      const int x0 = std::min(x * 2, src.width - 1), x1 = std::min(x * 2 + 1, src.width - 1);
+      const int y0 = std::min(y * 2, src.height - 1), y1 = std::min(y * 2 + 1, src.height - 1);
+      const uint8_t *taps[4] = {
+        &src.pixels[(size_t(y0) * src.width + x0) * channels], &src.pixels[(size_t(y0) * src.width + x1) * channels],
+        &src.pixels[(size_t(y1) * src.width + x0) * channels], &src.pixels[(size_t(y1) * src.width + x1) * channels]};
+      uint8_t *out = &dst.pixels[(size_t(y) * dst.width + x) * channels];
+      for (int c = 0; c < channels; c++)
+      {
+        if (c == 3)
+          out[c] = uint8_t((taps[0][c] + taps[1][c] + taps[2][c] + taps[3][c] + 2) / 4);
+        else
+          out[c] = linear_to_srgb(0.25f * (srgb_to_linear(taps[0][c]) + srgb_to_linear(taps[1][c]) +
+            srgb_to_linear(taps[2][c]) + srgb_to_linear(taps[3][c])));
+      }
+    }
+  return dst;
+}
+
+static uint16_t to_rgb565(const int color[3])
+{
+  return uint16_t((color[0] >> 3) << 11 | (color[1] >> 2) << 5 | color[2] >> 3);
+}
+
+static void from_rgb565(uint16_t value, int color[3])
+{
+  const int r = value >> 11, g = (value >> 5) & 63, b = value & 31;
+  color[0] = r << 3 | r >> 2;
+  color[1] = g << 2 | g >> 4;
+  color[2] = b << 3 | b >> 2;
+}
+
+// endpoints from the inset bounding box of the block colors, fast but blurs blocks with anti-correlated channels
+static void encode_bc1_block(const uint8_t block[16][3], uint8_t out[8])
+{
+  int lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
+  for (int i = 0; i < 16; i++)
+    for (int c = 0; c < 3; c++)
+    {
+      lo[c] = std::min<int>(lo[c], block[i][c]);
+      hi[c] = std::max<int>(hi[c], block[i][c]);
+    }
+  for (int c = 0; c < 3; c++)
+  {
+    const int inset = (hi[c] - lo[c]) / 16;
+    lo[c] += inset;
+    hi[c] -= inset;
+  }
+  uint16_t color0 = to_rgb565(hi), color1 = to_rgb565(lo);
+  // color0 > color1 selects the 4 color mode without transparency
+  if (color0 < color1)
+    std::swap(color0, color1);
+
+  uint32_t selectors = 0;
+  if (color0 != color1)
+  {
+    int palette[4][3];
+    from_rgb565(color0, palette[0]);
+    from_rgb565(color1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    for (int i = 0; i < 16; i++)
+    {
+      int best = 0, bestDistance = INT32_MAX;
+      for (int p = 0; p < 4; p++)
+      {
+        int distance = 0;
+        for (int c = 0; c < 3; c++)
+          distance += (block[i][c] - palette[p][c]) * (block[i][c] - palette[p][c]);
+        if (distance < bestDistance)
+        {
+          bestDistance = distance;
+          best = p;
+        }
+      }
+      selectors |= uint32_t(best) << (i * 2);
+    }
+  }
+  memcpy(out, &color0, 2);
+  memcpy(out + 2, &color1, 2);
+  memcpy(out + 4, &selectors, 4);
+}
+
+static std::vector<uint8_t> encode_bc1(const MipImage &image)
+{
+  const int blocksX = (image.width + 3) / 4, blocksY = (image.height + 3) / 4;
+  std::vector<uint8_t> result(size_t(blocksX) * blocksY * 8);
+  uint8_t block[16][3];
+  for (int by = 0; by < blocksY; by++)
+    for (int bx = 0; bx < blocksX; bx++)
+    {
+      // blocks of the small mips repeat the edge pixels
+      for (int i = 0; i < 16; i++)
+      {
+        const int x = std::min(bx * 4 + i % 4, image.width - 1), y = std::min(by * 4 + i / 4, image.height - 1);
+        memcpy(block[i], &image.pixels[(size_t(y) * image.width + x) * 3], 3);
+      }
+      encode_bc1_block(block, &result[(size_t(by) * blocksX + bx) * 8]);
+    }
+  return result;
+}
+
+bool cook_texture(const char *source_path, const char *cooked_path, bool compress)
+{
+  Timer timer;
+  int width, height, sourceChannels;
+  // the flip is done by hand, stbi_set_flip_vertically_on_load is global and cooks run in parallel
+  uint8_t *decoded = stbi_load(source_path, &width, &height, &sourceChannels, 0);
+  if (!decoded)
+  {
+    engine::error("Failed to decode texture \"%s\", %s", source_path, stbi_failure_reason());
+    return false;
+  }
+  // gray images are expanded, so every format keeps the same shader swizzle
+  const int channels = sourceChannels == 2 || sourceChannels == 4 ? 4 : 3;
+  MipImage mip;
+  mip.width = width;
+  mip.height = height;
+  mip.pixels.resize(size_t(width) * height * channels);
+  for (int y = 0; y < height; y++)
+    for (int x = 0; x < width; x++)
+    {
+      const uint8_t *in = &decoded[(size_t(height - 1 - y) * width + x) * sourceChannels];
+      uint8_t *out = &mip.pixels[(size_t(y) * width + x) * channels];
+      const bool gray = sourceChannels < 3;
+      out[0] = in[0];
+      out[1] = gray ? in[0] : in[1];
+      out[2] = gray ? in[0] : in[2];
+      if (channels == 4)
+        out[3] = in[sourceChannels - 1];
+    }
+  stbi_image_free(decoded);
+
+  CookedTextureHeader header;
+  header.magic = COOKED_TEXTURE_MAGIC;
+  header.version = COOKED_TEXTURE_VERSION;
+  header.sourceStamp = get_texture_source_stamp(source_path);
+  header.format = channels == 4 ? CookedTextureFormat::RGBA8 : compress ? CookedTextureFormat::BC1 : CookedTextureFormat::RGB8;
+  header.width = width;
+  header.height = height;
+  header.mipCount = 1;
+  for (int w = width, h = height; w > 1 || h > 1; w = std::max(w / 2, 1), h = std::max(h / 2, 1))
+    header.mipCount++;
+
+  std::vector<CookedTextureMip> mips(header.mipCount);
+  std::vector<std::vector<uint8_t>> mipData(header.mipCount);
+  uint64_t offset = sizeof(CookedTextureHeader) + sizeof(CookedTextureMip) * header.mipCount;
+  for (uint32_t level = 0; level < header.mipCount; level++)
+  {
+    if (level > 0)
+      mip = downsample(mip, channels);
+    mipData[level] = header.format == CookedTextureFormat::BC1 ? encode_bc1(mip) : mip.pixels;
+    mips[level] = {offset, mipData[level].size(), uint32_t(mip.width), uint32_t(mip.height)};
+    offset += mipData[level].size();
+  }
+
+  std::ofstream file(cooked_path, std::ios::binary);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(mips.data()), mips.size() * sizeof(CookedTextureMip));
+  for (const std::vector<uint8_t> &data : mipData)
+    file.write(reinterpret_cast<const char *>(data.data()), data.size());
+  if (!file)
+  {
+    engine::error("Failed to write cooked texture \"%s\"", cooked_path);
+    return false;
+  }
+  static const char *formatNames[] = {"RGB8", "RGBA8", "BC1"};
+  engine::log("Texture \"%s\" cooked, %dx%d %s, %u mips, %.1f KiB. %f ms", source_path, width, height,
+    formatNames[uint32_t(header.format)], header.mipCount, offset / 1024.0, timer.elapsed_ms());
+  return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+enum class CookedTextureFormat : uint32_t
+{
+  RGB8,
+  RGBA8,
+  BC1, // RGB, 8 bytes per 4x4 block
+};
+
+// cooked texture: header, mip table from the largest level, then the mip data in the same order,
+// rows go bottom up as OpenGL expects
+struct CookedTextureHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t sourceStamp; // size and write time of the source image
+  CookedTextureFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t mipCount;
+};
+
+struct CookedTextureMip
+{
+  uint64_t offset; // from the start of the file
+  uint64_t size;
+  uint32_t width;
+  uint32_t height;
+};
+
+// bump when the layout or the mip filtering changes, files of older versions are recooked
+constexpr uint32_t COOKED_TEXTURE_VERSION = 1;
+constexpr uint32_t COOKED_TEXTURE_MAGIC = 0x58455443; // "CTEX"
+
+// "resources/diffuse.jpg" -> "resources/diffuse.ctex"
+std::string get_cooked_texture_path(const char *source_path);
+
+// changes when the source image is replaced, doesn't read the file
+uint64_t get_texture_source_stamp(const char *source_path);
+
+// Decodes the image, filters the mips in linear color space and writes the cooked file.
+// compress - BC1 for images without alpha. Slow, runs on a worker thread, false on failure.
+bool cook_texture(const char *source_path, const char *cooked_path, bool compress);
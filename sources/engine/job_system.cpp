@@ -0,0 +1,100 @@
+#include "engine/job_system.h"
+#include "engine/profiler.h"
+#include <algorithm>
+#include <string>
+
+namespace engine
+{
+  JobSystem::JobSystem(int thread_count)
+  {
+    for (int i = 0; i < thread_count; i++)
+      workers.emplace_back([this, i]() { worker_loop(i); });
+  }
+
+  JobSystem::~JobSystem()
+  {
+    {
+      std::unique_lock lock(mutex);
+      stopping = true;
+    }
+    condition.notify_all();
+    for (std::thread &worker : workers)
+      worker.join();
+  }
+
+  void JobSystem::submit(Job &&job, JobCounter *counter)
+  {
+    if (counter)
+      counter->pending.fetch_add(1, std::memory_order_relaxed);
+    {
+      std::unique_lock lock(mutex);
+      jobs.push_back({std::move(job), counter});
+    }
+    condition.notify_one();
+  }
+
+  bool JobSystem::run_one()
+  {
+    QueuedJob queued;
+    {
+      std::unique_lock lock(mutex);
+      if (jobs.empty())
+        return false;
+      queued = std::move(jobs.front());
+      jobs.pop_front();
+    }
+    queued.job();
+    if (queued.counter)
+      queued.counter->pending.fetch_sub(1, std::memory_order_release);
+    return true;
+  }
+
+  void JobSystem::wait(JobCounter &counter)
+  {
+    while (!counter.done())
+      if (!run_one())
+        std::this_thread::yield();
+  }
+
+  void JobSystem::parallel_for(int count, int batch_size, const SmallFunction<void(int begin, int end)> &body)
+  {
+    batch_size = std::max(batch_size, 1);
+    JobCounter counter;
+    // the first batch is kept for the calling thread
+    for (int begin = batch_size; begin < count; begin += batch_size)
+    {
+      const int end = std::min(begin + batch_size, count);
+      submit([&body, begin, end]() { body(begin, end); }, &counter);
+    }
+    if (count > 0)
+      body(0, std::min(batch_size, count));
+    wait(counter);
+  }
+
+  void JobSystem::worker_loop(int index)
+  {
+    const std::string name = "Worker " + std::to_string(index);
+    set_profiler_thread_name(name.c_str());
+    while (true)
+    {
+      QueuedJob queued;
+      {
+        std::unique_lock lock(mutex);
+        condition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+        if (jobs.empty())
+          return;
+        queued = std::move(jobs.front());
+        jobs.pop_front();
+      }
+      queued.job();
+      if (queued.counter)
+        queued.counter->pending.fetch_sub(1, std::memory_order_release);
+    }
+  }
+
+  JobSystem &get_job_system()
+  {
+    static JobSystem jobSystem(std::max(1, (int)std::thread::hardware_concurrency() - 1));
+    return jobSystem;
+  }
+} // namespace engine
@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "engine/small_function.h"
+
+namespace engine
+{
+  // JOB SYSTEM //
+
+  using Job = SmallFunction<void(), 64>;
+
+  // number of unfinished jobs submitted with the counter
+  struct JobCounter
+  {
+    std::atomic<int> pending = 0;
+    bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+  };
+
+  // Thread pool with one FIFO queue. wait() runs queued jobs on the calling thread,
+  // so a job must not wait for jobs submitted after it.
+  class JobSystem
+  {
+  public:
+    explicit JobSystem(int thread_count);
+    ~JobSystem();
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    int thread_count() const { return (int)workers.size(); }
+
+    void submit(Job &&job, JobCounter *counter = nullptr);
+
+    void wait(JobCounter &counter);
+
+    // splits [0, count) into batches of batch_size, runs them on workers and the calling thread
+    void parallel_for(int count, int batch_size, const SmallFunction<void(int begin, int end)> &body);
+
+  private:
+    struct QueuedJob
+    {
+      Job job;
+      JobCounter *counter;
+    };
+
+    bool run_one();
+    void worker_loop(int index);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<QueuedJob> jobs;
+    bool stopping = false;
+  };
+
+  // shared pool with a worker per hardware thread except the main one, created on first use
+  JobSystem &get_job_system();
+} // namespace engine
@@ -2,36 +2,284 @@
 #include "engine/log_history.h"
 #include "engine/api.h"
 #include <stdarg.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
 
-std::mutex logMutex;
-std::deque<LogItem> logHistory;
+// Producers format a message on the stack and push it into a bounded lock-free queue,
+// a writer thread prints it and appends it to the history read by the log window.
 
-void debug_common(const char *fmt, LogType message_type, va_list args)
+constexpr int MESSAGE_LEN = 1024;
+constexpr size_t QUEUE_CAPACITY = 1024; // power of two
+// identical messages above this rate are dropped
+constexpr uint32_t MAX_REPEATS_PER_SECOND = 5;
+
+struct LogRecord
+{
+  LogType type;
+  char message[MESSAGE_LEN];
+};
+
+// bounded multi-producer single-consumer queue (D. Vyukov), the writer thread is the consumer
+struct LogQueue
+{
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    LogRecord record;
+  };
+  Cell cells[QUEUE_CAPACITY];
+  alignas(64) std::atomic<size_t> enqueuePos = 0;
+  alignas(64) std::atomic<size_t> dequeuePos = 0;
+
+  LogQueue()
+  {
+    for (size_t i = 0; i < QUEUE_CAPACITY; i++)
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  bool push(const LogRecord &record)
+  {
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    while (true)
+    {
+      Cell &cell = cells[pos & (QUEUE_CAPACITY - 1)];
+      const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      const intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+      if (diff == 0)
+      {
+        if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+          cell.record.type = record.type;
+          strcpy(cell.record.message, record.message);
+          cell.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (diff < 0)
+        return false; // full
+      else
+        pos = enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+
+  bool pop(LogRecord &record)
+  {
+    const size_t pos = dequeuePos.load(std::memory_order_relaxed);
+    Cell &cell = cells[pos & (QUEUE_CAPACITY - 1)];
+    if (cell.sequence.load(std::memory_order_acquire) != pos + 1)
+      return false;
+    record = cell.record;
+    cell.sequence.store(pos + QUEUE_CAPACITY, std::memory_order_release);
+    dequeuePos.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+};
+
+// written by the writer thread only, every entry is guarded by a seqlock
+struct LogHistory
 {
-  constexpr int messageLen = 1024, timeLen = 20;
-  char messageBuf[messageLen], timeBuf[timeLen];
-  vsnprintf(messageBuf, messageLen, fmt, args);
-  snprintf(timeBuf, timeLen, "[%.2f] ", engine::get_time());
+  struct Entry
+  {
+    std::atomic<uint32_t> version = 0;
+    uint64_t index = 0;
+    LogRecord record;
+  };
+  Entry entries[engine::MAX_LOG_HISTORY];
+  std::atomic<uint64_t> count = 0;
 
-  std::string logConcat = std::string(timeBuf) + std::string(messageBuf);
+  void push(const LogRecord &record)
+  {
+    const uint64_t idx = count.load(std::memory_order_relaxed);
+    Entry &entry = entries[idx % engine::MAX_LOG_HISTORY];
+    const uint32_t version = entry.version.load(std::memory_order_relaxed);
+    entry.version.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    entry.index = idx;
+    entry.record = record;
+    entry.version.store(version + 2, std::memory_order_release);
+    count.store(idx + 1, std::memory_order_release);
+  }
 
-  if (message_type == LogType::Error)
+  bool read(uint64_t idx, LogRecord &record) const
   {
-    fprintf(stdout, "\033[31m%s%s\033[39m\n", logConcat.c_str(), messageBuf);
+    const Entry &entry = entries[idx % engine::MAX_LOG_HISTORY];
+    const uint32_t version = entry.version.load(std::memory_order_acquire);
+    if (version & 1)
+      return false;
+    const uint64_t entryIdx = entry.index;
+    record = entry.record;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return entry.version.load(std::memory_order_relaxed) == version && entryIdx == idx;
   }
+};
+
+// per message hash: second of the current window and messages in it
+struct RateLimitSlot
+{
+  std::atomic<uint64_t> hash = 0;
+  std::atomic<uint64_t> state = 0; // second << 32 | count
+};
+
+static LogQueue queue;
+static LogHistory history;
+static RateLimitSlot rateLimits[256];
+static std::atomic<uint64_t> droppedMessages = 0;
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+static void print_record(const LogRecord &record)
+{
+  if (record.type == LogType::Error)
+    fprintf(stdout, "\033[31m%s\033[39m\n", record.message);
   else
+    fprintf(stdout, "%s\n", record.message);
+}
+
+struct LogWriter
+{
+  std::thread thread;
+  std::atomic<bool> running = false;
+  std::atomic<bool> stopped = false;
+  std::once_flag started;
+
+  void start()
   {
-    fprintf(stdout, "%s%s\n", logConcat.c_str(), messageBuf);
+    std::call_once(started, [this]()
+    {
+      running = true;
+      thread = std::thread([this]() { run(); });
+    });
   }
 
+  void drain()
   {
-    std::unique_lock read_write_lock(logMutex);
-    if (logHistory.size() >= engine::MAX_LOG_HISTORY)
+    LogRecord record;
+    bool printed = false;
+    while (queue.pop(record))
+    {
+      print_record(record);
+      history.push(record);
+      printed = true;
+    }
+    static uint64_t reportedDrops = 0;
+    const uint64_t dropped = droppedMessages.load(std::memory_order_relaxed);
+    if (dropped != reportedDrops)
     {
-      logHistory.pop_front();
+      record.type = LogType::Error;
+      snprintf(record.message, MESSAGE_LEN, "[log] %llu messages dropped, queue is full", (unsigned long long)(dropped - reportedDrops));
+      reportedDrops = dropped;
+      print_record(record);
+      history.push(record);
+      printed = true;
     }
-    logHistory.push_back({std::move(logConcat), message_type});
+    if (printed)
+      fflush(stdout);
   }
+
+  void run()
+  {
+    while (running.load(std::memory_order_acquire))
+    {
+      drain();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    drain();
+  }
+
+  ~LogWriter()
+  {
+    stopped = true;
+    running = false;
+    if (thread.joinable())
+      thread.join();
+  }
+};
+static LogWriter writer;
+
+// returns false if the message is repeated too often, suppressed is set when a previous window dropped messages
+static bool rate_limit(const char *message, uint32_t &suppressed)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (const char *c = message; *c; c++)
+    hash = (hash ^ uint8_t(*c)) * 1099511628211ull;
+  RateLimitSlot &slot = rateLimits[hash % 256];
+  // collisions just restart the window, the limiter only has to be approximate
+  if (slot.hash.exchange(hash, std::memory_order_relaxed) != hash)
+    slot.state.store(0, std::memory_order_relaxed);
+
+  const uint32_t now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - startTime).count() + 1;
+  uint64_t state = slot.state.load(std::memory_order_relaxed);
+  while (true)
+  {
+    const uint32_t second = state >> 32, count = uint32_t(state);
+    const uint64_t next = second == now ? state + 1 : (uint64_t(now) << 32) | 1;
+    if (slot.state.compare_exchange_weak(state, next, std::memory_order_relaxed))
+    {
+      if (second != now)
+      {
+        suppressed = count > MAX_REPEATS_PER_SECOND ? count - MAX_REPEATS_PER_SECOND : 0;
+        return true;
+      }
+      suppressed = 0;
+      return count < MAX_REPEATS_PER_SECOND;
+    }
+  }
+}
+
+void debug_common(const char *fmt, LogType message_type, va_list args)
+{
+  // leaves room for the time prefix and the repeats suffix, longer messages are cut and end with "..."
+  constexpr int TEXT_LEN = MESSAGE_LEN - 48;
+  char text[TEXT_LEN];
+  if (vsnprintf(text, TEXT_LEN, fmt, args) >= TEXT_LEN)
+    strcpy(text + TEXT_LEN - 4, "...");
+
+  uint32_t suppressed = 0;
+  if (!rate_limit(text, suppressed))
+    return;
+
+  LogRecord record;
+  record.type = message_type;
+  if (suppressed > 0)
+    snprintf(record.message, MESSAGE_LEN, "[%.2f] %s (%u repeats suppressed)", engine::get_time(), text, suppressed);
+  else
+    snprintf(record.message, MESSAGE_LEN, "[%.2f] %s", engine::get_time(), text);
+
+  // messages logged during static destruction are printed directly
+  if (writer.stopped.load(std::memory_order_relaxed))
+  {
+    print_record(record);
+    return;
+  }
+  writer.start();
+  if (!queue.push(record))
+    droppedMessages.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t get_log_history_count()
+{
+  return history.count.load(std::memory_order_acquire);
+}
+
+void copy_log_history(std::vector<LogItem> &out)
+{
+  out.clear();
+  const uint64_t count = history.count.load(std::memory_order_acquire);
+  const uint64_t first = count > engine::MAX_LOG_HISTORY ? count - engine::MAX_LOG_HISTORY : 0;
+  LogRecord record;
+  for (uint64_t i = first; i < count; i++)
+    if (history.read(i, record))
+      out.push_back({record.message, record.type});
+}
+
+void engine::flush_log()
+{
+  const size_t target = queue.enqueuePos.load(std::memory_order_acquire);
+  while (writer.running.load(std::memory_order_acquire) && queue.dequeuePos.load(std::memory_order_acquire) < target)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
 }
 
 void engine::error(const char *fmt, ...)
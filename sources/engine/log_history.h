@@ -1,7 +1,7 @@
 #pragma once
+#include <cstdint>
 #include <string>
-#include <deque>
-#include <mutex>
+#include <vector>
 
 enum class LogType
 {
@@ -15,5 +15,8 @@ struct LogItem
   LogType LogType;
 };
 
-extern std::mutex logMutex;
-extern std::deque<LogItem> logHistory;
\ No newline at end of file
+// number of messages added to the history so far, changes when the history does
+uint64_t get_log_history_count();
+
+// lock-free copy of the last MAX_LOG_HISTORY messages, oldest first
+void copy_log_history(std::vector<LogItem> &out);
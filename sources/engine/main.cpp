@@ -5,8 +5,14 @@
 #include <SDL2/SDL.h>
 #include <iostream>
 #include <map>
+#include <string>
+#include <vector>
 #include "engine/event.h"
 #include "engine/log_history.h"
+#include "engine/memory.h"
+#include "engine/profiler.h"
+#include "engine/replay.h"
+#include "render/texture2d.h"
 
 // forward declarations for game's entry points
 extern void game_init();
@@ -26,7 +32,7 @@ struct SDLContext
 
 SDLContext context;
 
-static void init_application()
+static void init_application(bool headless)
 {
   SDL_Init(SDL_INIT_EVERYTHING);
   SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, 0);
@@ -39,6 +45,9 @@ static void init_application()
 
   const char *PROJECT_NAME = "animations";
   int window_flags = SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_MAXIMIZED;
+  // headless replay still needs a gl context to load meshes and textures
+  if (headless)
+    window_flags = SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN;
   context.window = SDL_CreateWindow(PROJECT_NAME, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1024, 512, (SDL_WindowFlags)(window_flags));
   context.gl_context = SDL_GL_CreateContext(context.window);
   SDL_GL_MakeCurrent(context.window, context.gl_context);
@@ -63,6 +72,7 @@ static void init_application()
 
 static void close_application()
 {
+  stop_texture_streaming();
   game_terminate();
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplSDL2_Shutdown();
@@ -103,6 +113,48 @@ namespace engine
 
 }
 
+// input which reaches the game, the same path is used for live and replayed events
+// subscribers are called at EventPhase::Input
+static void dispatch_input_event(const SDL_Event &event)
+{
+  switch (event.type)
+  {
+  case SDL_KEYDOWN:
+  case SDL_KEYUP:
+    if (!event.key.repeat)
+    {
+      if (event.key.state == SDL_PRESSED)
+        engine::keyMap[event.key.keysym.sym] = true;
+      if (event.key.state == SDL_RELEASED)
+        engine::keyMap[event.key.keysym.sym] = false;
+    }
+    engine::onKeyboardEvent.post(event.key);
+    break;
+
+  case SDL_MOUSEBUTTONDOWN:
+  case SDL_MOUSEBUTTONUP:
+    engine::onMouseButtonEvent.post(event.button);
+    break;
+
+  case SDL_MOUSEMOTION:
+    engine::onMouseMotionEvent.post(event.motion);
+    break;
+
+  case SDL_MOUSEWHEEL:
+    engine::onMouseWheelEvent.post(event.wheel);
+    break;
+  }
+}
+
+static void forward_input_event(const SDL_Event &event)
+{
+  // replay feeds recorded events instead of live ones
+  if (engine::get_replay_mode() == engine::ReplayMode::Replay)
+    return;
+  engine::record_input_event(event);
+  dispatch_input_event(event);
+}
+
 static bool sdl_event_handler()
 {
   SDL_Event event;
@@ -120,35 +172,19 @@ static bool sdl_event_handler()
     case SDL_KEYUP:
       if (ImGui::GetIO().WantCaptureKeyboard)
         break;
-      if (!event.key.repeat)
-      {
-        if (event.key.state == SDL_PRESSED)
-          engine::keyMap[event.key.keysym.sym] = true;
-        if (event.key.state == SDL_RELEASED)
-          engine::keyMap[event.key.keysym.sym] = false;
-      }
-      engine::onKeyboardEvent(event.key);
+      forward_input_event(event);
 
       if (event.key.keysym.sym == SDLK_ESCAPE)
         running = false;
+      break;
 
     case SDL_MOUSEBUTTONDOWN:
     case SDL_MOUSEBUTTONUP:
-      if (ImGui::GetIO().WantCaptureMouse)
-        break;
-      engine::onMouseButtonEvent(event.button);
-      break;
-
     case SDL_MOUSEMOTION:
-      if (ImGui::GetIO().WantCaptureMouse)
-        break;
-      engine::onMouseMotionEvent(event.motion);
-      break;
-
     case SDL_MOUSEWHEEL:
       if (ImGui::GetIO().WantCaptureMouse)
         break;
-      engine::onMouseWheelEvent(event.wheel);
+      forward_input_event(event);
       break;
 
     case SDL_WINDOWEVENT:
@@ -158,62 +194,134 @@ static bool sdl_event_handler()
   return running;
 }
 
-void main_loop()
+struct LaunchOptions
+{
+  std::string recordPath;
+  std::string replayPath;
+  float fixedDeltaTime = 1.f / 60.f;
+  bool headless = false; // replay without rendering
+};
+
+static LaunchOptions parse_launch_options(int argc, char **argv)
+{
+  LaunchOptions options;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if (arg == "--record" && i + 1 < argc)
+      options.recordPath = argv[++i];
+    else if (arg == "--replay" && i + 1 < argc)
+      options.replayPath = argv[++i];
+    else if (arg == "--fixed-dt" && i + 1 < argc)
+      options.fixedDeltaTime = std::stof(argv[++i]);
+    else if (arg == "--headless")
+      options.headless = true;
+    else
+      engine::error("Unknown argument \"%s\"", arg.c_str());
+  }
+  if (options.replayPath.empty())
+    options.headless = false;
+  return options;
+}
+
+void main_loop(const LaunchOptions &options)
 {
   engine::start_time();
   game_init();
 
+  if (!options.replayPath.empty())
+    engine::start_replay(options.replayPath, options.fixedDeltaTime);
+  else if (!options.recordPath.empty())
+    engine::start_recording(options.recordPath);
+
   static std::pair<int, int> lastWindowSize = engine::get_screen_size();
+  engine::set_profiler_thread_name("Main");
 
+  std::vector<SDL_Event> replayedEvents;
   bool running = true;
   while (running)
   {
     engine::update_time();
+    engine::profiler_new_frame();
 
-    running = sdl_event_handler();
+    {
+      PROFILE_ZONE("events");
+      running = sdl_event_handler();
+      if (running && !engine::replay_frame(replayedEvents))
+        running = false;
+      for (const SDL_Event &event : replayedEvents)
+        dispatch_input_event(event);
+    }
 
     std::pair<int, int> windowSize = engine::get_screen_size();
     if (windowSize != lastWindowSize)
     {
       lastWindowSize = windowSize;
-      engine::onWindowResizedEvent(windowSize);
+      engine::onWindowResizedEvent.post(windowSize);
     }
+    engine::dispatch_events(engine::EventPhase::Input);
 
     if (running)
     {
-      game_update();
-      SDL_GL_SwapWindow(context.window);
-
-      game_render();
+      {
+        PROFILE_ZONE("update");
+        game_update();
+        engine::dispatch_events(engine::EventPhase::PostUpdate);
+      }
+      if (options.headless)
+        continue;
+      {
+        PROFILE_ZONE("swap");
+        SDL_GL_SwapWindow(context.window);
+      }
+      {
+        PROFILE_ZONE("render");
+        PROFILE_GPU_ZONE("render");
+        update_texture_streaming();
+        game_render();
+      }
 
+      PROFILE_ZONE("imgui");
       ImGui_ImplOpenGL3_NewFrame();
       ImGui_ImplSDL2_NewFrame(context.window);
       ImGui::NewFrame();
       {
         if (ImGui::Begin("Log History"))
         {
-          std::unique_lock read_write_lock(logMutex);
+          static std::vector<LogItem> logHistory;
+          static uint64_t logHistoryCount = 0;
+          if (get_log_history_count() != logHistoryCount)
+          {
+            logHistoryCount = get_log_history_count();
+            copy_log_history(logHistory);
+          }
           for (const LogItem &m : logHistory)
             ImGui::TextColored(m.LogType == LogType::Log ? ImVec4(1, 1, 1, 1) : ImVec4(1, 0.1f, 0.1f, 1), "%s", m.message.c_str());
         }
         ImGui::End();
 
+        engine::show_profiler();
         game_imgui_render();
       }
 
       ImGui::Render();
+      PROFILE_GPU_ZONE("imgui");
       ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
     }
   }
+  engine::stop_replay();
 }
 
-int main(int, char **)
+int main(int argc, char **argv)
 {
-  init_application();
+  engine::init_memory_tracking();
+  LaunchOptions options = parse_launch_options(argc, argv);
+  init_application(options.headless);
 
-  main_loop();
+  main_loop(options);
 
   close_application();
+  engine::flush_log();
 
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,72 @@
+#include "engine/mapped_file.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace engine
+{
+#ifdef _WIN32
+  MappedFile::MappedFile(const char *path)
+  {
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+      return;
+    LARGE_INTEGER size;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+      mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view)
+    {
+      if (mapping)
+        CloseHandle(mapping);
+      CloseHandle(file);
+      return;
+    }
+    mappedData = static_cast<const uint8_t *>(view);
+    mappedSize = size_t(size.QuadPart);
+    fileHandle = file;
+    mappingHandle = mapping;
+  }
+
+  MappedFile::~MappedFile()
+  {
+    if (!mappedData)
+      return;
+    UnmapViewOfFile(mappedData);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+  }
+#else
+  MappedFile::MappedFile(const char *path)
+  {
+    const int file = open(path, O_RDONLY);
+    if (file < 0)
+      return;
+    struct stat info;
+    void *view = MAP_FAILED;
+    if (fstat(file, &info) == 0 && info.st_size > 0)
+      view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    // the mapping keeps its own reference to the file
+    close(file);
+    if (view == MAP_FAILED)
+      return;
+    madvise(view, size_t(info.st_size), MADV_SEQUENTIAL);
+    mappedData = static_cast<const uint8_t *>(view);
+    mappedSize = size_t(info.st_size);
+  }
+
+  MappedFile::~MappedFile()
+  {
+    if (mappedData)
+      munmap(const_cast<uint8_t *>(mappedData), mappedSize);
+  }
+#endif
+} // namespace engine
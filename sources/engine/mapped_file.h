@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace engine
+{
+  // read-only view of a whole file, pages are read by the OS on first access, no copy into the heap
+  class MappedFile
+  {
+    const uint8_t *mappedData = nullptr;
+    size_t mappedSize = 0;
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+
+  public:
+    MappedFile() = default;
+    // check is_open(), a missing or empty file isn't an error for the caller
+    explicit MappedFile(const char *path);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool is_open() const { return mappedData != nullptr; }
+    const uint8_t *data() const { return mappedData; }
+    size_t size() const { return mappedSize; }
+  };
+} // namespace engine
@@ -0,0 +1,161 @@
+#include "engine/memory.h"
+#include "engine/api.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <ozz/base/memory/allocator.h>
+
+namespace engine
+{
+  static const char *tagNames[] = {
+    "Other",
+    "Animation clips",
+    "Sampling contexts",
+    "Feature data base",
+    "Meshes",
+    "Physics",
+  };
+  static_assert(sizeof(tagNames) / sizeof(tagNames[0]) == size_t(MemoryTag::Count));
+
+  struct TagCounters
+  {
+    std::atomic<size_t> liveBytes = 0;
+    std::atomic<size_t> peakBytes = 0;
+    std::atomic<size_t> liveAllocations = 0;
+    std::atomic<uint64_t> totalAllocations = 0;
+  };
+  static TagCounters counters[size_t(MemoryTag::Count)];
+
+  static thread_local MemoryTag currentTag = MemoryTag::Other;
+
+  // stored right before every block returned by tracked_allocate
+  struct AllocationHeader
+  {
+    size_t size;
+    uint32_t offset; // from the start of malloc'ed memory to the block
+    uint32_t alignment;
+    MemoryTag tag;
+  };
+  static_assert(sizeof(AllocationHeader) <= 32);
+
+  const char *get_memory_tag_name(MemoryTag tag)
+  {
+    return tagNames[size_t(tag)];
+  }
+
+  void track_allocation(MemoryTag tag, size_t size)
+  {
+    TagCounters &c = counters[size_t(tag)];
+    const size_t live = c.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    size_t peak = c.peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !c.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+    {
+    }
+    c.liveAllocations.fetch_add(1, std::memory_order_relaxed);
+    c.totalAllocations.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void track_deallocation(MemoryTag tag, size_t size)
+  {
+    TagCounters &c = counters[size_t(tag)];
+    c.liveBytes.fetch_sub(size, std::memory_order_relaxed);
+    c.liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void *tracked_allocate(MemoryTag tag, size_t size, size_t alignment)
+  {
+    alignment = std::max<size_t>(alignment, 16);
+    const size_t headerSize = (sizeof(AllocationHeader) + alignment - 1) & ~(alignment - 1);
+    char *memory = static_cast<char *>(std::malloc(size + headerSize + alignment - 1));
+    if (!memory)
+      return nullptr;
+    const uintptr_t block = (reinterpret_cast<uintptr_t>(memory) + headerSize + alignment - 1) & ~uintptr_t(alignment - 1);
+    AllocationHeader *header = reinterpret_cast<AllocationHeader *>(block) - 1;
+    header->size = size;
+    header->offset = uint32_t(block - reinterpret_cast<uintptr_t>(memory));
+    header->alignment = uint32_t(alignment);
+    header->tag = tag;
+    track_allocation(tag, size);
+    return reinterpret_cast<void *>(block);
+  }
+
+  void *tracked_reallocate(MemoryTag tag, void *block, size_t size, size_t alignment)
+  {
+    if (!block)
+      return tracked_allocate(tag, size, alignment);
+    const AllocationHeader *header = static_cast<const AllocationHeader *>(block) - 1;
+    void *newBlock = tracked_allocate(header->tag, size, std::max<size_t>(alignment, header->alignment));
+    if (newBlock)
+    {
+      std::memcpy(newBlock, block, std::min(size, header->size));
+      tracked_free(block);
+    }
+    return newBlock;
+  }
+
+  void tracked_free(void *block)
+  {
+    if (!block)
+      return;
+    const AllocationHeader *header = static_cast<const AllocationHeader *>(block) - 1;
+    track_deallocation(header->tag, header->size);
+    std::free(static_cast<char *>(block) - header->offset);
+  }
+
+  MemoryTag get_current_memory_tag()
+  {
+    return currentTag;
+  }
+
+  MemoryTagScope::MemoryTagScope(MemoryTag tag) : previous(currentTag)
+  {
+    currentTag = tag;
+  }
+
+  MemoryTagScope::~MemoryTagScope()
+  {
+    currentTag = previous;
+  }
+
+  MemoryStats get_memory_stats(MemoryTag tag)
+  {
+    const TagCounters &c = counters[size_t(tag)];
+    MemoryStats stats;
+    stats.liveBytes = c.liveBytes.load(std::memory_order_relaxed);
+    stats.peakBytes = c.peakBytes.load(std::memory_order_relaxed);
+    stats.liveAllocations = c.liveAllocations.load(std::memory_order_relaxed);
+    stats.totalAllocations = c.totalAllocations.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  void dump_memory_stats()
+  {
+    engine::log("%-20s %12s %12s %10s %12s", "tag", "live KB", "peak KB", "live", "allocations");
+    for (size_t i = 0; i < size_t(MemoryTag::Count); i++)
+    {
+      MemoryStats stats = get_memory_stats(MemoryTag(i));
+      engine::log("%-20s %12.1f %12.1f %10zu %12llu", tagNames[i], stats.liveBytes / 1024.f, stats.peakBytes / 1024.f,
+        stats.liveAllocations, (unsigned long long)stats.totalAllocations);
+    }
+  }
+
+  class TrackingOzzAllocator final : public ozz::memory::Allocator
+  {
+  public:
+    void *Allocate(size_t _size, size_t _alignment) override
+    {
+      return tracked_allocate(currentTag, _size, _alignment);
+    }
+    void Deallocate(void *_block) override
+    {
+      tracked_free(_block);
+    }
+  };
+
+  void init_memory_tracking()
+  {
+    static TrackingOzzAllocator ozzAllocator;
+    ozz::memory::SetDefaulAllocator(&ozzAllocator);
+  }
+} // namespace engine
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace engine
+{
+  // MEMORY SUBSYSTEM //
+
+  // subsystem which owns an allocation
+  enum class MemoryTag : uint8_t
+  {
+    Other,
+    AnimationClips,
+    SamplingContexts,
+    FeatureDataBase,
+    Meshes,
+    Physics,
+    Count
+  };
+
+  const char *get_memory_tag_name(MemoryTag tag);
+
+  struct MemoryStats
+  {
+    size_t liveBytes = 0;
+    size_t peakBytes = 0;
+    size_t liveAllocations = 0;
+    uint64_t totalAllocations = 0; // since start, allocation rate is its derivative
+  };
+
+  MemoryStats get_memory_stats(MemoryTag tag);
+
+  // log live, peak and allocation count of every tag
+  void dump_memory_stats();
+
+  // routes ozz::memory allocations through the tracking allocator, call before any ozz allocation
+  void init_memory_tracking();
+
+  // allocations made through the tracking allocator on this thread get the tag of the innermost scope
+  MemoryTag get_current_memory_tag();
+  struct MemoryTagScope
+  {
+    MemoryTag previous;
+    explicit MemoryTagScope(MemoryTag tag);
+    ~MemoryTagScope();
+    MemoryTagScope(const MemoryTagScope &) = delete;
+    MemoryTagScope &operator=(const MemoryTagScope &) = delete;
+  };
+
+  // malloc with accounting, used by allocator hooks of the third party libraries
+  void *tracked_allocate(MemoryTag tag, size_t size, size_t alignment);
+  // keeps the tag of the block, a null block is allocated under tag
+  void *tracked_reallocate(MemoryTag tag, void *block, size_t size, size_t alignment);
+  void tracked_free(void *block);
+
+  // accounting for memory that doesn't live in the process heap, e.g. GL buffers
+  void track_allocation(MemoryTag tag, size_t size);
+  void track_deallocation(MemoryTag tag, size_t size);
+} // namespace engine
@@ -0,0 +1,478 @@
+#include "engine/profiler.h"
+#include "engine/api.h"
+#include "glad/glad.h"
+#include "imgui/imgui.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace engine
+{
+  struct ZoneRecord
+  {
+    const char *name;
+    uint64_t start, end; // nanoseconds
+    uint32_t depth;
+  };
+
+  // ring buffer of finished zones, written only by the owner thread
+  struct ThreadZones
+  {
+    static constexpr uint64_t CAPACITY = 1 << 16;
+    std::string name;
+    std::unique_ptr<ZoneRecord[]> records = std::make_unique<ZoneRecord[]>(CAPACITY);
+    std::atomic<uint64_t> written = 0; // record i lives in records[i % CAPACITY]
+    uint32_t depth = 0;
+
+    void push(const ZoneRecord &record)
+    {
+      const uint64_t idx = written.load(std::memory_order_relaxed);
+      records[idx % CAPACITY] = record;
+      written.store(idx + 1, std::memory_order_release);
+    }
+  };
+
+  static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  static std::atomic<bool> enabled = false;
+
+  static std::mutex threadsMutex;
+  // threads are never removed, zones of a finished thread stay available for traces
+  static std::vector<std::unique_ptr<ThreadZones>> threads;
+  static thread_local ThreadZones *currentThread = nullptr;
+
+  static ThreadZones *register_thread(const char *name)
+  {
+    std::unique_lock lock(threadsMutex);
+    ThreadZones *zones = threads.emplace_back(std::make_unique<ThreadZones>()).get();
+    zones->name = name ? name : "Thread " + std::to_string(threads.size() - 1);
+    return zones;
+  }
+
+  static ThreadZones &get_thread_zones()
+  {
+    if (!currentThread)
+      currentThread = register_thread(nullptr);
+    return *currentThread;
+  }
+
+  uint64_t get_profiler_time_ns()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+  }
+
+  void set_profiler_enabled(bool value)
+  {
+    enabled.store(value, std::memory_order_relaxed);
+  }
+
+  bool is_profiler_enabled()
+  {
+    return enabled.load(std::memory_order_relaxed);
+  }
+
+  void set_profiler_thread_name(const char *name)
+  {
+    ThreadZones &zones = get_thread_zones();
+    std::unique_lock lock(threadsMutex);
+    zones.name = name;
+  }
+
+  ProfileScope::ProfileScope(const char *zone_name)
+  {
+    if (!enabled.load(std::memory_order_relaxed))
+      return;
+    name = zone_name;
+    depth = get_thread_zones().depth++;
+    start = get_profiler_time_ns();
+  }
+
+  ProfileScope::~ProfileScope()
+  {
+    if (!name)
+      return;
+    const uint64_t end = get_profiler_time_ns();
+    ThreadZones &zones = get_thread_zones();
+    zones.depth--;
+    zones.push({name, start, end, depth});
+  }
+
+  // COUNTERS //
+
+  struct CounterTrack
+  {
+    static constexpr size_t CAPACITY = 512;
+    const char *name;
+    uint64_t times[CAPACITY];
+    float values[CAPACITY];
+    uint64_t written = 0;
+  };
+  static std::mutex countersMutex;
+  static std::vector<std::unique_ptr<CounterTrack>> counters;
+
+  void profile_counter(const char *name, float value)
+  {
+    if (!enabled.load(std::memory_order_relaxed))
+      return;
+    const uint64_t time = get_profiler_time_ns();
+    std::unique_lock lock(countersMutex);
+    auto it = std::find_if(counters.begin(), counters.end(), [name](const auto &track) { return track->name == name; });
+    CounterTrack &track = it != counters.end() ? **it : *counters.emplace_back(std::make_unique<CounterTrack>());
+    track.name = name;
+    track.times[track.written % CounterTrack::CAPACITY] = time;
+    track.values[track.written % CounterTrack::CAPACITY] = value;
+    track.written++;
+  }
+
+  static void show_counters()
+  {
+    std::unique_lock lock(countersMutex);
+    for (const auto &track : counters)
+    {
+      const int count = int(std::min<uint64_t>(track->written, CounterTrack::CAPACITY));
+      const int offset = track->written > CounterTrack::CAPACITY ? int(track->written % CounterTrack::CAPACITY) : 0;
+      const float last = track->values[(track->written - 1) % CounterTrack::CAPACITY];
+      char overlay[64];
+      snprintf(overlay, sizeof(overlay), "%.3f", last);
+      ImGui::PlotLines(track->name, track->values, count, offset, overlay, FLT_MAX, FLT_MAX, ImVec2(0, 40));
+    }
+  }
+
+  // FRAMES //
+
+  static constexpr uint64_t FRAME_HISTORY = 256;
+  // GL query results are read back this many frames after they were issued
+  static constexpr uint64_t GPU_LATENCY_FRAMES = 4;
+  static uint64_t frameStarts[FRAME_HISTORY];
+  static uint64_t frameIndex = 0;
+
+  static uint64_t frame_start(uint64_t frame)
+  {
+    return frameStarts[frame % FRAME_HISTORY];
+  }
+
+  // GPU ZONES //
+
+  struct GpuZone
+  {
+    const char *name;
+    GLuint queries[2];
+    uint32_t depth;
+  };
+  static std::vector<GpuZone> pendingGpuZones; // in issue order
+  static std::vector<GLuint> freeQueries;
+  static uint32_t gpuDepth = 0;
+  static int64_t gpuClockOffset = 0; // cpu time - gl time, nanoseconds
+  static ThreadZones *gpuThread = nullptr;
+
+  static GLuint acquire_query()
+  {
+    if (freeQueries.empty())
+    {
+      GLuint queries[32];
+      glGenQueries(32, queries);
+      freeQueries.insert(freeQueries.end(), queries, queries + 32);
+    }
+    GLuint query = freeQueries.back();
+    freeQueries.pop_back();
+    return query;
+  }
+
+  GpuProfileScope::GpuProfileScope(const char *zone_name)
+  {
+    if (!enabled.load(std::memory_order_relaxed))
+      return;
+    GpuZone gpuZone;
+    gpuZone.name = zone_name;
+    gpuZone.queries[0] = acquire_query();
+    gpuZone.queries[1] = acquire_query();
+    gpuZone.depth = gpuDepth++;
+    glQueryCounter(gpuZone.queries[0], GL_TIMESTAMP);
+    zone = pendingGpuZones.size();
+    pendingGpuZones.push_back(gpuZone);
+  }
+
+  GpuProfileScope::~GpuProfileScope()
+  {
+    if (zone < 0)
+      return;
+    gpuDepth--;
+    glQueryCounter(pendingGpuZones[zone].queries[1], GL_TIMESTAMP);
+  }
+
+  static void resolve_gpu_zones()
+  {
+    size_t resolved = 0;
+    for (; resolved < pendingGpuZones.size(); resolved++)
+    {
+      const GpuZone &gpuZone = pendingGpuZones[resolved];
+      GLint available = 0;
+      glGetQueryObjectiv(gpuZone.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available)
+        break;
+      GLuint64 start = 0, end = 0;
+      glGetQueryObjectui64v(gpuZone.queries[0], GL_QUERY_RESULT, &start);
+      glGetQueryObjectui64v(gpuZone.queries[1], GL_QUERY_RESULT, &end);
+      gpuThread->push({gpuZone.name, uint64_t(int64_t(start) + gpuClockOffset), uint64_t(int64_t(end) + gpuClockOffset), gpuZone.depth});
+      freeQueries.push_back(gpuZone.queries[0]);
+      freeQueries.push_back(gpuZone.queries[1]);
+    }
+    pendingGpuZones.erase(pendingGpuZones.begin(), pendingGpuZones.begin() + resolved);
+  }
+
+  // TIMELINE //
+
+  struct TimelineZone
+  {
+    ZoneRecord record;
+    uint32_t thread;
+  };
+
+  // copies zones started in [from, to), records overwritten during the copy are dropped
+  static void collect_zones(uint64_t from, uint64_t to, std::vector<TimelineZone> &out, std::vector<std::string> &thread_names)
+  {
+    std::unique_lock lock(threadsMutex);
+    thread_names.resize(threads.size());
+    std::vector<std::pair<uint64_t, ZoneRecord>> copied;
+    for (size_t t = 0; t < threads.size(); t++)
+    {
+      ThreadZones &zones = *threads[t];
+      thread_names[t] = zones.name;
+      const uint64_t written = zones.written.load(std::memory_order_acquire);
+      const uint64_t first = written > ThreadZones::CAPACITY ? written - ThreadZones::CAPACITY : 0;
+      copied.clear();
+      for (uint64_t i = first; i < written; i++)
+      {
+        const ZoneRecord &record = zones.records[i % ThreadZones::CAPACITY];
+        if (record.start >= from && record.start < to)
+          copied.emplace_back(i, record);
+      }
+      const uint64_t writtenAfter = zones.written.load(std::memory_order_acquire);
+      const uint64_t valid = writtenAfter > ThreadZones::CAPACITY ? writtenAfter - ThreadZones::CAPACITY : 0;
+      for (const auto &[idx, record] : copied)
+        if (idx >= valid)
+          out.push_back({record, uint32_t(t)});
+    }
+  }
+
+  void get_profile_zone_totals(uint64_t from, uint64_t to, std::vector<ProfileZoneTotal> &totals)
+  {
+    std::vector<TimelineZone> zones;
+    std::vector<std::string> threadNames;
+    collect_zones(from, to, zones, threadNames);
+    for (const TimelineZone &zone : zones)
+    {
+      const ZoneRecord &record = zone.record;
+      // the same name may come from different string literals
+      auto it = std::find_if(totals.begin(), totals.end(), [&](const ProfileZoneTotal &total)
+        { return total.name == record.name || strcmp(total.name, record.name) == 0; });
+      ProfileZoneTotal &total = it != totals.end() ? *it : totals.emplace_back(ProfileZoneTotal{record.name});
+      total.totalNs += record.end - record.start;
+      total.count++;
+    }
+  }
+
+  static ImU32 zone_color(const char *name)
+  {
+    const uint32_t hash = uint32_t(reinterpret_cast<uintptr_t>(name) * 2654435761u);
+    return ImColor::HSV((hash % 360) / 360.f, 0.5f, 0.7f);
+  }
+
+  static void draw_timeline(const std::vector<TimelineZone> &zones, const std::vector<std::string> &thread_names, uint64_t from, uint64_t to, float zoom)
+  {
+    ImGui::BeginChild("timeline", ImVec2(0, 0), true, ImGuiWindowFlags_HorizontalScrollbar);
+    const float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+    const float width = ImGui::GetContentRegionAvail().x * zoom;
+    const float scale = width / float(std::max<uint64_t>(to - from, 1));
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImDrawList *drawList = ImGui::GetWindowDrawList();
+
+    float y = 0.f;
+    for (uint32_t thread = 0; thread < thread_names.size(); thread++)
+    {
+      uint32_t maxDepth = 0;
+      bool hasZones = false;
+      for (const TimelineZone &zone : zones)
+      {
+        if (zone.thread != thread)
+          continue;
+        hasZones = true;
+        maxDepth = std::max(maxDepth, zone.record.depth);
+      }
+      if (!hasZones)
+        continue;
+
+      drawList->AddText(ImVec2(origin.x, origin.y + y), IM_COL32_WHITE, thread_names[thread].c_str());
+      y += rowHeight;
+      for (const TimelineZone &zone : zones)
+      {
+        if (zone.thread != thread)
+          continue;
+        const ZoneRecord &record = zone.record;
+        const float x0 = origin.x + (record.start - from) * scale;
+        const float x1 = std::max(x0 + 1.f, origin.x + (std::min(record.end, to) - from) * scale);
+        const float top = origin.y + y + record.depth * rowHeight;
+        const ImVec2 min(x0, top), max(x1, top + rowHeight - 1.f);
+        drawList->AddRectFilled(min, max, zone_color(record.name));
+        if (ImGui::CalcTextSize(record.name).x < x1 - x0)
+          drawList->AddText(ImVec2(x0 + 2.f, top), IM_COL32_WHITE, record.name);
+        if (ImGui::IsMouseHoveringRect(min, max))
+          ImGui::SetTooltip("%s\n%.3f ms", record.name, (record.end - record.start) * 1e-6);
+      }
+      y += (maxDepth + 1) * rowHeight;
+    }
+    ImGui::Dummy(ImVec2(width, y));
+    ImGui::EndChild();
+  }
+
+  // CHROME TRACE //
+
+  struct TraceCapture
+  {
+    uint64_t firstFrame = 0, lastFrame = 0; // [first, last)
+    std::string path;
+    bool active = false;
+  };
+  static TraceCapture capture;
+
+  static void write_chrome_trace(const TraceCapture &trace)
+  {
+    std::vector<TimelineZone> zones;
+    std::vector<std::string> threadNames;
+    const uint64_t from = frame_start(trace.firstFrame), to = frame_start(trace.lastFrame);
+    collect_zones(from, to, zones, threadNames);
+
+    std::ofstream file(trace.path);
+    if (!file)
+    {
+      engine::error("Failed to write trace \"%s\"", trace.path.c_str());
+      return;
+    }
+    char event[512];
+    const char *separator = "";
+    auto write_event = [&]()
+    {
+      file << separator << event;
+      separator = ",\n";
+    };
+    file << "{\"traceEvents\":[\n";
+    for (size_t t = 0; t < threadNames.size(); t++)
+    {
+      snprintf(event, sizeof(event), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"%s\"}}", t, threadNames[t].c_str());
+      write_event();
+    }
+    for (uint64_t frame = trace.firstFrame; frame < trace.lastFrame; frame++)
+    {
+      snprintf(event, sizeof(event), "{\"name\":\"Frame %llu\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":0}", (unsigned long long)frame, frame_start(frame) * 1e-3);
+      write_event();
+    }
+    {
+      std::unique_lock lock(countersMutex);
+      for (const auto &track : counters)
+      {
+        const uint64_t first = track->written > CounterTrack::CAPACITY ? track->written - CounterTrack::CAPACITY : 0;
+        for (uint64_t i = first; i < track->written; i++)
+        {
+          const uint64_t time = track->times[i % CounterTrack::CAPACITY];
+          if (time < from || time >= to)
+            continue;
+          snprintf(event, sizeof(event), "{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{\"value\":%f}}",
+            track->name, time * 1e-3, track->values[i % CounterTrack::CAPACITY]);
+          write_event();
+        }
+      }
+    }
+    for (const TimelineZone &zone : zones)
+    {
+      const ZoneRecord &record = zone.record;
+      snprintf(event, sizeof(event), "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+        record.name, record.start * 1e-3, (record.end - record.start) * 1e-3, zone.thread);
+      write_event();
+    }
+    file << "\n]}\n";
+    engine::log("Trace of %llu frames saved to \"%s\", %zu zones",
+      (unsigned long long)(trace.lastFrame - trace.firstFrame), trace.path.c_str(), zones.size());
+  }
+
+  void capture_chrome_trace(int frames, const std::string &path)
+  {
+    frames = std::clamp<int>(frames, 1, FRAME_HISTORY - GPU_LATENCY_FRAMES - 2);
+    capture.firstFrame = frameIndex + 1;
+    capture.lastFrame = capture.firstFrame + frames;
+    capture.path = path;
+    capture.active = true;
+    set_profiler_enabled(true);
+  }
+
+  void profiler_new_frame()
+  {
+    const uint64_t now = get_profiler_time_ns();
+    frameIndex++;
+    frameStarts[frameIndex % FRAME_HISTORY] = now;
+    // no GL calls while disabled, gpu zones queried before disabling are still resolved
+    if (!is_profiler_enabled() && !capture.active && pendingGpuZones.empty())
+      return;
+
+    if (!gpuThread)
+      gpuThread = register_thread("GPU");
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    gpuClockOffset = int64_t(now) - gpuNow;
+    resolve_gpu_zones();
+
+    if (capture.active && frameIndex >= capture.lastFrame + GPU_LATENCY_FRAMES)
+    {
+      capture.active = false;
+      write_chrome_trace(capture);
+    }
+  }
+
+  void show_profiler()
+  {
+    if (ImGui::Begin("Profiler"))
+    {
+      bool isEnabled = is_profiler_enabled();
+      if (ImGui::Checkbox("Enabled", &isEnabled))
+        set_profiler_enabled(isEnabled);
+      ImGui::SameLine();
+      static bool paused = false;
+      ImGui::Checkbox("Pause", &paused);
+
+      static int captureFrames = 60;
+      ImGui::SliderInt("Trace frames", &captureFrames, 1, 120);
+      if (capture.active)
+        ImGui::Text("Capturing frames %llu..%llu", (unsigned long long)capture.firstFrame, (unsigned long long)capture.lastFrame);
+      else if (ImGui::Button("Capture Chrome trace"))
+        capture_chrome_trace(captureFrames, "profile_trace.json");
+
+      show_counters();
+
+      static float zoom = 1.f;
+      ImGui::SliderFloat("Zoom", &zoom, 1.f, 20.f);
+
+      // gpu zones of the latest frames are not resolved yet
+      static uint64_t shownFrame = 0;
+      if (!paused && frameIndex > GPU_LATENCY_FRAMES)
+        shownFrame = frameIndex - GPU_LATENCY_FRAMES;
+      if (shownFrame == 0 || frameIndex - shownFrame >= FRAME_HISTORY - 1)
+      {
+        ImGui::Text("No frames recorded");
+      }
+      else
+      {
+        const uint64_t from = frame_start(shownFrame), to = frame_start(shownFrame + 1);
+        ImGui::Text("Frame %llu, %.3f ms", (unsigned long long)shownFrame, (to - from) * 1e-6);
+        std::vector<TimelineZone> zones;
+        std::vector<std::string> threadNames;
+        collect_zones(from, to, zones, threadNames);
+        draw_timeline(zones, threadNames, from, to, zoom);
+      }
+    }
+    ImGui::End();
+  }
+} // namespace engine
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace engine
+{
+  // PROFILER SUBSYSTEM //
+
+  // nanoseconds since the program start
+  uint64_t get_profiler_time_ns();
+
+  // zones are recorded only while the profiler is enabled, a disabled zone costs one relaxed load
+  void set_profiler_enabled(bool enabled);
+  bool is_profiler_enabled();
+
+  // name of the calling thread in the timeline and in traces
+  void set_profiler_thread_name(const char *name);
+
+  // CPU zone, name must outlive the profiler (string literal), only the pointer is stored
+  struct ProfileScope
+  {
+    const char *name = nullptr;
+    uint64_t start = 0;
+    uint32_t depth = 0;
+
+    explicit ProfileScope(const char *zone_name);
+    ~ProfileScope();
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+  };
+
+  // GL timestamp queries around GPU work, main thread only, results arrive a few frames later
+  struct GpuProfileScope
+  {
+    int zone = -1;
+
+    explicit GpuProfileScope(const char *zone_name);
+    ~GpuProfileScope();
+    GpuProfileScope(const GpuProfileScope &) = delete;
+    GpuProfileScope &operator=(const GpuProfileScope &) = delete;
+  };
+
+  // value plotted in the profiler window and saved to traces, name must be a string literal
+  void profile_counter(const char *name, float value);
+
+  struct ProfileZoneTotal
+  {
+    const char *name;
+    uint64_t totalNs = 0;
+    uint32_t count = 0;
+  };
+
+  // adds zones of all threads started in [from, to) to totals by name, works without frame markers
+  void get_profile_zone_totals(uint64_t from, uint64_t to, std::vector<ProfileZoneTotal> &totals);
+
+  // frame marker, call on the main thread before the first zone of the frame
+  void profiler_new_frame();
+
+  // records next frames and saves them as Chrome trace events (chrome://tracing or ui.perfetto.dev)
+  void capture_chrome_trace(int frames, const std::string &path);
+
+  // imgui timeline of a recent frame
+  void show_profiler();
+} // namespace engine
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_ZONE(name) engine::ProfileScope PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_GPU_ZONE(name) engine::GpuProfileScope PROFILE_CONCAT(gpuProfileZone, __LINE__)(name)
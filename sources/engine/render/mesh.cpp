@@ -1,6 +1,8 @@
 #include "mesh.h"
 #include <vector>
+#include <algorithm>
 #include "glad/glad.h"
+#include "engine/memory.h"
 
 static void create_indices(std::span<const uint32_t> indices)
 {
@@ -8,6 +10,7 @@ static void create_indices(std::span<const uint32_t> indices)
   glGenBuffers(1, &arrayIndexBuffer);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arrayIndexBuffer);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indices.size(), indices.data(), GL_STATIC_DRAW);
+  engine::track_allocation(engine::MemoryTag::Meshes, sizeof(indices[0]) * indices.size());
   glBindVertexArray(0);
 }
 
@@ -20,6 +23,7 @@ static void init_channel(int channel_index, std::span<const T> channel)
   glGenBuffers(1, &arrayBuffer);
   glBindBuffer(GL_ARRAY_BUFFER, arrayBuffer);
   glBufferData(GL_ARRAY_BUFFER, channel.size() * sizeof(T), channel.data(), GL_STATIC_DRAW);
+  engine::track_allocation(engine::MemoryTag::Meshes, channel.size() * sizeof(T));
   glEnableVertexAttribArray(channel_index);
 
   const int componentCount = T::length();
@@ -53,10 +57,14 @@ MeshPtr create_mesh(
     std::span<const uvec4> weightsIndex,
     std::vector<mat4> &&inverseBindPose,
     std::vector<std::string> &&bonesNames,
-    std::map<std::string, int> &&bonesMap)
+    std::map<std::string, int> &&bonesMap,
+    std::vector<BoundingBox> &&boneBounds,
+    std::vector<MeshLod> &&lods)
 {
   uint32 vertexArrayBufferObject = create_vertex_array_buffer(indices, vertices, normals, uv, weights, weightsIndex);
-  return std::make_shared<Mesh>(name, vertexArrayBufferObject, indices.size(), std::move(inverseBindPose), std::move(bonesNames), std::move(bonesMap));
+  // the index buffer holds all levels, the full mesh is the first range
+  const int numIndices = lods.empty() ? indices.size() : lods[0].numIndices;
+  return std::make_shared<Mesh>(name, vertexArrayBufferObject, numIndices, std::move(inverseBindPose), std::move(bonesNames), std::move(bonesMap), std::move(boneBounds), std::move(lods));
 }
 
 MeshPtr create_mesh(
@@ -77,6 +85,19 @@ void render(const MeshPtr &mesh)
   glDrawElementsBaseVertex(GL_TRIANGLES, mesh->numIndices, GL_UNSIGNED_INT, 0, 0);
 }
 
+void render(const MeshPtr &mesh, int lod)
+{
+  if (mesh->lods.empty())
+  {
+    render(mesh);
+    return;
+  }
+  const MeshLod &level = mesh->lods[std::clamp(lod, 0, int(mesh->lods.size()) - 1)];
+  glBindVertexArray(mesh->vertexArrayBufferObject);
+  const void *offset = reinterpret_cast<const void *>(size_t(level.firstIndex) * sizeof(uint32_t));
+  glDrawElementsBaseVertex(GL_TRIANGLES, level.numIndices, GL_UNSIGNED_INT, offset, 0);
+}
+
 MeshPtr make_plane_mesh()
 {
   std::vector<uint32_t> indices = {0, 1, 2, 0, 2, 3};
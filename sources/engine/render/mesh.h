@@ -8,6 +8,14 @@
 #include "3dmath.h"
 
 
+// range of the index buffer drawn at one detail level
+struct MeshLod
+{
+  uint32_t firstIndex;
+  uint32_t numIndices;
+  float error; // simplification error relative to the mesh radius, 0 for the source level
+};
+
 struct Mesh
 {
   std::string name;
@@ -17,19 +25,25 @@ struct Mesh
   std::vector<mat4> inverseBindPose;
   std::vector<std::string> bonesNames;
   std::map<std::string, int> bonesMap;
+  // per bone, in bone space around the vertices the bone skins, empty if it skins none
+  std::vector<BoundingBox> boneBounds;
+  // [0] is the full mesh, coarser levels follow, empty for meshes without cooked LODs
+  std::vector<MeshLod> lods;
 
   Mesh(const char *name, uint32_t vertexArrayBufferObject, int numIndices) :
     name(name),
     vertexArrayBufferObject(vertexArrayBufferObject),
     numIndices(numIndices)
     {}
-  Mesh(const char *name, uint32_t vertexArrayBufferObject, int numIndices, std::vector<mat4> &&inverseBindPose, std::vector<std::string> &&bonesNames, std::map<std::string, int> &&bonesMap) :
+  Mesh(const char *name, uint32_t vertexArrayBufferObject, int numIndices, std::vector<mat4> &&inverseBindPose, std::vector<std::string> &&bonesNames, std::map<std::string, int> &&bonesMap, std::vector<BoundingBox> &&boneBounds, std::vector<MeshLod> &&lods) :
     name(name),
     vertexArrayBufferObject(vertexArrayBufferObject),
     numIndices(numIndices),
     inverseBindPose(std::move(inverseBindPose)),
     bonesNames(std::move(bonesNames)),
-    bonesMap(std::move(bonesMap))
+    bonesMap(std::move(bonesMap)),
+    boneBounds(std::move(boneBounds)),
+    lods(std::move(lods))
     {}
 };
 
@@ -45,7 +59,9 @@ MeshPtr create_mesh(
     std::span<const uvec4> weightsIndex,
     std::vector<mat4> &&inverseBindPose,
     std::vector<std::string> &&bonesNames,
-    std::map<std::string, int> &&bonesMap);
+    std::map<std::string, int> &&bonesMap,
+    std::vector<BoundingBox> &&boneBounds,
+    std::vector<MeshLod> &&lods);
 
 MeshPtr create_mesh(
     const char *name,
@@ -56,4 +72,7 @@ MeshPtr create_mesh(
 
 MeshPtr make_plane_mesh();
 
-void render(const MeshPtr &mesh);
\ No newline at end of file
+void render(const MeshPtr &mesh);
+
+// draws one level of Mesh::lods, clamped to the coarsest one
+void render(const MeshPtr &mesh, int lod);
\ No newline at end of file
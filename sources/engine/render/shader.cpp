@@ -2,9 +2,13 @@
 #include <iostream>
 #include <map>
 #include "engine/api.h"
+#include "engine/replay.h"
+#include "import/timer.h"
 #include "glad/glad.h"
 #include <filesystem>
 #include <array>
+#include <cstdio>
+#include <cstring>
 #include <vector>
 #include <fstream>
 
@@ -62,6 +66,7 @@ static bool compile_shader(const char *shaderName, const std::vector<ShaderInfo>
 
 
   program = glCreateProgram();
+  glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
   for (GLuint shaderProg : compiled_shaders)
     glAttachShader(program, shaderProg);
 
@@ -88,7 +93,7 @@ static std::string read_file(const char *path)
   return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
 }
 
-static bool compile_shader(const char *name, const Shader::ShaderSources &sources, GLuint &program)
+static std::vector<ShaderInfo> read_shader_sources(const Shader::ShaderSources &sources)
 {
   std::vector<ShaderInfo> shaderCode;
 
@@ -96,7 +101,132 @@ static bool compile_shader(const char *name, const Shader::ShaderSources &source
   {
     shaderCode.emplace_back(ShaderInfo{shaderType, path, read_file(path.c_str())});
   }
-  return compile_shader(name, shaderCode, program);
+  return shaderCode;
+}
+
+static uint64_t hash_shader_sources(const std::vector<ShaderInfo> &shaders)
+{
+  uint64_t hash = engine::hash_bytes(nullptr, 0);
+  for (const ShaderInfo &shader : shaders)
+  {
+    hash = engine::hash_bytes(&shader.shaderType, sizeof(shader.shaderType), hash);
+    hash = engine::hash_bytes(shader.sources.data(), shader.sources.size(), hash);
+  }
+  return hash;
+}
+
+static std::vector<int64_t> get_source_write_times(const Shader::ShaderSources &sources)
+{
+  std::vector<int64_t> times;
+  for (const auto &[shaderType, path] : sources)
+  {
+    std::error_code error;
+    times.push_back(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+  }
+  return times;
+}
+
+// PROGRAM BINARY CACHE //
+
+// binaries are only valid for the driver which produced them, glProgramBinary rejects the rest
+static const char *PROGRAM_BINARY_CACHE_DIR = "shader_cache";
+static const uint32_t PROGRAM_BINARY_MAGIC = 0x4E494250; // "PBIN"
+
+struct ProgramBinaryHeader
+{
+  uint32_t magic;
+  GLenum format;
+  uint64_t key;
+  uint32_t size;
+};
+
+static bool is_program_binary_supported()
+{
+  GLint formatCount = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+  return formatCount > 0;
+}
+
+static uint64_t get_driver_hash()
+{
+  uint64_t hash = engine::hash_bytes(nullptr, 0);
+  for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+  {
+    const char *value = reinterpret_cast<const char *>(glGetString(name));
+    if (value)
+      hash = engine::hash_bytes(value, strlen(value), hash);
+  }
+  return hash;
+}
+
+static std::string get_program_binary_path(uint64_t key)
+{
+  char fileName[32];
+  snprintf(fileName, sizeof(fileName), "%016llx.bin", (unsigned long long)key);
+  return (std::filesystem::path(PROGRAM_BINARY_CACHE_DIR) / fileName).string();
+}
+
+static bool load_program_binary(uint64_t key, GLuint &program)
+{
+  std::ifstream file(get_program_binary_path(key), std::ios::binary);
+  ProgramBinaryHeader header;
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || header.magic != PROGRAM_BINARY_MAGIC || header.key != key)
+    return false;
+  std::vector<char> binary(header.size);
+  if (!file.read(binary.data(), binary.size()))
+    return false;
+
+  program = glCreateProgram();
+  glProgramBinary(program, header.format, binary.data(), binary.size());
+  GLint success;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success)
+  {
+    glDeleteProgram(program);
+    return false;
+  }
+  return true;
+}
+
+static void save_program_binary(uint64_t key, GLuint program)
+{
+  GLint size = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+  if (size <= 0)
+    return;
+  std::vector<char> binary(size);
+  ProgramBinaryHeader header{PROGRAM_BINARY_MAGIC, 0, key, 0};
+  GLsizei length = 0;
+  glGetProgramBinary(program, size, &length, &header.format, binary.data());
+  header.size = length;
+
+  std::error_code error;
+  std::filesystem::create_directories(PROGRAM_BINARY_CACHE_DIR, error);
+  std::ofstream file(get_program_binary_path(key), std::ios::binary);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(binary.data(), length);
+  if (!file)
+    engine::error("Failed to write the program binary of %016llx", (unsigned long long)key);
+}
+
+// the cached binary when the sources and the driver are the same, otherwise compiles and caches
+static bool create_program(const char *name, const std::vector<ShaderInfo> &shaders, uint64_t source_hash, GLuint &program)
+{
+  Timer timer;
+  static const bool binarySupported = is_program_binary_supported();
+  static const uint64_t driverHash = get_driver_hash();
+  const uint64_t key = engine::hash_bytes(&driverHash, sizeof(driverHash), source_hash);
+  if (binarySupported && load_program_binary(key, program))
+  {
+    engine::log("Shader %s loaded from the program binary cache. %f ms", name, timer.elapsed_ms());
+    return true;
+  }
+  if (!compile_shader(name, shaders, program))
+    return false;
+  if (binarySupported)
+    save_program_binary(key, program);
+  engine::log("Shader %s compiled. %f ms", name, timer.elapsed_ms());
+  return true;
 }
 
 static std::vector<ShaderPtr> shaderList;
@@ -105,10 +235,15 @@ ShaderPtr compile_shader(const char *name, const char *vs_path, const char *ps_p
 {
   Shader::ShaderSources shaderSources{{GL_VERTEX_SHADER, vs_path}, {GL_FRAGMENT_SHADER, ps_path}};
 
+  std::vector<int64_t> writeTimes = get_source_write_times(shaderSources);
+  const std::vector<ShaderInfo> shaderCode = read_shader_sources(shaderSources);
+  const uint64_t sourceHash = hash_shader_sources(shaderCode);
   GLuint program;
-  if (compile_shader(name, shaderSources, program))
+  if (create_program(name, shaderCode, sourceHash, program))
   {
     auto shader = std::make_shared<Shader>(name, program, shaderSources);
+    shader->sourceHash = sourceHash;
+    shader->sourceWriteTimes = std::move(writeTimes);
     read_shader_info(*shader);
     shaderList.push_back(shader);
     return shader;
@@ -119,17 +254,28 @@ ShaderPtr compile_shader(const char *name, const char *vs_path, const char *ps_p
 
 void recompile_all_shaders()
 {
-  int shaderCount = 0;
+  int changedCount = 0, shaderCount = 0;
   for (auto &shader : shaderList)
   {
+    // a touched file is reread, but the program is rebuilt only when the text differs
+    std::vector<int64_t> writeTimes = get_source_write_times(shader->shaderSources);
+    if (writeTimes == shader->sourceWriteTimes)
+      continue;
+    shader->sourceWriteTimes = std::move(writeTimes);
+    const std::vector<ShaderInfo> shaderCode = read_shader_sources(shader->shaderSources);
+    const uint64_t sourceHash = hash_shader_sources(shaderCode);
+    if (sourceHash == shader->sourceHash)
+      continue;
+    changedCount++;
     GLuint program;
-    if (compile_shader(shader->name.c_str(), shader->shaderSources, program))
+    if (create_program(shader->name.c_str(), shaderCode, sourceHash, program))
     {
       glDeleteProgram(shader->program);
       shader->program = program;
+      shader->sourceHash = sourceHash;
       read_shader_info(*shader);
       shaderCount++;
     }
   }
-  engine::log("Shaders recompiled (%d/%d)", shaderCount, shaderList.size());
-}
\ No newline at end of file
+  engine::log("Shaders recompiled (%d/%d changed, %zu total)", shaderCount, changedCount, shaderList.size());
+}
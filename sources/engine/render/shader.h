@@ -24,6 +24,8 @@ public:
 	const ShaderSources shaderSources; //for hotreload
 	GLuint program;
   std::vector<ShaderUniform> uniforms;
+	uint64_t sourceHash = 0; // stage types and texts, with the driver it keys the program binary cache
+	std::vector<int64_t> sourceWriteTimes; // recompile rereads only programs whose times changed
 
 	Shader(const std::string &shader_name, GLuint shader_program, ShaderSources sources):
 		name(shader_name),
@@ -1,8 +1,19 @@
 #include "texture2d.h"
 #include "glad/glad.h"
+#include "engine/api.h"
+#include "engine/job_system.h"
+#include "engine/mapped_file.h"
+#include "engine/profiler.h"
+#include "import/texture_cook.h"
+#include <algorithm>
 #include <cassert>
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb/stb_image.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
 
 Texture2DPtr create_texture2d(const uint8_t *image, int w, int h, int ch)
 {
@@ -39,17 +50,240 @@ Texture2DPtr create_texture2d(const uint8_t *image, int w, int h, int ch)
   return texture;
 }
 
-Texture2DPtr create_texture2d(const char *path)
+// mips uploaded in one frame, a single mip over it goes alone
+static const size_t TEXTURE_UPLOAD_BUDGET = 4 << 20;
+// the CPU fills one buffer while the GPU may still copy from the others
+static const int UPLOAD_BUFFER_COUNT = 3;
+
+struct StreamedTexture
+{
+  Texture2DPtr texture;
+  std::string sourcePath;
+  std::string cookedPath;
+  bool compress;
+  engine::JobCounter cookJob;
+  bool cookFailed = false; // written by the cooking job
+  std::unique_ptr<engine::MappedFile> file;
+  const CookedTextureHeader *header = nullptr;
+  const CookedTextureMip *mips = nullptr;
+  uint32_t uploadedMips = 0; // from the smallest one, the levels are allocated with the first
+  int uploadFrames = 0;
+};
+
+struct UploadBuffer
+{
+  GLuint buffer = 0;
+  size_t size = 0;
+  GLsync fence = nullptr;
+};
+
+static std::vector<std::unique_ptr<StreamedTexture>> streamedTextures;
+static UploadBuffer uploadBuffers[UPLOAD_BUFFER_COUNT];
+static int nextUploadBuffer = 0;
+
+static bool is_bc1_supported()
+{
+  GLint formatCount = 0;
+  glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &formatCount);
+  std::vector<GLint> formats(formatCount);
+  glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+  return std::find(formats.begin(), formats.end(), GL_COMPRESSED_RGB_S3TC_DXT1_EXT) != formats.end();
+}
+
+// only the header and the mip table are read, the pixels are paged in by the upload
+static bool open_cooked_texture(StreamedTexture &streamed)
+{
+  auto file = std::make_unique<engine::MappedFile>(streamed.cookedPath.c_str());
+  if (!file->is_open() || file->size() < sizeof(CookedTextureHeader))
+    return false;
+  const auto *header = reinterpret_cast<const CookedTextureHeader *>(file->data());
+  const bool compressed = header->format == CookedTextureFormat::BC1;
+  // RGBA8 is never compressed, so it's current for both settings
+  const bool formatMatches = header->format == CookedTextureFormat::RGBA8 || compressed == streamed.compress;
+  if (header->magic != COOKED_TEXTURE_MAGIC || header->version != COOKED_TEXTURE_VERSION || !formatMatches ||
+    header->sourceStamp != get_texture_source_stamp(streamed.sourcePath.c_str()) || header->mipCount == 0 || header->mipCount > 32 ||
+    file->size() < sizeof(CookedTextureHeader) + header->mipCount * sizeof(CookedTextureMip))
+    return false;
+  const auto *mips = reinterpret_cast<const CookedTextureMip *>(file->data() + sizeof(CookedTextureHeader));
+  for (uint32_t level = 0; level < header->mipCount; level++)
+    if (mips[level].offset + mips[level].size > file->size())
+      return false;
+  streamed.header = header;
+  streamed.mips = mips;
+  streamed.file = std::move(file);
+  return true;
+}
+
+Texture2DPtr create_texture2d(const char *path, bool compress)
 {
-  int w, h, ch;
-  stbi_set_flip_vertically_on_load(true);
-  auto stbiData = stbi_load(path, &w, &h, &ch, 0);
+  GLuint textureObject;
+  glGenTextures(1, &textureObject);
+  auto texture = std::make_shared<Texture2D>(textureObject);
+  glBindTexture(GL_TEXTURE_2D, textureObject);
+  const uint8_t placeholder[4] = {128, 128, 128, 255};
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(GL_TEXTURE_2D, 0);
 
-  Texture2DPtr result;
-  if (stbiData)
+  static const bool bc1Supported = is_bc1_supported();
+  if (compress && !bc1Supported)
+  {
+    engine::error("BC1 isn't supported by the driver, \"%s\" is cooked uncompressed", path);
+    compress = false;
+  }
+
+  auto streamed = std::make_unique<StreamedTexture>();
+  streamed->texture = texture;
+  streamed->sourcePath = path;
+  streamed->cookedPath = get_cooked_texture_path(path);
+  streamed->compress = compress;
+  if (!open_cooked_texture(*streamed))
+  {
+    StreamedTexture *cooking = streamed.get();
+    engine::get_job_system().submit(
+      [cooking]() { cooking->cookFailed = !cook_texture(cooking->sourcePath.c_str(), cooking->cookedPath.c_str(), cooking->compress); },
+      &cooking->cookJob);
+  }
+  streamedTextures.push_back(std::move(streamed));
+  return texture;
+}
+
+// mutable storage, so the placeholder level is replaced, contents stay undefined until the uploads
+static void allocate_levels(const StreamedTexture &streamed)
+{
+  const CookedTextureHeader &header = *streamed.header;
+  glBindTexture(GL_TEXTURE_2D, streamed.texture->textureObject);
+  for (uint32_t level = 0; level < header.mipCount; level++)
+  {
+    const CookedTextureMip &mip = streamed.mips[level];
+    if (header.format == CookedTextureFormat::BC1)
+      glCompressedTexImage2D(GL_TEXTURE_2D, level, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, mip.width, mip.height, 0, mip.size, nullptr);
+    else if (header.format == CookedTextureFormat::RGBA8)
+      glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, mip.width, mip.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    else
+      glTexImage2D(GL_TEXTURE_2D, level, GL_RGB8, mip.width, mip.height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header.mipCount - 1);
+}
+
+void update_texture_streaming()
+{
+  if (streamedTextures.empty())
+    return;
+  PROFILE_ZONE("texture streaming");
+
+  for (std::unique_ptr<StreamedTexture> &streamed : streamedTextures)
+    if (!streamed->file && streamed->cookJob.done() && !streamed->cookFailed && !open_cooked_texture(*streamed))
+    {
+      engine::error("Cooked texture \"%s\" is invalid", streamed->cookedPath.c_str());
+      streamed->cookFailed = true;
+    }
+  // failed textures keep the placeholder
+  std::erase_if(streamedTextures, [](const std::unique_ptr<StreamedTexture> &streamed) { return streamed->cookJob.done() && streamed->cookFailed; });
+
+  // the buffer is reused only after the GPU copied out of it, otherwise the uploads wait for the next frame
+  UploadBuffer &upload = uploadBuffers[nextUploadBuffer];
+  if (upload.fence)
+  {
+    if (glClientWaitSync(upload.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+      return;
+    glDeleteSync(upload.fence);
+    upload.fence = nullptr;
+  }
+
+  struct MipUpload
+  {
+    StreamedTexture *streamed;
+    uint32_t level;
+    size_t offset;
+  };
+  std::vector<MipUpload> uploads;
+  size_t uploadSize = 0;
+  for (std::unique_ptr<StreamedTexture> &streamed : streamedTextures)
+  {
+    if (!streamed->file)
+      continue;
+    // the smallest mips go first, so the texture gets sharper over the frames
+    while (streamed->uploadedMips < streamed->header->mipCount)
+    {
+      const uint32_t level = streamed->header->mipCount - 1 - streamed->uploadedMips;
+      const size_t size = streamed->mips[level].size;
+      if (!uploads.empty() && uploadSize + size > TEXTURE_UPLOAD_BUDGET)
+        break;
+      if (streamed->uploadedMips == 0)
+        allocate_levels(*streamed);
+      uploads.push_back({streamed.get(), level, uploadSize});
+      uploadSize += (size + 3) & ~size_t(3);
+      streamed->uploadedMips++;
+    }
+    streamed->uploadFrames++;
+    if (uploadSize >= TEXTURE_UPLOAD_BUDGET)
+      break;
+  }
+  if (uploads.empty())
+    return;
+
+  if (!upload.buffer)
+    glGenBuffers(1, &upload.buffer);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer);
+  if (upload.size < uploadSize)
+  {
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, uploadSize, nullptr, GL_STREAM_DRAW);
+    upload.size = uploadSize;
+  }
+  // the fence above already guarantees the GPU is done with the buffer
+  uint8_t *mapped = static_cast<uint8_t *>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, uploadSize,
+    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+  for (const MipUpload &mipUpload : uploads)
+  {
+    const CookedTextureMip &mip = mipUpload.streamed->mips[mipUpload.level];
+    memcpy(mapped + mipUpload.offset, mipUpload.streamed->file->data() + mip.offset, mip.size);
+  }
+  glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for (const MipUpload &mipUpload : uploads)
+  {
+    const StreamedTexture &streamed = *mipUpload.streamed;
+    const CookedTextureMip &mip = streamed.mips[mipUpload.level];
+    const void *offset = reinterpret_cast<const void *>(mipUpload.offset);
+    glBindTexture(GL_TEXTURE_2D, streamed.texture->textureObject);
+    if (streamed.header->format == CookedTextureFormat::BC1)
+      glCompressedTexSubImage2D(GL_TEXTURE_2D, mipUpload.level, 0, 0, mip.width, mip.height, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, mip.size, offset);
+    else
+      glTexSubImage2D(GL_TEXTURE_2D, mipUpload.level, 0, 0, mip.width, mip.height,
+        streamed.header->format == CookedTextureFormat::RGBA8 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, offset);
+    // sampling starts at the sharpest uploaded level
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, mipUpload.level);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  nextUploadBuffer = (nextUploadBuffer + 1) % UPLOAD_BUFFER_COUNT;
+
+  std::erase_if(streamedTextures, [](const std::unique_ptr<StreamedTexture> &streamed)
+  {
+    if (!streamed->file || streamed->uploadedMips < streamed->header->mipCount)
+      return false;
+    engine::log("Texture \"%s\" streamed, %u mips in %d frames", streamed->sourcePath.c_str(), streamed->header->mipCount, streamed->uploadFrames);
+    return true;
+  });
+}
+
+void stop_texture_streaming()
+{
+  for (std::unique_ptr<StreamedTexture> &streamed : streamedTextures)
+    engine::get_job_system().wait(streamed->cookJob);
+  streamedTextures.clear();
+  for (UploadBuffer &upload : uploadBuffers)
   {
-    result = create_texture2d(stbiData, w, h, ch);
-    stbi_image_free(stbiData);
+    if (upload.fence)
+      glDeleteSync(upload.fence);
+    if (upload.buffer)
+      glDeleteBuffers(1, &upload.buffer);
+    upload = UploadBuffer();
   }
-  return result;
 }
@@ -11,4 +11,14 @@ struct Texture2D
 using Texture2DPtr = std::shared_ptr<Texture2D>;
 
 Texture2DPtr create_texture2d(const uint8_t *image, int w, int h, int ch);
-Texture2DPtr create_texture2d(const char *path);
\ No newline at end of file
+// Returns a grey placeholder at once. The cooked file is memory mapped and streamed from the smallest mip,
+// missing or stale ones are cooked on a worker first. compress - BC1 when the driver supports it.
+Texture2DPtr create_texture2d(const char *path, bool compress = false);
+
+// TEXTURE STREAMING //
+
+// uploads the next mips of streamed textures through pixel buffers within a per frame budget
+void update_texture_streaming();
+
+// waits for cooking jobs and drops unfinished uploads, call before the GL context is destroyed
+void stop_texture_streaming();
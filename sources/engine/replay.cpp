@@ -0,0 +1,214 @@
+#include "engine/replay.h"
+#include "engine/api.h"
+#include "import/timer.h"
+#include <cstdio>
+
+namespace engine
+{
+  extern void override_delta_time(float dt);
+
+  static const uint32_t REPLAY_MAGIC = 0x594C5052; // "RPLY"
+  static const uint32_t REPLAY_VERSION = 1;
+
+  struct ReplayState
+  {
+    ReplayMode mode = ReplayMode::None;
+    FILE *file = nullptr;
+    std::string path;
+    std::vector<SDL_Event> recordedEvents;
+    float fixedDeltaTime = 0.f;
+    uint64_t frames = 0;
+    uint64_t checksum = hash_bytes(nullptr, 0); // of all frame checksums
+    uint64_t mismatches = 0;
+    uint64_t firstMismatch = 0;
+    bool deltaTimeOverridden = false; // a frame ran with another dt than recorded, recorded checksums don't apply
+    bool failed = false;
+    Timer timer;
+  };
+  static ReplayState replay;
+
+  uint64_t hash_bytes(const void *data, size_t size, uint64_t hash)
+  {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+      hash ^= bytes[i];
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+
+  static bool write_bytes(const void *data, size_t size)
+  {
+    return size == 0 || fwrite(data, size, 1, replay.file) == 1;
+  }
+
+  static bool read_bytes(void *data, size_t size)
+  {
+    return size == 0 || fread(data, size, 1, replay.file) == 1;
+  }
+
+  ReplayMode get_replay_mode()
+  {
+    return replay.mode;
+  }
+
+  bool start_recording(const std::string &path)
+  {
+    stop_replay();
+    replay = ReplayState();
+    replay.file = fopen(path.c_str(), "wb");
+    if (!replay.file)
+    {
+      engine::error("Failed to open replay file \"%s\" for writing", path.c_str());
+      return false;
+    }
+    const uint32_t eventSize = sizeof(SDL_Event);
+    write_bytes(&REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+    write_bytes(&REPLAY_VERSION, sizeof(REPLAY_VERSION));
+    write_bytes(&eventSize, sizeof(eventSize));
+    replay.path = path;
+    replay.mode = ReplayMode::Record;
+    engine::log("Recording replay to \"%s\"", path.c_str());
+    return true;
+  }
+
+  bool start_replay(const std::string &path, float fixed_dt)
+  {
+    stop_replay();
+    replay = ReplayState();
+    replay.file = fopen(path.c_str(), "rb");
+    if (!replay.file)
+    {
+      engine::error("Failed to open replay file \"%s\"", path.c_str());
+      return false;
+    }
+    uint32_t magic = 0, version = 0, eventSize = 0;
+    read_bytes(&magic, sizeof(magic));
+    read_bytes(&version, sizeof(version));
+    read_bytes(&eventSize, sizeof(eventSize));
+    if (magic != REPLAY_MAGIC || version != REPLAY_VERSION || eventSize != sizeof(SDL_Event))
+    {
+      engine::error("Replay file \"%s\" has unsupported format", path.c_str());
+      fclose(replay.file);
+      replay.file = nullptr;
+      return false;
+    }
+    replay.path = path;
+    replay.fixedDeltaTime = fixed_dt;
+    replay.mode = ReplayMode::Replay;
+    engine::log("Replaying \"%s\"", path.c_str());
+    return true;
+  }
+
+  void stop_replay()
+  {
+    if (replay.mode == ReplayMode::Record)
+    {
+      engine::log("Replay \"%s\" recorded, %llu frames", replay.path.c_str(), (unsigned long long)replay.frames);
+    }
+    else if (replay.mode == ReplayMode::Replay)
+    {
+      const float frameTime = replay.frames ? replay.timer.elapsed_ms() / replay.frames : 0.f;
+      engine::log("Replay \"%s\" finished, %llu frames, %.3f ms per frame, checksum %016llx",
+        replay.path.c_str(), (unsigned long long)replay.frames, frameTime, (unsigned long long)replay.checksum);
+      if (replay.deltaTimeOverridden)
+        engine::log("Fixed delta time differs from the recorded one, pose checksums were not compared");
+      else if (replay.mismatches > 0)
+        engine::error("Replay diverged in %llu frames, first mismatch at frame %llu",
+          (unsigned long long)replay.mismatches, (unsigned long long)replay.firstMismatch);
+    }
+    if (replay.file)
+      fclose(replay.file);
+    replay.file = nullptr;
+    replay.mode = ReplayMode::None;
+  }
+
+  void record_input_event(const SDL_Event &event)
+  {
+    if (replay.mode == ReplayMode::Record)
+      replay.recordedEvents.push_back(event);
+  }
+
+  bool replay_frame(std::vector<SDL_Event> &events)
+  {
+    events.clear();
+    if (replay.mode == ReplayMode::Record)
+    {
+      const float dt = engine::get_delta_time();
+      const uint32_t eventCount = replay.recordedEvents.size();
+      write_bytes(&dt, sizeof(dt));
+      write_bytes(&eventCount, sizeof(eventCount));
+      write_bytes(replay.recordedEvents.data(), eventCount * sizeof(SDL_Event));
+      replay.recordedEvents.clear();
+      replay.frames++;
+    }
+    else if (replay.mode == ReplayMode::Replay)
+    {
+      float dt = 0.f;
+      uint32_t eventCount = 0;
+      if (replay.failed || !read_bytes(&dt, sizeof(dt)) || !read_bytes(&eventCount, sizeof(eventCount)))
+        return false;
+      events.resize(eventCount);
+      if (!read_bytes(events.data(), eventCount * sizeof(SDL_Event)))
+      {
+        engine::error("Replay \"%s\" is truncated at frame %llu", replay.path.c_str(), (unsigned long long)replay.frames);
+        return false;
+      }
+      if (replay.fixedDeltaTime > 0.f && replay.fixedDeltaTime != dt)
+      {
+        replay.deltaTimeOverridden = true;
+        dt = replay.fixedDeltaTime;
+      }
+      override_delta_time(dt);
+      // timing starts after loading, from the first replayed frame
+      if (replay.frames == 0)
+        replay.timer.reset();
+      replay.frames++;
+    }
+    return true;
+  }
+
+  void replay_sync(void *data, size_t size)
+  {
+    if (replay.mode == ReplayMode::Record)
+    {
+      write_bytes(data, size);
+    }
+    else if (replay.mode == ReplayMode::Replay && !replay.failed)
+    {
+      if (!read_bytes(data, size))
+      {
+        engine::error("Replay \"%s\" is truncated at frame %llu", replay.path.c_str(), (unsigned long long)replay.frames);
+        replay.failed = true;
+      }
+    }
+  }
+
+  void replay_checksum(uint64_t checksum)
+  {
+    if (replay.mode == ReplayMode::Record)
+    {
+      write_bytes(&checksum, sizeof(checksum));
+    }
+    else if (replay.mode == ReplayMode::Replay && !replay.failed)
+    {
+      uint64_t recorded = 0;
+      if (!read_bytes(&recorded, sizeof(recorded)))
+      {
+        replay.failed = true;
+        return;
+      }
+      if (recorded != checksum && !replay.deltaTimeOverridden)
+      {
+        if (replay.mismatches == 0)
+        {
+          replay.firstMismatch = replay.frames - 1;
+          engine::error("Pose checksum mismatch at frame %llu", (unsigned long long)replay.firstMismatch);
+        }
+        replay.mismatches++;
+      }
+    }
+    replay.checksum = hash_bytes(&checksum, sizeof(checksum), replay.checksum);
+  }
+} // namespace engine
@@ -0,0 +1,56 @@
+#pragma once
+#include <SDL2/SDL_events.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace engine
+{
+  // REPLAY SUBSYSTEM //
+
+  // Per frame the stream keeps delta time, input events which reached the game,
+  // application state synced with replay_sync and a checksum of the resulting pose.
+
+  enum class ReplayMode
+  {
+    None,
+    Record,
+    Replay
+  };
+
+  ReplayMode get_replay_mode();
+
+  bool start_recording(const std::string &path);
+
+  // fixed_dt <= 0 replays recorded delta times, otherwise frames run with fixed_dt,
+  // then recorded pose checksums don't apply and only the cumulative checksum is reported
+  bool start_replay(const std::string &path, float fixed_dt);
+
+  // closes the stream, replay logs its report
+  void stop_replay();
+
+  // remembers a polled event for the current frame, no-op unless recording
+  void record_input_event(const SDL_Event &event);
+
+  // called once per frame after events are polled
+  // record: writes delta time and remembered events
+  // replay: sets delta time and returns recorded events, returns false when the stream ended
+  bool replay_frame(std::vector<SDL_Event> &events);
+
+  // record: writes the value, replay: overwrites it with the recorded one
+  void replay_sync(void *data, size_t size);
+
+  template <typename T>
+  void replay_sync(T &value)
+  {
+    replay_sync(&value, sizeof(T));
+  }
+
+  // record: writes the checksum, replay: compares it with the recorded one unless delta time was overridden,
+  // both fold it into the cumulative checksum
+  void replay_checksum(uint64_t checksum);
+
+  // FNV-1a, chain calls with the previous result as hash
+  uint64_t hash_bytes(const void *data, size_t size, uint64_t hash = 14695981039346656037ull);
+} // namespace engine
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <typename Signature, size_t Capacity = 4 * sizeof(void *)>
+class SmallFunction;
+
+// std::function replacement which never allocates: the callable is stored in an inline buffer,
+// a callable which doesn't fit fails to compile
+template <typename R, typename... Args, size_t Capacity>
+class SmallFunction<R(Args...), Capacity>
+{
+  struct Operations
+  {
+    R (*invoke)(void *callable, Args &&...args);
+    void (*move)(void *from, void *to); // move constructs into to and destroys from
+    void (*destroy)(void *callable);
+  };
+
+  template <typename F>
+  static const Operations *operations_for()
+  {
+    static const Operations operations = {
+      [](void *callable, Args &&...args) -> R
+      { return (*static_cast<F *>(callable))(std::forward<Args>(args)...); },
+      [](void *from, void *to)
+      {
+        new (to) F(std::move(*static_cast<F *>(from)));
+        static_cast<F *>(from)->~F();
+      },
+      [](void *callable)
+      { static_cast<F *>(callable)->~F(); },
+    };
+    return &operations;
+  }
+
+  alignas(std::max_align_t) unsigned char storage[Capacity];
+  const Operations *operations = nullptr;
+
+public:
+  SmallFunction() = default;
+  SmallFunction(std::nullptr_t) {}
+
+  template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, SmallFunction>>>
+  SmallFunction(F &&f)
+  {
+    using Callable = std::decay_t<F>;
+    static_assert(sizeof(Callable) <= Capacity, "callable is too big for SmallFunction, capture less or raise Capacity");
+    static_assert(alignof(Callable) <= alignof(std::max_align_t), "callable is overaligned for SmallFunction");
+    static_assert(std::is_invocable_r_v<R, Callable &, Args...>, "callable has a wrong signature");
+    new (storage) Callable(std::forward<F>(f));
+    operations = operations_for<Callable>();
+  }
+
+  SmallFunction(SmallFunction &&other) noexcept
+  {
+    if (other.operations)
+    {
+      other.operations->move(other.storage, storage);
+      operations = other.operations;
+      other.operations = nullptr;
+    }
+  }
+
+  SmallFunction &operator=(SmallFunction &&other) noexcept
+  {
+    if (this != &other)
+    {
+      reset();
+      if (other.operations)
+      {
+        other.operations->move(other.storage, storage);
+        operations = other.operations;
+        other.operations = nullptr;
+      }
+    }
+    return *this;
+  }
+
+  SmallFunction(const SmallFunction &) = delete;
+  SmallFunction &operator=(const SmallFunction &) = delete;
+
+  ~SmallFunction()
+  {
+    reset();
+  }
+
+  void reset()
+  {
+    if (operations)
+      operations->destroy(storage);
+    operations = nullptr;
+  }
+
+  explicit operator bool() const
+  {
+    return operations != nullptr;
+  }
+
+  R operator()(Args... args) const
+  {
+    return operations->invoke(const_cast<unsigned char *>(storage), std::forward<Args>(args)...);
+  }
+};
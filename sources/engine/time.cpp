@@ -23,6 +23,15 @@ void update_time()
   savedTime = d.count();
 }
 
+// replaces the measured frame time, time since start becomes the sum of overridden steps
+void override_delta_time(float dt)
+{
+  static float overriddenTime = 0.f;
+  overriddenTime += dt;
+  deltaTime = dt;
+  savedTime = overriddenTime;
+}
+
 float get_time()
 {
   return savedTime;